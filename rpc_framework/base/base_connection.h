@@ -2,6 +2,7 @@
 #define __rpc_base_connection_h__
 
 #include <memory>
+#include <functional>
 #include <rpc_framework/base/base_message.h>
 
 namespace base_connection
@@ -11,12 +12,30 @@ namespace base_connection
     {
     public:
         using ptr = std::shared_ptr<BaseConnection>;
+        // 按照协议编码好的完整数据帧，同一份数据可以发送给多个连接
+        using frame_t = std::shared_ptr<const std::string>;
+        // 交给连接所属IO线程执行的任务
+        using task_t = std::function<void()>;
         // 发送
         virtual void send(const base_message::BaseMessage::ptr &msg) = 0;
+        // 发送已经编码好的数据帧，避免同一个消息发送给多个连接时重复序列化
+        virtual void sendFrame(const frame_t &frame) = 0;
         // 关闭连接
         virtual void shutdown() = 0;
         // 判断连接是否正常
         virtual bool connected() = 0;
+        // 等待输出缓冲区中未发送的数据低于高水位，用于流式响应的背压，超时或者连接断开时返回false
+        // 在连接所属的IO线程中调用时不会等待，直接返回当前状态；不限制输出缓冲区的连接只判断连接状态
+        virtual bool waitWritable(int /*timeout_ms*/)
+        {
+            return connected();
+        }
+        // 在连接所属的IO线程中执行任务：当前就在IO线程中时直接执行，否则投递到IO线程的事件循环
+        // 没有IO线程的连接直接在当前线程执行
+        virtual void runInLoop(const task_t &task)
+        {
+            task();
+        }
     };
 }
 
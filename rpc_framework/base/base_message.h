@@ -48,6 +48,11 @@ namespace base_message
         virtual bool deserialize(const std::string &msg) = 0;
         // 检查消息是否合法
         virtual bool check() = 0;
+        // 重置消息，用于对象池回收，字符串保留已经分配的空间
+        virtual void reset()
+        {
+            req_resp_id_.clear();
+        }
 
     protected:
         public_data::MType mtype_;
@@ -4,6 +4,7 @@
 #include <memory>
 #include <rpc_framework/base/base_buffer.h>
 #include <rpc_framework/base/base_message.h>
+#include <rpc_framework/base/base_connection.h>
 #include <rpc_framework/base/public_data.h>
 
 namespace base_protocol
@@ -19,6 +20,11 @@ namespace base_protocol
         virtual bool getContentFromBuffer(const base_buffer::BaseBuffer::ptr &buf, base_message::BaseMessage::ptr &msg) = 0;
         // 序列化接口，用于序列化Message类的成员
         virtual std::string constructProtocol(const base_message::BaseMessage::ptr &msg) = 0;
+        // 只序列化一次，得到可以在多个连接之间共享的数据帧
+        base_connection::BaseConnection::frame_t constructFrame(const base_message::BaseMessage::ptr &msg)
+        {
+            return std::make_shared<const std::string>(constructProtocol(msg));
+        }
         // 不提供反序列化
     };
 }
@@ -0,0 +1,116 @@
+#ifndef __rpc_call_context_h__
+#define __rpc_call_context_h__
+
+#include <chrono>
+#include <algorithm>
+
+namespace call_context
+{
+    // 调用的截止时间
+    // 每一个线程保存当前正在处理的调用的截止时间：服务端在调用业务回调前设置为请求的截止时间，
+    // 业务回调中可以读取剩余时间，回调中发起的下游调用自动携带剩余时间，实现截止时间的传递
+    // 客户端也可以在发起调用前通过Scope设置截止时间，作为请求的超时时间发送给服务端
+    // 请求中携带的是剩余毫秒数而不是绝对时间，不依赖两端的时钟同步
+    class CallContext
+    {
+    private:
+        struct Deadline
+        {
+            bool has = false;
+            std::chrono::steady_clock::time_point deadline;
+        };
+
+    public:
+        using clock_t = std::chrono::steady_clock;
+
+        // 在作用域内设置当前线程的截止时间，离开作用域时恢复原来的截止时间
+        // 已经存在更早的截止时间时保留更早的一个，下游调用不能超过上游的截止时间
+        class Scope
+        {
+        public:
+            explicit Scope(clock_t::time_point deadline)
+                : prev_(current())
+            {
+                if (!prev_.has || deadline < prev_.deadline)
+                    current() = Deadline{true, deadline};
+            }
+
+            explicit Scope(std::chrono::milliseconds timeout)
+                : Scope(clock_t::now() + timeout)
+            {
+            }
+
+            ~Scope()
+            {
+                current() = prev_;
+            }
+
+            Scope(const Scope &) = delete;
+            Scope &operator=(const Scope &) = delete;
+
+        private:
+            Deadline prev_; // 进入作用域之前的截止时间
+        };
+
+        // 在作用域内把当前线程的截止时间替换为另一个调用的截止时间，离开作用域时恢复原来的截止时间
+        // 与Scope不同，不保留更早的截止时间，用于在一个调用所在的线程中执行另一个无关的调用
+        class SwitchScope
+        {
+        public:
+            // has为false表示另一个调用没有截止时间
+            SwitchScope(bool has, clock_t::time_point deadline)
+                : prev_(current())
+            {
+                current() = Deadline{has, deadline};
+            }
+
+            ~SwitchScope()
+            {
+                current() = prev_;
+            }
+
+            SwitchScope(const SwitchScope &) = delete;
+            SwitchScope &operator=(const SwitchScope &) = delete;
+
+        private:
+            Deadline prev_; // 进入作用域之前的截止时间
+        };
+
+        // 当前线程是否设置了截止时间
+        static bool hasDeadline()
+        {
+            return current().has;
+        }
+
+        // 获取当前线程的截止时间，没有设置时返回time_point::max()
+        static clock_t::time_point deadline()
+        {
+            return current().has ? current().deadline : clock_t::time_point::max();
+        }
+
+        // 获取剩余的毫秒数，没有设置截止时间时返回-1，已经超时返回0
+        static int remainingMs()
+        {
+            if (!current().has)
+                return -1;
+
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(current().deadline - clock_t::now()).count();
+            return static_cast<int>(std::max<long long>(remaining, 0));
+        }
+
+        // 是否已经超过截止时间
+        static bool expired()
+        {
+            return current().has && clock_t::now() >= current().deadline;
+        }
+
+    private:
+        static Deadline &current()
+        {
+            thread_local Deadline deadline;
+            return deadline;
+        }
+    };
+}
+
+#endif
@@ -3,9 +3,13 @@
 
 #include <unordered_map>
 #include <mutex>
+#include <array>
+#include <atomic>
+#include <vector>
 #include <rpc_framework/base/base_message.h>
 #include <rpc_framework/base/base_connection.h>
 #include <rpc_framework/base/public_data.h>
+#include <rpc_framework/factories/message_factory.h>
 #include <rpc_framework/base/log.h>
 
 // 消息分发模块
@@ -64,6 +68,7 @@ namespace dispatcher_rpc_framework
     {
     public:
         using ptr = std::shared_ptr<BaseCallback>;
+        virtual ~BaseCallback() = default;
         virtual void excuteService(const base_connection::BaseConnection::ptr &conn, base_message::BaseMessage::ptr &msg) = 0;
     };
     template <class T>
@@ -78,9 +83,10 @@ namespace dispatcher_rpc_framework
         {
         }
 
+        // 7. 注册时已经确认消息工厂为该消息类型创建的对象就是T类型，所以此处可以直接使用static_pointer_cast
         void excuteService(const base_connection::BaseConnection::ptr &conn, base_message::BaseMessage::ptr &msg) override
         {
-            auto type_msg = std::dynamic_pointer_cast<T>(msg);
+            auto type_msg = std::static_pointer_cast<T>(msg);
             handler_(conn, type_msg);
         }
 
@@ -141,45 +147,66 @@ namespace dispatcher_rpc_framework
         //     type_calls.insert({m, base_call});
         // }
 
+        // 8. 注册只发生在启动阶段，而分发发生在每一次收到消息时
+        // 所以使用以消息类型为下标的定长数组保存回调，分发时不需要加锁也不需要查找哈希表
+        // 注册时加锁并校验消息类型，回调对象由owned_calls_管理，数组中只保存裸指针
         template <class T>
         void registerService(const public_data::MType &m, const typename Callback<T>::callback_t &cb)
         {
+            size_t index = static_cast<size_t>(m);
+            if (index >= type_calls_.size())
+            {
+                LOG(Level::Warning, "错误的消息类型：{}，注册失败", index);
+                return;
+            }
+
+            // 消息对象由消息工厂根据消息类型创建，确认创建出的对象可以转换为T类型
+            base_message::BaseMessage::ptr sample = message_factory::MessageFactory::messageCreateFactory(m);
+            if (!sample || !dynamic_cast<T *>(sample.get()))
+            {
+                LOG(Level::Error, "消息类型：{} 与回调的参数类型不匹配，注册失败", index);
+                return;
+            }
+
             std::unique_lock<std::mutex> lock(mtx_);
-            auto pos = type_calls.find(m);
-            if (pos != type_calls.end())
+            if (type_calls_[index].load(std::memory_order_relaxed))
             {
                 LOG(Level::Warning, "已经存在指定的消息类型，插入失败");
                 return;
             }
 
-            // 创建出BaseCallback对象指针
-            std::shared_ptr<BaseCallback> base_call = std::make_shared<Callback<T>>(cb);
-            type_calls.insert({m, base_call});
+            // 创建出BaseCallback对象
+            owned_calls_.push_back(std::make_unique<Callback<T>>(cb));
+            type_calls_[index].store(owned_calls_.back().get(), std::memory_order_release);
         }
 
         // 根据操作类型执行回调
         void executeService(const base_connection::BaseConnection::ptr &con, base_message::BaseMessage::ptr &msg)
         {
-            std::unique_lock<std::mutex> lock(mtx_);
-            auto pos = type_calls.find(msg->getMtype());
-            if (pos == type_calls.end())
+            size_t index = static_cast<size_t>(msg->getMtype());
+            BaseCallback *call = index < type_calls_.size() ? type_calls_[index].load(std::memory_order_acquire) : nullptr;
+            if (!call)
             {
-                LOG(Level::Debug, "错误的消息类型为：{}", static_cast<int>(msg->getMtype()));
+                LOG(Level::Debug, "错误的消息类型为：{}", index);
                 LOG(Level::Warning, "不存在指定的消息类型，分发失败");
                 con->shutdown();
                 return;
             }
 
-            (pos->second)->excuteService(con, msg);
+            call->excuteService(con, msg);
         }
 
     private:
         // std::unordered_map<public_data::MType, public_data::messageCallback_t> type_calls; // 消息类型和回调函数的映射
 
         // 4. 此时容器的第二个类型就是BaseCallback
-        std::unordered_map<public_data::MType, BaseCallback::ptr> type_calls; // 消息类型和回调函数的映射
+        // std::unordered_map<public_data::MType, BaseCallback::ptr> type_calls; // 消息类型和回调函数的映射
+
+        // 以消息类型为下标的回调数组
+        std::array<std::atomic<BaseCallback *>, static_cast<size_t>(public_data::MType::MType_count)> type_calls_{};
+        std::vector<std::unique_ptr<BaseCallback>> owned_calls_; // 管理所有回调对象的生命周期
 
-        std::mutex mtx_; // 管理哈希表的互斥锁
+        std::mutex mtx_; // 注册时使用的互斥锁
     };
 }
 
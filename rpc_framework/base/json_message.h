@@ -15,6 +15,9 @@ namespace json_message
     // 但是因为正文具体内容需要由具体的子类实现
     // ! 为什么不对mtype和id进行序列化？
     // ? 因为Message类只负责正文部分
+    // 反序列化时只保存原始正文，第一次访问字段时才构建JSON对象
+    // 对于只做转发的消息（例如主题发布），序列化时直接返回原始正文，不会解析正文
+    // ! 延迟解析不是线程安全的，同一个消息对象不要在多个线程中同时读取
     class JsonMessage : public base_message::BaseMessage
     {
     public:
@@ -23,6 +26,13 @@ namespace json_message
         // 只实现对body进行序列化
         virtual bool serialize(std::string &msg) override
         {
+            // 原始正文依旧有效（收到后没有被修改过），直接返回，不需要重新序列化
+            if (!raw_body_.empty())
+            {
+                msg = raw_body_;
+                return true;
+            }
+
             // 判断Json对象是否为空
             if (body_.isNull())
             {
@@ -41,7 +51,7 @@ namespace json_message
         }
 
         // 反序列化
-        // 只实现对body进行反序列化
+        // 只保存原始正文，真正的解析推迟到第一次访问字段时
         virtual bool deserialize(const std::string &msg) override
         {
             if (msg.empty())
@@ -50,21 +60,91 @@ namespace json_message
                 return false;
             }
 
-            // 调用Json工具类方法进行反序列化
-            if (!json_util::JsonUtil::deserialize(msg, body_))
-            {
-                LOG(Level::Warning, "反序列化失败");
-                return false;
-            }
+            raw_body_ = msg;
+            body_ = Json::Value();
+            parsed_ = false;
 
             return true;
         }
 
+        // 重置消息，清空正文
+        // 原始正文字符串保留已经分配的空间；JSON正文只保留顶层对象或数组的容器，
+        // jsoncpp的成员节点各自分配，清空时逐个释放，无法保留
+        virtual void reset() override
+        {
+            base_message::BaseMessage::reset();
+            if (body_.isObject() || body_.isArray())
+                body_.clear();
+            else
+                body_ = Json::Value();
+            raw_body_.clear();
+            parsed_ = true;
+        }
+
         // ! JsonMessage不需要实现check函数
         // ! 因为在请求和响应中对字段的检查都有所不同，交给具体的子类实现
 
     protected:
+        // 只读方式获取正文，第一次访问时解析原始正文
+        const Json::Value &body()
+        {
+            if (!parsed_)
+                parseBody();
+
+            return body_;
+        }
+
+        // 可写方式获取正文，修改后原始正文失效，序列化时需要重新构建
+        Json::Value &mutableBody()
+        {
+            if (!parsed_)
+                parseBody();
+            raw_body_.clear();
+
+            return body_;
+        }
+
+        // 获取顶层字符串字段
+        // 正文未解析时直接从原始正文中提取，用于只需要路由字段的场景
+        std::string stringField(const char *key)
+        {
+            std::string value;
+            if (!parsed_ && json_util::JsonUtil::peekString(raw_body_, key, value))
+                return value;
+
+            return body()[key].asString();
+        }
+
+        // 获取顶层整数字段，字段不存在或者不是整数时返回def
+        int intField(const char *key, int def = 0)
+        {
+            int value = def;
+            if (!parsed_ && json_util::JsonUtil::peekInt(raw_body_, key, value))
+                return value;
+
+            const Json::Value &val = body()[key];
+            return val.isInt() ? val.asInt() : def;
+        }
+
+    private:
+        // 解析原始正文
+        void parseBody()
+        {
+            parsed_ = true;
+            if (raw_body_.empty())
+                return;
+
+            if (!json_util::JsonUtil::deserialize(raw_body_, body_))
+            {
+                LOG(Level::Warning, "正文部分反序列化失败");
+                body_ = Json::Value();
+            }
+        }
+
+    private:
         Json::Value body_;
+        std::string raw_body_; // 收到的原始正文，修改正文后清空
+        bool parsed_ = true;   // 正文是否已经解析为JSON对象
     };
 
     // 请求类，不实现任何信息
@@ -73,6 +153,18 @@ namespace json_message
     public:
         using ptr = std::shared_ptr<JsonRequest>;
         // ! JsonReqest不需要实现check函数
+
+        // 设置和获取超时时间
+        // 超时时间为发送请求时剩余的毫秒数，不存在时返回-1表示不限制
+        void setTimeout(int timeout_ms)
+        {
+            mutableBody()[KEY_TIMEOUT] = timeout_ms;
+        }
+
+        int getTimeout()
+        {
+            return intField(KEY_TIMEOUT, -1);
+        }
     };
 
     // 响应类，实现check函数，因为响应中大部分都是检查返回状态码
@@ -84,7 +176,7 @@ namespace json_message
         virtual bool check() override
         {
             // 判断返回值字段是否存在或者是否为整数，不是返回false
-            if (body_[KEY_RCODE].isNull() || !body_[KEY_RCODE].isInt())
+            if (body()[KEY_RCODE].isNull() || !body()[KEY_RCODE].isInt())
             {
                 LOG(Level::Warning, "返回值类型错误");
                 return false;
@@ -96,12 +188,12 @@ namespace json_message
         // 设置和返回状态码
         virtual void setRCode(const public_data::RCode r)
         {
-            body_[KEY_RCODE] = static_cast<int>(r);
+            mutableBody()[KEY_RCODE] = static_cast<int>(r);
         }
 
         virtual public_data::RCode getRCode()
         {
-            return static_cast<public_data::RCode>(body_[KEY_RCODE].asInt());
+            return static_cast<public_data::RCode>(intField(KEY_RCODE));
         }
     };
 }
@@ -61,7 +61,7 @@ namespace length_value_protocol
                 return false;
             }
 
-            // 对正文部分进行反序列化，将其中的JSON对象存储到成员body_中
+            // 对正文部分进行反序列化，只保存原始正文，JSON对象在第一次访问字段时才构建
             if (!msg->deserialize(body))
             {
                 LOG(Level::Error, "正文部分反序列化失败");
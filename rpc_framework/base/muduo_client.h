@@ -73,6 +73,9 @@ namespace muduo_client
             }
             else if (con->disconnected())
             {
+                // 通知上层连接断开，例如结束连接上所有未完成的请求
+                if (cb_close_ && con_)
+                    cb_close_(con_);
                 con_.reset(); // 重置连接指针
                 std::cout << "客户端断开连接" << std::endl;
             }
@@ -2,6 +2,11 @@
 #define __rpc_muduo_connection_h__
 
 #include <memory>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <condition_variable>
+#include <rpc_framework/base/public_data.h>
 #include <rpc_framework/base/base_connection.h>
 #include <rpc_framework/base/base_protocol.h>
 #include <rpc_framework/muduo_include/muduo/net/TcpConnection.h>
@@ -15,8 +20,26 @@ namespace muduo_connection
         using ptr = std::shared_ptr<MuduoConnection>;
 
         MuduoConnection(const base_protocol::BaseProtocol::ptr &pro, const muduo::net::TcpConnectionPtr &con)
-            : pro_(pro), con_(con)
+            : pro_(pro), con_(con), output_(std::make_shared<OutputState>())
         {
+            // 连接在IO线程的连接回调中创建，下面的回调也都在IO线程中执行
+            // 超过高水位后才设置发送完成回调，避免每一次发送都向IO线程投递回调
+            std::shared_ptr<OutputState> output = output_;
+            con_->setHighWaterMarkCallback([output](const muduo::net::TcpConnectionPtr &con, size_t)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(output->mtx);
+                    output->blocked = true;
+                }
+                con->setWriteCompleteCallback([output](const muduo::net::TcpConnectionPtr &con)
+                {
+                    // 输出缓冲区已经全部发送，唤醒等待写入的线程
+                    con->setWriteCompleteCallback(muduo::net::WriteCompleteCallback());
+                    std::unique_lock<std::mutex> lock(output->mtx);
+                    output->blocked = false;
+                    output->cond.notify_all();
+                });
+            }, public_data::output_high_water_mark);
         }
 
         // 发送
@@ -27,6 +50,12 @@ namespace muduo_connection
             // 调用TcpConnection的发送
             con_->send(content);
         }
+        // 发送已经编码好的数据帧
+        virtual void sendFrame(const frame_t &frame) override
+        {
+            // TcpConnection会将数据拷贝到自己的输出缓冲区
+            con_->send(frame->data(), static_cast<int>(frame->size()));
+        }
         // 关闭连接
         virtual void shutdown() override 
         {
@@ -37,10 +66,43 @@ namespace muduo_connection
         {
             return con_->connected();
         }
+        // 等待输出缓冲区低于高水位，IO线程中等待会导致缓冲区无法发送，只返回当前状态
+        // 等待期间定期检查连接状态，连接断开后缓冲区不会再被发送
+        virtual bool waitWritable(int timeout_ms) override
+        {
+            std::unique_lock<std::mutex> lock(output_->mtx);
+            if (con_->getLoop()->isInLoopThread())
+                return !output_->blocked && con_->connected();
+
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+            while (output_->blocked && con_->connected())
+            {
+                auto now = std::chrono::steady_clock::now();
+                if (now >= deadline)
+                    return false;
+                output_->cond.wait_for(lock, std::min<std::chrono::steady_clock::duration>(deadline - now, std::chrono::milliseconds(100)));
+            }
+            return con_->connected();
+        }
+        // 投递到TcpConnection所属的EventLoop
+        virtual void runInLoop(const task_t &task) override
+        {
+            con_->getLoop()->runInLoop(task);
+        }
+
+    private:
+        // 输出缓冲区的状态，由IO线程中的回调修改，回调持有共享指针，不依赖连接对象的生命周期
+        struct OutputState
+        {
+            std::mutex mtx;
+            std::condition_variable cond;
+            bool blocked = false; // 输出缓冲区超过高水位且还没有发送完
+        };
 
     private:
         base_protocol::BaseProtocol::ptr pro_; // 使用协议中的方法获取到待发送的数据
         muduo::net::TcpConnectionPtr con_;     // 使用Muduo库中的TcpConnection
+        std::shared_ptr<OutputState> output_;  // 输出缓冲区是否超过高水位
     };
 }
 
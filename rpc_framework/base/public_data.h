@@ -22,8 +22,30 @@ namespace public_data
     // 最大64KB大小的数据
     const int max_data_size = (1 << 16);
 
+    // 一个批量请求最多包含的调用个数，所有结果放在一个响应中，响应同样不能超过max_data_size
+    const size_t max_batch_calls = 256;
+
+    // 连接输出缓冲区的高水位，超过后流式响应暂停写入，直到缓冲区中的数据发送完
+    const size_t output_high_water_mark = 4 * 1024 * 1024;
+    // 流式响应等待输出缓冲区低于高水位的最长时间(ms)，超时说明客户端读取过慢
+    const int stream_write_timeout = 10000;
+
+    // 双向流阻塞写入等待对端额度的默认最长时间(ms)，超时后终止流
+    const int default_stream_credit_timeout = 10000;
+    // 双向流默认的接收窗口（对端在收到额度前最多可以发送的数据帧个数）
+    const int default_stream_window = 64;
+    // 打开双向流时等待接受帧的默认超时时间(ms)
+    const int default_stream_open_timeout = 10000;
+
+    // 服务端内置的方法表查询服务名称，返回{方法名: 方法编号}
+    const std::string method_table_name = "__method_table";
+
+    // 服务端内置的统计查询服务名称，返回各个方法的调用次数、错误次数和耗时分布
+    const std::string stats_method_name = "__stats";
+
 // 请求和响应中body需要的字段
 #define KEY_METHOD "method"       // 方法名
+#define KEY_METHOD_ID "method_id" // 方法编号
 #define KEY_PARAMS "parameters"   // 方法参数
 #define KEY_TOPIC_KEY "topic_key" // 主题名称
 #define KEY_TOPIC_MSG "topic_msg" // 主题信息
@@ -33,6 +55,12 @@ namespace public_data
 #define KEY_HOST_PORT "port"      // 端口号
 #define KEY_RCODE "rcode"         // 返回状态码
 #define KEY_RESULT "result"       // 返回值
+#define KEY_BATCH "batch"         // 批量调用数组
+#define KEY_STREAM_STATE "stream_state" // 流式响应状态
+#define KEY_STREAM_OP "stream_op"       // 双向流操作类型
+#define KEY_STREAM_DATA "stream_data"   // 双向流数据
+#define KEY_CREDIT "credit"             // 双向流发送额度
+#define KEY_TIMEOUT "timeout"           // 请求的剩余超时时间（毫秒）
 
     // 应用层协议中的消息类型
     enum class MType
@@ -41,8 +69,13 @@ namespace public_data
         Resp_rpc,    // RPC响应
         Req_topic,   // 主题请求
         Resp_topic,  // 主题响应
-        Req_service, // 服务请求
-        Resp_service // 服务响应
+        Req_service,   // 服务请求
+        Resp_service,  // 服务响应
+        Req_batch_rpc,  // 批量RPC请求
+        Resp_batch_rpc, // 批量RPC响应
+        Resp_stream_rpc, // 流式RPC响应
+        Stream_frame,    // 双向流帧，两个方向使用同一种类型
+        MType_count      // 消息类型个数，不是合法的消息类型，新类型需要添加在此之前
     };
 
     // 返回状态码
@@ -57,7 +90,11 @@ namespace public_data
         RCode_not_found_service, // 未找到服务
         RCode_invalid_opType,    // 无效操作类型
         RCode_not_found_topic,   // 未找到主题
-        RCode_internal_error     // 内部错误
+        RCode_internal_error,    // 内部错误
+        RCode_overloaded,        // 服务过载
+        RCode_timeout,           // 请求超时
+        RCode_too_large,         // 数据过大
+        RCode_count              // 状态码个数，不是合法的状态码，新状态码需要添加在此之前
     };
 
     // 获取错误原因字符串
@@ -85,6 +122,12 @@ namespace public_data
             return "未找到主题";
         case RCode::RCode_internal_error:
             return "内部错误";
+        case RCode::RCode_overloaded:
+            return "服务过载";
+        case RCode::RCode_timeout:
+            return "请求超时";
+        case RCode::RCode_too_large:
+            return "数据过大";
         default:
             return "无指定的错误原因";
         }
@@ -96,7 +139,27 @@ namespace public_data
     enum class RType
     {
         Req_async = 0, // 异步模式
-        Req_callback   // 回调模式
+        Req_callback,  // 回调模式
+        Req_stream     // 流式模式，一个请求对应多个响应
+    };
+
+    // 流式响应状态
+    enum class StreamState
+    {
+        Stream_item = 0, // 流中的一个元素
+        Stream_end,      // 流正常结束
+        Stream_error     // 流异常结束，原因见返回状态码
+    };
+
+    // 双向流操作类型
+    enum class StreamOptype
+    {
+        Stream_open = 0, // 打开流，携带方法名、对端的初始额度和可选的超时时间
+        Stream_accept,   // 接受打开，携带状态码和对端的初始额度
+        Stream_data,     // 数据帧，消耗一个额度
+        Stream_credit,   // 归还额度
+        Stream_close,    // 本端不再发送数据（半关闭）
+        Stream_reset     // 异常终止，携带状态码
     };
 
     // 主题操作类型
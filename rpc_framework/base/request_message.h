@@ -15,15 +15,17 @@ namespace request_message
         // 实现检查方法
         virtual bool check() override
         {
-            // 判断方法名是否存在且为字符串
-            if (body_[KEY_METHOD].isNull() || !body_[KEY_METHOD].isString())
+            // 判断方法名或者方法编号是否存在
+            // 协商过方法表的客户端只携带方法编号，其余客户端携带方法名
+            if ((body()[KEY_METHOD].isNull() || !body()[KEY_METHOD].isString()) &&
+                (body()[KEY_METHOD_ID].isNull() || !body()[KEY_METHOD_ID].isInt()))
             {
                 LOG(Level::Warning, "方法名错误");
                 return false;
             }
 
             // 判断参数是否存在且为JSON对象
-            if (body_[KEY_PARAMS].isNull() || !body_[KEY_PARAMS].isObject())
+            if (body()[KEY_PARAMS].isNull() || !body()[KEY_PARAMS].isObject())
             {
                 LOG(Level::Warning, "参数错误");
                 return false;
@@ -36,24 +38,42 @@ namespace request_message
         void setMethod(const std::string &m)
         {
             // method_ = m;
-            body_[KEY_METHOD] = m;
+            mutableBody()[KEY_METHOD] = m;
         }
 
         std::string getMethod()
         {
-            return body_[KEY_METHOD].asString();
+            return stringField(KEY_METHOD);
+        }
+
+        // 设置和获取方法编号
+        // 方法编号由服务端方法表分配，不存在时返回-1
+        void setMethodId(int id)
+        {
+            mutableBody()[KEY_METHOD_ID] = id;
+        }
+
+        int getMethodId()
+        {
+            return intField(KEY_METHOD_ID, -1);
+        }
+
+        // 删除方法编号，只按方法名调用
+        void clearMethodId()
+        {
+            mutableBody().removeMember(KEY_METHOD_ID);
         }
 
         // 设置和获取参数
         void setParams(const Json::Value &p)
         {
             // parameters_ = p;
-            body_[KEY_PARAMS] = p;
+            mutableBody()[KEY_PARAMS] = p;
         }
 
         Json::Value getParams()
         {
-            return body_[KEY_PARAMS];
+            return body()[KEY_PARAMS];
         }
 
     // private:
@@ -75,7 +95,7 @@ namespace request_message
         {
             // 检查主题名称
             // 判断主题是否存在且为字符串
-            if (body_[KEY_TOPIC_KEY].isNull() || !body_[KEY_TOPIC_KEY].isString())
+            if (body()[KEY_TOPIC_KEY].isNull() || !body()[KEY_TOPIC_KEY].isString())
             {
                 LOG(Level::Warning, "主题名称错误");
                 return false;
@@ -83,7 +103,7 @@ namespace request_message
 
             // 检查主题操作类型
             // 判断是否存在操作类型且为整数
-            if (body_[KEY_OPTYPE].isNull() || !body_[KEY_OPTYPE].isInt())
+            if (body()[KEY_OPTYPE].isNull() || !body()[KEY_OPTYPE].isInt())
             {
                 LOG(Level::Warning, "主题操作类型错误");
                 return false;
@@ -91,8 +111,8 @@ namespace request_message
 
             // 检查消息
             // 判断是否为Topic_publish，如果是再检查是否存在消息且为字符串
-            if (body_[KEY_OPTYPE].asInt() == static_cast<int>(public_data::TopicOptype::Topic_publish) &&
-                (body_[KEY_TOPIC_MSG].isNull() || !body_[KEY_TOPIC_MSG].isString()))
+            if (body()[KEY_OPTYPE].asInt() == static_cast<int>(public_data::TopicOptype::Topic_publish) &&
+                (body()[KEY_TOPIC_MSG].isNull() || !body()[KEY_TOPIC_MSG].isString()))
             {
                 LOG(Level::Warning, "主题消息错误");
                 return false;
@@ -105,39 +125,39 @@ namespace request_message
         void setTopicName(const std::string &n)
         {
             // name_ = n;
-            body_[KEY_TOPIC_KEY] = n;
+            mutableBody()[KEY_TOPIC_KEY] = n;
         }
 
         std::string getTopicName()
         {
             // return name_;
-            return body_[KEY_TOPIC_KEY].asString();
+            return stringField(KEY_TOPIC_KEY);
         }
 
         // 设置和获取主题操作类型
         void setTopicOptype(const public_data::TopicOptype &op)
         {
             // op_ = op;
-            body_[KEY_OPTYPE] = static_cast<int>(op);
+            mutableBody()[KEY_OPTYPE] = static_cast<int>(op);
         }
 
         public_data::TopicOptype getTopicOptype()
         {
             // return op_;
-            return static_cast<public_data::TopicOptype>(body_[KEY_OPTYPE].asInt());
+            return static_cast<public_data::TopicOptype>(intField(KEY_OPTYPE));
         }
 
         // 设置和获取主题信息
         void setMessage(const std::string &m)
         {
             // message_ = m;
-            body_[KEY_TOPIC_MSG] = m;
+            mutableBody()[KEY_TOPIC_MSG] = m;
         }
 
         std::string getMessage()
         {
             // return message_;
-            return body_[KEY_TOPIC_MSG].asString();
+            return body()[KEY_TOPIC_MSG].asString();
         }
 
     // private:
@@ -158,7 +178,7 @@ namespace request_message
         {
             // 检查方法名
             // 判断方法名是否存在且为字符串
-            if (body_[KEY_METHOD].isNull() || !body_[KEY_METHOD].isString())
+            if (body()[KEY_METHOD].isNull() || !body()[KEY_METHOD].isString())
             {
                 LOG(Level::Warning, "方法名称错误");
                 return false;
@@ -166,7 +186,7 @@ namespace request_message
 
             // 检查主题操作类型
             // 判断是否存在操作类型且为整数
-            if (body_[KEY_OPTYPE].isNull() || !body_[KEY_OPTYPE].isInt())
+            if (body()[KEY_OPTYPE].isNull() || !body()[KEY_OPTYPE].isInt())
             {
                 LOG(Level::Warning, "服务操作类型错误");
                 return false;
@@ -176,10 +196,10 @@ namespace request_message
             // 判断是否存在主机信息
             // ! 为什么是不等于而不是等于？因为服务发现是需要将主机信息作为结果返回给上层
             // ! 而对于其他服务类型来说，都需要在请求中携带自己的信息用于写入到注册中心
-            if ((body_[KEY_OPTYPE].asInt() != static_cast<int>(public_data::ServiceOptype::Service_discover)) &&
-                (body_[KEY_HOST].isNull() || !body_[KEY_HOST].isObject()) &&
-                (body_[KEY_HOST][KEY_HOST_IP].isNull() || !body_[KEY_HOST][KEY_HOST_IP].isString()) &&
-                (body_[KEY_HOST][KEY_HOST_PORT].isNull() || !body_[KEY_HOST][KEY_HOST_PORT].isInt()))
+            if ((body()[KEY_OPTYPE].asInt() != static_cast<int>(public_data::ServiceOptype::Service_discover)) &&
+                (body()[KEY_HOST].isNull() || !body()[KEY_HOST].isObject()) &&
+                (body()[KEY_HOST][KEY_HOST_IP].isNull() || !body()[KEY_HOST][KEY_HOST_IP].isString()) &&
+                (body()[KEY_HOST][KEY_HOST_PORT].isNull() || !body()[KEY_HOST][KEY_HOST_PORT].isInt()))
             {
                 LOG(Level::Warning, "主机信息错误");
                 return false;
@@ -191,25 +211,25 @@ namespace request_message
         // 设置/获取服务操作类型
         void setServiceOptype(const public_data::ServiceOptype so)
         {
-            body_[KEY_OPTYPE] = static_cast<int>(so);
+            mutableBody()[KEY_OPTYPE] = static_cast<int>(so);
         }
 
         public_data::ServiceOptype getServiceOptye()
         {
-            return static_cast<public_data::ServiceOptype>(body_[KEY_OPTYPE].asInt());
+            return static_cast<public_data::ServiceOptype>(body()[KEY_OPTYPE].asInt());
         }
 
         // 设置和获取方法名
         void setMethod(const std::string& n)
         {
             // name_ = n;
-            body_[KEY_METHOD] = n;
+            mutableBody()[KEY_METHOD] = n;
         }
 
         std::string getMethod()
         {
             // return name_;
-            return body_[KEY_METHOD].asString();
+            return body()[KEY_METHOD].asString();
         }
 
         // 设置和获取服务操作类型
@@ -222,15 +242,15 @@ namespace request_message
             // ! 这里不需要指定host，直接指定IP和Port即可，再将整体存入到host中
             val[KEY_HOST_IP] = host.first;
             val[KEY_HOST_PORT] = host.second;
-            body_[KEY_HOST] = val;
+            mutableBody()[KEY_HOST] = val;
         }
 
         public_data::host_addr_t getHost()
         {
             // return host_;
             public_data::host_addr_t host;
-            host.first = body_[KEY_HOST][KEY_HOST_IP].asString();
-            host.second = body_[KEY_HOST][KEY_HOST_PORT].asInt();
+            host.first = body()[KEY_HOST][KEY_HOST_IP].asString();
+            host.second = body()[KEY_HOST][KEY_HOST_PORT].asInt();
 
             return host;
         }
@@ -241,6 +261,79 @@ namespace request_message
         // public_data::ServiceOptype op_; // 服务操作类型
         // public_data::host_addr_t host_; // 主机信息
     };
+
+    // 批量Rpc请求类
+    // 正文部分是一个调用数组，每一个元素都是一次调用的方法（或方法编号）和参数
+    class BatchRpcRequest : public json_message::JsonRequest
+    {
+    public:
+        using ptr = std::shared_ptr<BatchRpcRequest>;
+        // 检查调用数组以及其中的每一次调用
+        virtual bool check() override
+        {
+            const Json::Value &calls = body()[KEY_BATCH];
+            if (calls.isNull() || !calls.isArray())
+            {
+                LOG(Level::Warning, "批量调用数组错误");
+                return false;
+            }
+
+            for (const auto &c : calls)
+            {
+                if ((c[KEY_METHOD].isNull() || !c[KEY_METHOD].isString()) &&
+                    (c[KEY_METHOD_ID].isNull() || !c[KEY_METHOD_ID].isInt()))
+                {
+                    LOG(Level::Warning, "批量调用中的方法名错误");
+                    return false;
+                }
+
+                if (c[KEY_PARAMS].isNull() || !c[KEY_PARAMS].isObject())
+                {
+                    LOG(Level::Warning, "批量调用中的参数错误");
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        // 添加一次调用，方法编号小于0时携带方法名
+        void addCall(const std::string &method, int method_id, const Json::Value &params)
+        {
+            Json::Value call;
+            if (method_id >= 0)
+                call[KEY_METHOD_ID] = method_id;
+            else
+                call[KEY_METHOD] = method;
+            call[KEY_PARAMS] = params;
+
+            mutableBody()[KEY_BATCH].append(call);
+        }
+
+        // 获取调用个数
+        size_t callCount()
+        {
+            const Json::Value &calls = body()[KEY_BATCH];
+            return calls.isArray() ? calls.size() : 0;
+        }
+
+        // 获取第i次调用的方法名、方法编号和参数
+        std::string getMethod(size_t i)
+        {
+            return body()[KEY_BATCH][static_cast<Json::ArrayIndex>(i)][KEY_METHOD].asString();
+        }
+
+        int getMethodId(size_t i)
+        {
+            const Json::Value &id = body()[KEY_BATCH][static_cast<Json::ArrayIndex>(i)][KEY_METHOD_ID];
+            return id.isInt() ? id.asInt() : -1;
+        }
+
+        const Json::Value &getParams(size_t i)
+        {
+            return body()[KEY_BATCH][static_cast<Json::ArrayIndex>(i)][KEY_PARAMS];
+        }
+    };
 }
 
 #endif
\ No newline at end of file
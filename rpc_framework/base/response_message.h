@@ -15,7 +15,7 @@ namespace response_message
         virtual bool check() override
         {
             // 判断返回状态码
-            if (body_[KEY_RCODE].isNull() || !body_[KEY_RCODE].isInt())
+            if (body()[KEY_RCODE].isNull() || !body()[KEY_RCODE].isInt())
             {
                 LOG(Level::Warning, "返回状态码错误");
                 return false;
@@ -24,7 +24,7 @@ namespace response_message
             // 判断返回值
             // 因为返回值可能不止一种类型，所以此处不判断返回值的类型是否正确
             // 而是交给上层进行处理
-            if (body_[KEY_RESULT].isNull())
+            if (body()[KEY_RESULT].isNull())
             {
                 LOG(Level::Warning, "返回值错误");
                 return false;
@@ -37,12 +37,19 @@ namespace response_message
         // 获取和设置返回值
         void setResult(const Json::Value &v)
         {
-            body_[KEY_RESULT] = v;
+            mutableBody()[KEY_RESULT] = v;
         }
 
         Json::Value getResult()
         {
-            return body_[KEY_RESULT];
+            return body()[KEY_RESULT];
+        }
+
+        // 取走返回值，不复制，之后响应中不再保存返回值
+        // 用于响应只交给一个调用者的场景
+        Json::Value takeResult()
+        {
+            return std::move(mutableBody()[KEY_RESULT]);
         }
     };
 
@@ -62,13 +69,13 @@ namespace response_message
         virtual bool check() override
         {
             // 判断返回状态码
-            if (body_[KEY_RCODE].isNull() || !body_[KEY_RCODE].isInt())
+            if (body()[KEY_RCODE].isNull() || !body()[KEY_RCODE].isInt())
             {
                 LOG(Level::Warning, "返回状态码错误");
                 return false;
             }
 
-            if (body_[KEY_OPTYPE].isNull() || !body_[KEY_OPTYPE].isInt())
+            if (body()[KEY_OPTYPE].isNull() || !body()[KEY_OPTYPE].isInt())
             {
                 LOG(Level::Warning, "服务操作类型错误");
                 return false;
@@ -76,9 +83,9 @@ namespace response_message
 
             // 判断操作类型是否存在且为Service_discover
             // 如果存在需要判断是否存在方法名和主机信息数组
-            if ((body_[KEY_OPTYPE].isInt() == static_cast<int>(public_data::ServiceOptype::Service_discover)) &&
-                (body_[KEY_METHOD].isNull() || !body_[KEY_METHOD].isString()) &&
-                (body_[KEY_HOST].isNull() || !body_[KEY_HOST].isArray()))
+            if ((body()[KEY_OPTYPE].isInt() == static_cast<int>(public_data::ServiceOptype::Service_discover)) &&
+                (body()[KEY_METHOD].isNull() || !body()[KEY_METHOD].isString()) &&
+                (body()[KEY_HOST].isNull() || !body()[KEY_HOST].isArray()))
             {
                 LOG(Level::Warning, "操作类型为Service_discover，但是返回值错误");
                 return false;
@@ -90,23 +97,23 @@ namespace response_message
         // 设置/获取服务类型
         public_data::ServiceOptype getServiceOptype()
         {
-            return static_cast<public_data::ServiceOptype>(body_[KEY_OPTYPE].asInt());
+            return static_cast<public_data::ServiceOptype>(body()[KEY_OPTYPE].asInt());
         }
 
         void setServiceOptye(const public_data::ServiceOptype& o)
         {
-            body_[KEY_OPTYPE] = static_cast<int>(o);
+            mutableBody()[KEY_OPTYPE] = static_cast<int>(o);
         }
 
         // 设置/获取方法名和主机信息
         void setMethod(const std::string &name)
         {
-            body_[KEY_METHOD] = name;
+            mutableBody()[KEY_METHOD] = name;
         }
 
         std::string getMethod()
         {
-            return body_[KEY_METHOD].asString();
+            return body()[KEY_METHOD].asString();
         }
 
         // ! 注意主机信息是一个数组
@@ -118,21 +125,143 @@ namespace response_message
                 host[KEY_HOST_IP] = h.first;
                 host[KEY_HOST_PORT] = h.second;
 
-                body_[KEY_HOST].append(host); 
+                mutableBody()[KEY_HOST].append(host); 
             });
         }
 
         std::vector<public_data::host_addr_t> getHosts()
         {
             std::vector<public_data::host_addr_t> hosts;
-            int length = body_[KEY_HOST].size();
+            int length = body()[KEY_HOST].size();
             for (int i = 0; i < length; i++)
-                hosts.emplace_back(body_[KEY_HOST][i][KEY_HOST_IP].asString(),
-                                   body_[KEY_HOST][i][KEY_HOST_PORT].asInt());
+                hosts.emplace_back(body()[KEY_HOST][i][KEY_HOST_IP].asString(),
+                                   body()[KEY_HOST][i][KEY_HOST_PORT].asInt());
 
             return hosts;
         }
     };
+
+    // 批量Rpc响应类
+    // 外层状态码表示整个批量请求是否被处理，结果数组与请求中的调用按位置一一对应
+    class BatchRpcResponse : public json_message::JsonResponse
+    {
+    public:
+        using ptr = std::shared_ptr<BatchRpcResponse>;
+
+        virtual bool check() override
+        {
+            if (body()[KEY_RCODE].isNull() || !body()[KEY_RCODE].isInt())
+            {
+                LOG(Level::Warning, "返回状态码错误");
+                return false;
+            }
+
+            if (!body()[KEY_BATCH].isNull() && !body()[KEY_BATCH].isArray())
+            {
+                LOG(Level::Warning, "批量结果数组错误");
+                return false;
+            }
+
+            return true;
+        }
+
+        // 按调用顺序添加一次调用的状态码和返回值
+        void addResult(public_data::RCode rcode, const Json::Value &result)
+        {
+            Json::Value val;
+            val[KEY_RCODE] = static_cast<int>(rcode);
+            val[KEY_RESULT] = result;
+
+            mutableBody()[KEY_BATCH].append(val);
+        }
+
+        // 获取结果个数
+        size_t resultCount()
+        {
+            const Json::Value &results = body()[KEY_BATCH];
+            return results.isArray() ? results.size() : 0;
+        }
+
+        // 获取第i次调用的状态码和返回值
+        public_data::RCode getRCode(size_t i)
+        {
+            return static_cast<public_data::RCode>(body()[KEY_BATCH][static_cast<Json::ArrayIndex>(i)][KEY_RCODE].asInt());
+        }
+
+        Json::Value getResult(size_t i)
+        {
+            return body()[KEY_BATCH][static_cast<Json::ArrayIndex>(i)][KEY_RESULT];
+        }
+
+        // 取走第i次调用的返回值，不复制
+        Json::Value takeResult(size_t i)
+        {
+            return std::move(mutableBody()[KEY_BATCH][static_cast<Json::ArrayIndex>(i)][KEY_RESULT]);
+        }
+
+        // 外层状态码
+        using json_message::JsonResponse::getRCode;
+    };
+
+    // 流式Rpc响应类
+    // 一次流式调用对应多个响应：若干个元素响应，最后以一个结束或者错误响应收尾
+    class RpcStreamResponse : public json_message::JsonResponse
+    {
+    public:
+        using ptr = std::shared_ptr<RpcStreamResponse>;
+
+        virtual bool check() override
+        {
+            if (body()[KEY_RCODE].isNull() || !body()[KEY_RCODE].isInt())
+            {
+                LOG(Level::Warning, "返回状态码错误");
+                return false;
+            }
+
+            if (body()[KEY_STREAM_STATE].isNull() || !body()[KEY_STREAM_STATE].isInt())
+            {
+                LOG(Level::Warning, "流式响应状态错误");
+                return false;
+            }
+
+            // 元素响应必须携带返回值
+            if (getStreamState() == public_data::StreamState::Stream_item && body()[KEY_RESULT].isNull())
+            {
+                LOG(Level::Warning, "流式响应元素错误");
+                return false;
+            }
+
+            return true;
+        }
+
+        // 设置/获取流式响应状态
+        void setStreamState(public_data::StreamState state)
+        {
+            mutableBody()[KEY_STREAM_STATE] = static_cast<int>(state);
+        }
+
+        public_data::StreamState getStreamState()
+        {
+            return static_cast<public_data::StreamState>(intField(KEY_STREAM_STATE));
+        }
+
+        // 设置/获取流中的元素
+        void setResult(const Json::Value &v)
+        {
+            mutableBody()[KEY_RESULT] = v;
+        }
+
+        Json::Value getResult()
+        {
+            return body()[KEY_RESULT];
+        }
+
+        // 取走元素，不复制，之后响应中不再保存该元素
+        Json::Value takeResult()
+        {
+            return std::move(mutableBody()[KEY_RESULT]);
+        }
+    };
 }
 
 #endif
\ No newline at end of file
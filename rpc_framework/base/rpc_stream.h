@@ -0,0 +1,518 @@
+#ifndef __rpc_rpc_stream_h__
+#define __rpc_rpc_stream_h__
+
+#include <deque>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <chrono>
+#include <functional>
+#include <unordered_map>
+#include <condition_variable>
+#include <rpc_framework/base/base_connection.h>
+#include <rpc_framework/base/stream_message.h>
+#include <rpc_framework/factories/message_factory.h>
+#include <rpc_framework/base/log.h>
+
+// 双向流模块
+// 客户端和服务端共用，一个连接上可以同时存在多个流，通过流ID区分，与普通调用互不影响
+// 流量控制基于额度：每发送一个数据帧消耗一个对端授予的额度，额度为0时不能继续发送
+// 接收端在数据被处理后归还额度，因此对端缓存的数据不会超过接收窗口
+namespace rpc_stream
+{
+    using namespace log_system;
+
+    class RpcStream
+    {
+    public:
+        using ptr = std::shared_ptr<RpcStream>;
+        // 收到数据时的回调
+        using data_callback_t = std::function<void(const Json::Value &)>;
+        // 对端关闭或者流被终止时的回调，正常关闭时状态码为RCode_fine
+        using close_callback_t = std::function<void(public_data::RCode)>;
+        // 流结束后从所属的流表中移除
+        using release_callback_t = std::function<void(const base_connection::BaseConnection::ptr &, const std::string &)>;
+
+        RpcStream(const base_connection::BaseConnection::ptr &con, const std::string &id, const std::string &method, int recv_window, const release_callback_t &release)
+            : con_(con), id_(id), method_(method), recv_window_(recv_window > 0 ? recv_window : 1), recv_outstanding_(recv_window_), release_(release)
+        {
+        }
+
+        // 阻塞写入，没有额度时等待对端归还额度，最多等待timeout_ms（小于0表示不限制）
+        // 超时说明对端不再读取，终止流并返回false，不会让写入者一直阻塞
+        // ! 额度由IO线程归还，不能在IO线程（例如数据回调）中调用，IO线程中使用tryWrite
+        bool write(const Json::Value &data, int timeout_ms = public_data::default_stream_credit_timeout)
+        {
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+            std::unique_lock<std::mutex> lock(mtx_);
+            while (send_credit_ <= 0 && !local_closed_ && !reset_)
+            {
+                if (!con_->connected())
+                    return false;
+                if (timeout_ms >= 0 && std::chrono::steady_clock::now() >= deadline)
+                {
+                    LOG(Level::Warning, "双向流：{} 等待发送额度超时", id_);
+                    lock.unlock();
+                    reset(public_data::RCode::RCode_timeout);
+                    return false;
+                }
+                send_cond_.wait_for(lock, std::chrono::milliseconds(100));
+            }
+
+            return sendData(data);
+        }
+
+        // 非阻塞写入，没有额度时直接返回false
+        bool tryWrite(const Json::Value &data)
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            if (send_credit_ <= 0)
+                return false;
+
+            return sendData(data);
+        }
+
+        // 半关闭：本端不再发送数据，依旧可以接收对端的数据
+        void close()
+        {
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                if (local_closed_ || reset_)
+                    return;
+
+                local_closed_ = true;
+                sendFrame(public_data::StreamOptype::Stream_close);
+                send_cond_.notify_all();
+            }
+
+            releaseIfFinished();
+        }
+
+        // 终止流，两个方向都不再收发数据
+        void reset(public_data::RCode rcode)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                if (reset_)
+                    return;
+
+                reset_ = true;
+                reset_code_ = rcode;
+                sendReset(con_, id_, rcode);
+                send_cond_.notify_all();
+                recv_cond_.notify_all();
+            }
+
+            releaseIfFinished();
+        }
+
+        // 设置数据回调
+        // 设置后数据在IO线程中直接交给回调，回调返回后归还额度；设置前收到的数据会先交给回调
+        // 未设置时数据进入接收队列，通过read读取
+        // ! 不能在回调中重新设置回调
+        void setDataCallback(const data_callback_t &cb)
+        {
+            std::unique_lock<std::mutex> deliver_lock(deliver_mtx_);
+            std::deque<Json::Value> pending;
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                data_cb_ = cb;
+                pending.swap(recv_queue_);
+            }
+
+            for (auto &data : pending)
+                cb(data);
+            consume(static_cast<int>(pending.size()));
+        }
+
+        // 设置关闭回调，对端已经关闭时立即调用
+        void setCloseCallback(const close_callback_t &cb)
+        {
+            public_data::RCode rcode;
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                close_cb_ = cb;
+                if (!remote_closed_ && !reset_)
+                    return;
+                rcode = reset_ ? reset_code_ : public_data::RCode::RCode_fine;
+            }
+
+            cb(rcode);
+        }
+
+        // 阻塞读取，对端关闭且数据读完或者流被终止时返回false
+        bool read(Json::Value &data)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                recv_cond_.wait(lock, [this]()
+                                { return !recv_queue_.empty() || remote_closed_ || reset_; });
+                if (recv_queue_.empty() || reset_)
+                    return false;
+
+                data = std::move(recv_queue_.front());
+                recv_queue_.pop_front();
+            }
+
+            consume(1);
+            return true;
+        }
+
+        const std::string &id() const
+        {
+            return id_;
+        }
+
+        const std::string &method() const
+        {
+            return method_;
+        }
+
+        base_connection::BaseConnection::ptr connection() const
+        {
+            return con_;
+        }
+
+        // 对端是否已经接受打开请求
+        bool accepted()
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            return accepted_;
+        }
+
+        // 当前可用的发送额度
+        int sendCredit()
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            return send_credit_;
+        }
+
+        // 以下接口由流表在IO线程中调用
+
+        // 服务端接受打开请求：记录客户端授予的额度，并回复本端的接收窗口
+        void accept(int credit)
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            accepted_ = true;
+            send_credit_ += credit;
+
+            auto msg = buildFrame(public_data::StreamOptype::Stream_accept);
+            msg->setRCode(public_data::RCode::RCode_fine);
+            msg->setCredit(recv_window_);
+            con_->send(msg);
+        }
+
+        // 客户端收到接受帧
+        void onAccept(int credit)
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            accepted_ = true;
+            send_credit_ += credit;
+            send_cond_.notify_all();
+        }
+
+        void onData(const Json::Value &data)
+        {
+            std::unique_lock<std::mutex> deliver_lock(deliver_mtx_);
+            data_callback_t cb;
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                if (remote_closed_ || reset_)
+                    return;
+
+                // 对端超出额度发送，说明对端没有遵守流量控制
+                if (recv_outstanding_ <= 0)
+                {
+                    LOG(Level::Warning, "双向流：{} 对端超出额度发送数据", id_);
+                    lock.unlock();
+                    reset(public_data::RCode::RCode_invalid_msg);
+                    return;
+                }
+                recv_outstanding_--;
+
+                if (!data_cb_)
+                {
+                    recv_queue_.push_back(data);
+                    recv_cond_.notify_one();
+                    return;
+                }
+                cb = data_cb_;
+            }
+
+            cb(data);
+            consume(1);
+        }
+
+        void onCredit(int credit)
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            send_credit_ += credit;
+            send_cond_.notify_all();
+        }
+
+        void onClose()
+        {
+            close_callback_t cb;
+            {
+                std::unique_lock<std::mutex> deliver_lock(deliver_mtx_);
+                std::unique_lock<std::mutex> lock(mtx_);
+                if (remote_closed_ || reset_)
+                    return;
+
+                remote_closed_ = true;
+                recv_cond_.notify_all();
+                cb = close_cb_;
+            }
+
+            if (cb)
+                cb(public_data::RCode::RCode_fine);
+            releaseIfFinished();
+        }
+
+        void onReset(public_data::RCode rcode)
+        {
+            close_callback_t cb;
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                if (reset_)
+                    return;
+
+                reset_ = true;
+                reset_code_ = rcode;
+                send_cond_.notify_all();
+                recv_cond_.notify_all();
+                cb = close_cb_;
+            }
+
+            if (cb)
+                cb(rcode);
+            releaseIfFinished();
+        }
+
+        // 发送终止帧，用于不存在对应流对象时拒绝对端
+        static void sendReset(const base_connection::BaseConnection::ptr &con, const std::string &id, public_data::RCode rcode)
+        {
+            auto msg = message_factory::MessageFactory::messageCreateFactory<stream_message::StreamMessage>();
+            msg->setId(id);
+            msg->setMType(public_data::MType::Stream_frame);
+            msg->setStreamOptype(public_data::StreamOptype::Stream_reset);
+            msg->setRCode(rcode);
+            con->send(msg);
+        }
+
+    private:
+        // 发送数据帧，调用前需要持有锁
+        bool sendData(const Json::Value &data)
+        {
+            if (local_closed_ || reset_ || !con_->connected())
+                return false;
+
+            send_credit_--;
+            auto msg = buildFrame(public_data::StreamOptype::Stream_data);
+            msg->setData(data);
+            con_->send(msg);
+
+            return true;
+        }
+
+        // 发送不带额外字段的帧，调用前需要持有锁
+        void sendFrame(public_data::StreamOptype op)
+        {
+            con_->send(buildFrame(op));
+        }
+
+        stream_message::StreamMessage::ptr buildFrame(public_data::StreamOptype op)
+        {
+            auto msg = message_factory::MessageFactory::messageCreateFactory<stream_message::StreamMessage>();
+            msg->setId(id_);
+            msg->setMType(public_data::MType::Stream_frame);
+            msg->setStreamOptype(op);
+            return msg;
+        }
+
+        // 数据处理完成后归还额度
+        // 累计到接收窗口的一半时才发送额度帧，减少额度帧的个数
+        void consume(int n)
+        {
+            if (n <= 0)
+                return;
+
+            std::unique_lock<std::mutex> lock(mtx_);
+            consumed_ += n;
+            if (consumed_ < std::max(1, recv_window_ / 2) || remote_closed_ || reset_)
+                return;
+
+            auto msg = buildFrame(public_data::StreamOptype::Stream_credit);
+            msg->setCredit(consumed_);
+            recv_outstanding_ += consumed_;
+            consumed_ = 0;
+            con_->send(msg);
+        }
+
+        // 两个方向都结束或者流被终止后从流表中移除
+        void releaseIfFinished()
+        {
+            release_callback_t release;
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                if (released_ || !((local_closed_ && remote_closed_) || reset_))
+                    return;
+
+                released_ = true;
+                release.swap(release_);
+            }
+
+            if (release)
+                release(con_, id_);
+        }
+
+    private:
+        std::mutex mtx_;                    // 保护流状态，同时保证多个线程写入时帧的顺序
+        std::mutex deliver_mtx_;            // 保证数据按到达顺序交给回调
+        std::condition_variable send_cond_; // 等待发送额度
+        std::condition_variable recv_cond_; // 等待接收数据
+        base_connection::BaseConnection::ptr con_;
+        std::string id_;
+        std::string method_;
+        int recv_window_;                   // 本端的接收窗口
+        int recv_outstanding_;              // 对端还可以发送的数据帧个数
+        int consumed_ = 0;                  // 已经处理但还未归还的额度
+        int send_credit_ = 0;               // 本端可以发送的数据帧个数
+        bool accepted_ = false;
+        bool local_closed_ = false;
+        bool remote_closed_ = false;
+        bool reset_ = false;
+        bool released_ = false;
+        public_data::RCode reset_code_ = public_data::RCode::RCode_fine;
+        std::deque<Json::Value> recv_queue_; // 未设置数据回调时的接收队列，长度不超过接收窗口
+        data_callback_t data_cb_;
+        close_callback_t close_cb_;
+        release_callback_t release_;
+    };
+
+    // 流表
+    // 保存一个端点上所有活跃的流，并将收到的帧交给对应的流
+    // 流ID由打开流的一端生成，不同连接上的流ID可能相同，因此以连接和流ID共同作为键
+    class StreamTable : public std::enable_shared_from_this<StreamTable>
+    {
+    public:
+        using ptr = std::shared_ptr<StreamTable>;
+
+        // 创建流并加入流表，该连接上的流ID已经存在时返回空
+        RpcStream::ptr createStream(const base_connection::BaseConnection::ptr &con, const std::string &id, const std::string &method, int recv_window)
+        {
+            // 流结束时通过弱引用从流表中移除，流表先于流销毁时不做处理
+            std::weak_ptr<StreamTable> weak_table = shared_from_this();
+            RpcStream::ptr stream = std::make_shared<RpcStream>(con, id, method, recv_window, [weak_table](const base_connection::BaseConnection::ptr &scon, const std::string &sid)
+                                                                {
+                auto table = weak_table.lock();
+                if (table)
+                    table->removeStream(scon, sid); });
+
+            std::unique_lock<std::mutex> lock(manage_mtx_);
+            if (!streams_.insert({key_t(con.get(), id), stream}).second)
+            {
+                LOG(Level::Warning, "双向流ID：{} 已经存在", id);
+                return nullptr;
+            }
+
+            return stream;
+        }
+
+        RpcStream::ptr findStream(const base_connection::BaseConnection::ptr &con, const std::string &id)
+        {
+            std::unique_lock<std::mutex> lock(manage_mtx_);
+            auto pos = streams_.find(key_t(con.get(), id));
+            if (pos == streams_.end())
+                return nullptr;
+
+            return pos->second;
+        }
+
+        void removeStream(const base_connection::BaseConnection::ptr &con, const std::string &id)
+        {
+            std::unique_lock<std::mutex> lock(manage_mtx_);
+            streams_.erase(key_t(con.get(), id));
+        }
+
+        // 将数据、额度、关闭和终止帧交给对应的流
+        // 流不存在时（例如已经超时放弃的打开请求收到迟到的接受帧）回复终止帧，对端不会一直保留该流
+        // 终止帧和额度帧不回复：流结束后仍可能收到对端在结束前发出的额度帧，对端不会因此等待
+        bool dispatch(const base_connection::BaseConnection::ptr &con, const stream_message::StreamMessage::ptr &msg)
+        {
+            RpcStream::ptr stream = findStream(con, msg->getReqRespId());
+            if (!stream)
+            {
+                LOG(Level::Warning, "不存在双向流：{}", msg->getReqRespId());
+                public_data::StreamOptype op = msg->getStreamOptype();
+                if (op != public_data::StreamOptype::Stream_reset && op != public_data::StreamOptype::Stream_credit)
+                    RpcStream::sendReset(con, msg->getReqRespId(), public_data::RCode::RCode_invalid_msg);
+                return false;
+            }
+
+            switch (msg->getStreamOptype())
+            {
+            case public_data::StreamOptype::Stream_data:
+                stream->onData(msg->getData());
+                break;
+            case public_data::StreamOptype::Stream_credit:
+                stream->onCredit(msg->getCredit());
+                break;
+            case public_data::StreamOptype::Stream_close:
+                stream->onClose();
+                break;
+            case public_data::StreamOptype::Stream_reset:
+                stream->onReset(msg->getRCode());
+                break;
+            case public_data::StreamOptype::Stream_accept:
+                stream->onAccept(msg->getCredit());
+                break;
+            default:
+                LOG(Level::Warning, "双向流：{} 收到错误的操作类型", msg->getReqRespId());
+                return false;
+            }
+
+            return true;
+        }
+
+        // 连接断开时终止该连接上的所有流
+        void handleConnectionShutdown(const base_connection::BaseConnection::ptr &con)
+        {
+            std::vector<RpcStream::ptr> streams;
+            {
+                std::unique_lock<std::mutex> lock(manage_mtx_);
+                for (auto it = streams_.begin(); it != streams_.end();)
+                {
+                    if (it->first.first == con.get())
+                    {
+                        streams.push_back(it->second);
+                        it = streams_.erase(it);
+                    }
+                    else
+                        ++it;
+                }
+            }
+
+            for (auto &stream : streams)
+                stream->onReset(public_data::RCode::RCode_disconneted);
+        }
+
+    private:
+        // 流对象持有连接，流存在期间连接地址不会被复用
+        using key_t = std::pair<const base_connection::BaseConnection *, std::string>;
+
+        struct KeyHash
+        {
+            size_t operator()(const key_t &key) const
+            {
+                return std::hash<const void *>{}(key.first) ^ std::hash<std::string>{}(key.second);
+            }
+        };
+
+    private:
+        std::mutex manage_mtx_;
+        std::unordered_map<key_t, RpcStream::ptr, KeyHash> streams_; // 连接和流ID与流对象的映射
+    };
+}
+
+#endif
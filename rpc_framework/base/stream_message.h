@@ -0,0 +1,148 @@
+#ifndef __rpc_stream_message_h__
+#define __rpc_stream_message_h__
+
+#include <rpc_framework/base/json_message.h>
+
+namespace stream_message
+{
+    using namespace log_system;
+
+    // 双向流帧
+    // 流中两个方向的所有帧都使用这一个消息类，ID字段即为流ID
+    // 正文中的操作类型决定其余字段：打开帧携带方法名和额度，接受帧携带状态码和额度，
+    // 数据帧携带数据，额度帧携带归还的额度，终止帧携带状态码
+    class StreamMessage : public json_message::JsonMessage
+    {
+    public:
+        using ptr = std::shared_ptr<StreamMessage>;
+
+        virtual bool check() override
+        {
+            if (body()[KEY_STREAM_OP].isNull() || !body()[KEY_STREAM_OP].isInt())
+            {
+                LOG(Level::Warning, "双向流操作类型错误");
+                return false;
+            }
+
+            switch (getStreamOptype())
+            {
+            case public_data::StreamOptype::Stream_open:
+                if (body()[KEY_METHOD].isNull() || !body()[KEY_METHOD].isString())
+                {
+                    LOG(Level::Warning, "打开双向流时方法名错误");
+                    return false;
+                }
+                return checkCredit();
+            case public_data::StreamOptype::Stream_accept:
+                return checkRCode() && checkCredit();
+            case public_data::StreamOptype::Stream_data:
+                if (body()[KEY_STREAM_DATA].isNull())
+                {
+                    LOG(Level::Warning, "双向流数据为空");
+                    return false;
+                }
+                return true;
+            case public_data::StreamOptype::Stream_credit:
+                return checkCredit();
+            case public_data::StreamOptype::Stream_close:
+                return true;
+            case public_data::StreamOptype::Stream_reset:
+                return checkRCode();
+            default:
+                LOG(Level::Warning, "未知的双向流操作类型");
+                return false;
+            }
+        }
+
+        // 设置/获取操作类型
+        void setStreamOptype(public_data::StreamOptype op)
+        {
+            mutableBody()[KEY_STREAM_OP] = static_cast<int>(op);
+        }
+
+        public_data::StreamOptype getStreamOptype()
+        {
+            return static_cast<public_data::StreamOptype>(intField(KEY_STREAM_OP));
+        }
+
+        // 设置/获取方法名
+        void setMethod(const std::string &m)
+        {
+            mutableBody()[KEY_METHOD] = m;
+        }
+
+        std::string getMethod()
+        {
+            return stringField(KEY_METHOD);
+        }
+
+        // 设置/获取数据
+        void setData(const Json::Value &data)
+        {
+            mutableBody()[KEY_STREAM_DATA] = data;
+        }
+
+        Json::Value getData()
+        {
+            return body()[KEY_STREAM_DATA];
+        }
+
+        // 设置/获取额度
+        void setCredit(int credit)
+        {
+            mutableBody()[KEY_CREDIT] = credit;
+        }
+
+        int getCredit()
+        {
+            return intField(KEY_CREDIT);
+        }
+
+        // 设置/获取打开流的超时时间，不存在时返回-1表示不限制
+        void setTimeout(int timeout_ms)
+        {
+            mutableBody()[KEY_TIMEOUT] = timeout_ms;
+        }
+
+        int getTimeout()
+        {
+            return intField(KEY_TIMEOUT, -1);
+        }
+
+        // 设置/获取状态码
+        void setRCode(public_data::RCode r)
+        {
+            mutableBody()[KEY_RCODE] = static_cast<int>(r);
+        }
+
+        public_data::RCode getRCode()
+        {
+            return static_cast<public_data::RCode>(intField(KEY_RCODE));
+        }
+
+    private:
+        bool checkCredit()
+        {
+            if (body()[KEY_CREDIT].isNull() || !body()[KEY_CREDIT].isInt() || body()[KEY_CREDIT].asInt() < 0)
+            {
+                LOG(Level::Warning, "双向流额度错误");
+                return false;
+            }
+
+            return true;
+        }
+
+        bool checkRCode()
+        {
+            if (body()[KEY_RCODE].isNull() || !body()[KEY_RCODE].isInt())
+            {
+                LOG(Level::Warning, "返回状态码错误");
+                return false;
+            }
+
+            return true;
+        }
+    };
+}
+
+#endif
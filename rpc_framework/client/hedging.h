@@ -0,0 +1,139 @@
+#ifndef __rpc_hedging_h__
+#define __rpc_hedging_h__
+
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include "jsoncpp/json/json.h"
+#include <rpc_framework/utils/token_budget.h>
+
+namespace rpc_client
+{
+    namespace hedging
+    {
+        // 对冲请求策略
+        // 请求发出后超过最近耗时的percentile分位数仍未返回时，向另一个服务提供者再发送一份相同的请求
+        // 先返回成功的结果生效，另一个结果被忽略；只适用于只读（幂等）的方法
+        struct HedgePolicy
+        {
+            double percentile = 0.95;  // 触发对冲的耗时分位数
+            double budget_ratio = 0.05; // 对冲请求最多占普通请求的比例
+            int min_delay_ms = 1;       // 对冲等待时间的下限（毫秒）
+            size_t min_samples = 20;    // 收集到足够的耗时样本之前不进行对冲
+        };
+
+        // 单个方法的对冲状态：最近的耗时样本、对冲预算和统计信息
+        class Hedger
+        {
+        public:
+            using ptr = std::shared_ptr<Hedger>;
+            using duration_t = std::chrono::steady_clock::duration;
+
+            Hedger(const HedgePolicy &policy)
+                : policy_(policy), budget_(policy.budget_ratio, max_tokens)
+            {
+                samples_.reserve(window_size);
+            }
+
+            // 记录一次成功调用的耗时
+            // 每收集refresh_interval个样本重新计算一次等待时间，避免每次调用都排序
+            void record(duration_t latency)
+            {
+                int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+                std::unique_lock<std::mutex> lock(mtx_);
+                if (samples_.size() < window_size)
+                    samples_.push_back(us);
+                else
+                    samples_[next_++ % window_size] = us;
+
+                if (++since_refresh_ >= refresh_interval || delay_us_ < 0)
+                    refreshDelay();
+            }
+
+            // 获取对冲前等待的时间，样本不足时返回-1表示不进行对冲
+            std::chrono::microseconds delay()
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                return std::chrono::microseconds(delay_us_);
+            }
+
+            // 一次普通调用，增加对冲预算
+            void onCall()
+            {
+                budget_.deposit();
+                std::unique_lock<std::mutex> lock(mtx_);
+                calls_++;
+            }
+
+            // 尝试发起一次对冲，预算不足时返回false
+            bool tryHedge()
+            {
+                bool ok = budget_.tryAcquire();
+                std::unique_lock<std::mutex> lock(mtx_);
+                if (ok)
+                    hedges_++;
+                else
+                    throttled_++;
+                return ok;
+            }
+
+            // 对冲请求先于原请求返回成功
+            void onHedgeWin()
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                hedge_wins_++;
+            }
+
+            // 获取统计信息：{calls, hedges, hedge_wins, throttled, delay_us}
+            Json::Value stats()
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                Json::Value result;
+                result["calls"] = static_cast<Json::UInt64>(calls_);
+                result["hedges"] = static_cast<Json::UInt64>(hedges_);
+                result["hedge_wins"] = static_cast<Json::UInt64>(hedge_wins_);
+                result["throttled"] = static_cast<Json::UInt64>(throttled_);
+                result["delay_us"] = static_cast<Json::Int64>(delay_us_);
+                return result;
+            }
+
+        private:
+            static const size_t window_size = 256;     // 保留的最近样本个数
+            static const size_t refresh_interval = 32; // 重新计算等待时间的样本间隔
+            static constexpr double max_tokens = 10;   // 对冲预算允许的突发个数
+
+            // 调用者需要持有锁
+            void refreshDelay()
+            {
+                since_refresh_ = 0;
+                if (samples_.size() < policy_.min_samples)
+                    return;
+
+                std::vector<int64_t> sorted(samples_);
+                size_t index = static_cast<size_t>(policy_.percentile * (sorted.size() - 1));
+                std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+                delay_us_ = std::max<int64_t>(sorted[index], policy_.min_delay_ms * 1000LL);
+            }
+
+        private:
+            HedgePolicy policy_;
+            token_budget::TokenBudget budget_;
+
+            std::mutex mtx_;
+            std::vector<int64_t> samples_; // 最近的耗时样本（微秒），环形使用
+            size_t next_ = 0;              // 下一个被覆盖的样本位置
+            size_t since_refresh_ = 0;     // 上一次计算等待时间之后的样本个数
+            int64_t delay_us_ = -1;        // 当前的对冲等待时间（微秒），-1表示样本不足
+
+            uint64_t calls_ = 0;      // 调用次数
+            uint64_t hedges_ = 0;     // 发出的对冲请求个数
+            uint64_t hedge_wins_ = 0; // 对冲请求先返回成功的次数
+            uint64_t throttled_ = 0;  // 因为预算不足放弃对冲的次数
+        };
+    }
+}
+
+#endif
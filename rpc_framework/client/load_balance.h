@@ -0,0 +1,581 @@
+#ifndef __rpc_load_balance_h__
+#define __rpc_load_balance_h__
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include "jsoncpp/json/json.h"
+#include <rpc_framework/base/public_data.h>
+
+namespace rpc_client
+{
+    namespace outlier
+    {
+        class OutlierDetector;
+    }
+
+    namespace rpc_caller
+    {
+        class CallObserver;
+    }
+
+    namespace load_balance
+    {
+        // 负载均衡策略
+        enum class Strategy
+        {
+            RoundRobin = 0,     // 轮询
+            LeastOutstanding,   // 选择未完成请求最少的提供者
+            P2CEwma,            // 随机选择两个提供者，选择耗时（EWMA）与未完成请求综合代价更小的一个
+            WeightedRoundRobin, // 按权重平滑轮询
+            ConsistentHash      // 按请求的哈希键一致性哈希，相同的键发送给同一个提供者
+        };
+
+        inline const char *strategyName(Strategy strategy)
+        {
+            switch (strategy)
+            {
+            case Strategy::RoundRobin:
+                return "round_robin";
+            case Strategy::LeastOutstanding:
+                return "least_outstanding";
+            case Strategy::P2CEwma:
+                return "p2c_ewma";
+            case Strategy::WeightedRoundRobin:
+                return "weighted_round_robin";
+            case Strategy::ConsistentHash:
+                return "consistent_hash";
+            }
+            return "unknown";
+        }
+
+        // 服务提供者的健康状态
+        enum class HostState
+        {
+            Healthy = 0, // 正常
+            Ejected,     // 被隔离，隔离时间内不选择
+            Probing      // 隔离到期后已经发出试探请求，等待结果
+        };
+
+        inline const char *hostStateName(HostState state)
+        {
+            switch (state)
+            {
+            case HostState::Healthy:
+                return "healthy";
+            case HostState::Ejected:
+                return "ejected";
+            case HostState::Probing:
+                return "probing";
+            }
+            return "unknown";
+        }
+
+        // 一个服务提供者的负载信息和健康状态，调用开始和结束时更新，只使用原子操作
+        // 健康状态由outlier::OutlierDetector修改，负载均衡器选择时跳过被隔离的提供者
+        class HostStats
+        {
+        public:
+            using ptr = std::shared_ptr<HostStats>;
+            using clock_t = std::chrono::steady_clock;
+            using duration_t = clock_t::duration;
+
+            // 发出一个请求
+            void onStart()
+            {
+                outstanding_.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            // 请求结束，成功时记录耗时
+            void onFinish(duration_t latency, bool ok)
+            {
+                outstanding_.fetch_sub(1, std::memory_order_relaxed);
+                if (!ok)
+                    return;
+
+                // 新耗时占1/8的权重，与TCP估计RTT的方式相同；第一个样本直接作为初始值
+                int64_t sample = std::max<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(latency).count(), 1);
+                int64_t cur = ewma_us_.load(std::memory_order_relaxed);
+                int64_t next = 0;
+                do
+                {
+                    next = cur == 0 ? sample : cur + (sample - cur) / 8;
+                } while (!ewma_us_.compare_exchange_weak(cur, next, std::memory_order_relaxed));
+            }
+
+            int64_t outstanding() const
+            {
+                return outstanding_.load(std::memory_order_relaxed);
+            }
+
+            // 耗时的指数加权移动平均（微秒），0表示还没有样本
+            int64_t ewmaUs() const
+            {
+                return ewma_us_.load(std::memory_order_relaxed);
+            }
+
+            HostState state() const
+            {
+                return static_cast<HostState>(state_.load(std::memory_order_acquire));
+            }
+
+            // 是否可以选择：正常，或者隔离已经到期可以发出试探请求
+            bool available() const
+            {
+                return state() == HostState::Healthy || clock_t::now().time_since_epoch().count() >= until_.load(std::memory_order_acquire);
+            }
+
+            // 选中后确认是否可以发送，probe返回试探请求编号，不是试探请求时为0
+            // 隔离到期后只允许一个线程发出试探请求，同时把下一次试探推迟probe_interval，防止试探请求丢失后一直无法恢复
+            // 再次发出试探请求后之前的试探请求作废，只有最新编号的结果决定是否恢复
+            bool tryAdmit(int64_t &probe)
+            {
+                probe = 0;
+                if (state() == HostState::Healthy)
+                    return true;
+
+                int64_t now = clock_t::now().time_since_epoch().count();
+                int64_t until = until_.load(std::memory_order_acquire);
+                if (now < until)
+                    return false;
+                if (!until_.compare_exchange_strong(until, now + probe_interval_.load(std::memory_order_relaxed), std::memory_order_acq_rel))
+                    return false;
+
+                probe = probes_.fetch_add(1, std::memory_order_relaxed) + 1;
+                probe_id_.store(probe, std::memory_order_release);
+                state_.store(static_cast<int>(HostState::Probing), std::memory_order_release);
+                return true;
+            }
+
+            // 隔离duration，到期后试探
+            void eject(duration_t duration)
+            {
+                probe_interval_.store(duration.count(), std::memory_order_relaxed);
+                until_.store((clock_t::now() + duration).time_since_epoch().count(), std::memory_order_release);
+                state_.store(static_cast<int>(HostState::Ejected), std::memory_order_release);
+            }
+
+            // 恢复正常，隔离前的耗时已经过时，重新统计
+            void restore()
+            {
+                consecutive_errors_.store(0, std::memory_order_relaxed);
+                ewma_us_.store(0, std::memory_order_relaxed);
+                state_.store(static_cast<int>(HostState::Healthy), std::memory_order_release);
+            }
+
+            // 记录一次请求结果（是否为提供者的错误），返回连续错误次数
+            int64_t onResult(bool error)
+            {
+                interval_requests_.fetch_add(1, std::memory_order_relaxed);
+                if (!error)
+                {
+                    consecutive_errors_.store(0, std::memory_order_relaxed);
+                    return 0;
+                }
+
+                interval_errors_.fetch_add(1, std::memory_order_relaxed);
+                return consecutive_errors_.fetch_add(1, std::memory_order_relaxed) + 1;
+            }
+
+            // 获取并清空一个统计周期内的请求数和错误数
+            void takeInterval(int64_t &requests, int64_t &errors)
+            {
+                requests = interval_requests_.exchange(0, std::memory_order_relaxed);
+                errors = interval_errors_.exchange(0, std::memory_order_relaxed);
+            }
+
+            int64_t probes() const
+            {
+                return probes_.load(std::memory_order_relaxed);
+            }
+
+            // 当前试探请求的编号
+            int64_t probeId() const
+            {
+                return probe_id_.load(std::memory_order_acquire);
+            }
+
+        private:
+            std::atomic<int64_t> outstanding_{0}; // 未完成的请求个数
+            std::atomic<int64_t> ewma_us_{0};     // 耗时的指数加权移动平均（微秒）
+
+            std::atomic<int> state_{static_cast<int>(HostState::Healthy)}; // 健康状态
+            std::atomic<int64_t> until_{0};                                // 隔离结束（下一次允许试探）的时间，steady_clock计数
+            std::atomic<int64_t> probe_interval_{0};                       // 两次试探之间的最短间隔，steady_clock计数
+            std::atomic<int64_t> probes_{0};                               // 发出的试探请求个数
+            std::atomic<int64_t> probe_id_{0};                             // 当前试探请求的编号，同时作为试探请求的序号
+            std::atomic<int64_t> consecutive_errors_{0};                   // 连续错误次数
+            std::atomic<int64_t> interval_requests_{0};                    // 当前统计周期内的请求数
+            std::atomic<int64_t> interval_errors_{0};                      // 当前统计周期内的错误数
+        };
+
+        // 可以选择的服务提供者
+        struct Endpoint
+        {
+            public_data::host_addr_t host;
+            int weight = 1;        // 权重，只有加权轮询和一致性哈希使用
+            HostStats::ptr stats;  // 负载信息，主机列表变化后仍然沿用
+            std::shared_ptr<outlier::OutlierDetector> detector; // 方法的异常检测，为空表示不检测
+            std::shared_ptr<rpc_caller::CallObserver> observer; // 记录调用的负载信息和异常检测结果，与主机一起创建
+            int64_t probe = 0;     // 试探请求的编号，0表示不是试探请求，只在选择结果中设置
+        };
+        using endpoints_t = std::vector<Endpoint>;
+
+        // 负载均衡器
+        // 每次主机列表或者策略变化时根据新的主机列表重新创建，创建后主机列表不再变化
+        // 选择时只读取创建时计算好的数据和原子变量，多个线程可以同时选择
+        class LoadBalancer
+        {
+        public:
+            using ptr = std::shared_ptr<LoadBalancer>;
+
+            LoadBalancer(const endpoints_t &endpoints)
+                : endpoints_(endpoints)
+            {
+            }
+
+            virtual ~LoadBalancer() {}
+
+            // 选择一个不在excluded中的服务提供者，key为请求的哈希键，只有一致性哈希使用
+            // 先只在可以选择的（未被隔离或者可以试探的）提供者中选择，全部被隔离时忽略隔离状态，避免所有请求失败
+            // admit_probe为false时不发出试探请求，跳过还没有恢复的提供者，用于不会把结果交给异常检测的调用
+            // 没有可以选择的服务提供者时返回false
+            bool select(const std::string &key, const std::vector<public_data::host_addr_t> &excluded, Endpoint &endpoint, bool admit_probe = true)
+            {
+                size_t index = 0;
+                std::vector<public_data::host_addr_t> skipped; // 不发出试探请求时跳过的提供者，只在遇到时复制excluded
+                const std::vector<public_data::host_addr_t> *checked = &excluded;
+                // 多个线程同时争抢试探请求时，失败的线程重新选择，此时该提供者已经不可选择
+                for (size_t i = 0; i < endpoints_.size(); i++)
+                {
+                    if (!pick(key, *checked, true, index))
+                        break;
+                    if (!admit_probe)
+                    {
+                        if (endpoints_[index].stats->state() == HostState::Healthy)
+                        {
+                            endpoint = endpoints_[index];
+                            return true;
+                        }
+                        if (skipped.empty())
+                            skipped = excluded;
+                        skipped.push_back(endpoints_[index].host);
+                        checked = &skipped;
+                        continue;
+                    }
+
+                    int64_t probe = 0;
+                    if (endpoints_[index].stats->tryAdmit(probe))
+                    {
+                        endpoint = endpoints_[index];
+                        endpoint.probe = probe;
+                        return true;
+                    }
+                }
+
+                if (!pick(key, excluded, false, index))
+                    return false;
+
+                endpoint = endpoints_[index];
+                return true;
+            }
+
+            const endpoints_t &endpoints() const
+            {
+                return endpoints_;
+            }
+
+        protected:
+            // 按照策略选择下标，check_health为真时跳过不可选择的提供者
+            virtual bool pick(const std::string &key, const std::vector<public_data::host_addr_t> &excluded, bool check_health, size_t &index) = 0;
+
+            bool isExcluded(const std::vector<public_data::host_addr_t> &excluded, bool check_health, size_t index) const
+            {
+                if (check_health && !endpoints_[index].stats->available())
+                    return true;
+                return !excluded.empty() && std::find(excluded.begin(), excluded.end(), endpoints_[index].host) != excluded.end();
+            }
+
+            // 轮询找到一个没有被排除的下标，没有时返回false
+            // 遇到被排除的提供者时重新获取轮询位置而不是选择下一个，否则被排除的提供者的流量全部落到它后面的提供者上
+            bool nextIndex(const std::vector<public_data::host_addr_t> &excluded, bool check_health, size_t &index)
+            {
+                size_t pos = 0;
+                for (size_t i = 0; i < endpoints_.size(); i++)
+                {
+                    pos = next_.fetch_add(1, std::memory_order_relaxed);
+                    index = pos % endpoints_.size();
+                    if (!isExcluded(excluded, check_health, index))
+                        return true;
+                }
+
+                // 其他线程同时轮询时可能没有遍历到所有下标，最后再顺序检查一遍
+                for (size_t i = 1; i < endpoints_.size(); i++)
+                {
+                    index = (pos + i) % endpoints_.size();
+                    if (!isExcluded(excluded, check_health, index))
+                        return true;
+                }
+
+                return false;
+            }
+
+        protected:
+            const endpoints_t endpoints_;
+            std::atomic<size_t> next_{0}; // 轮询位置
+        };
+
+        // 轮询
+        class RoundRobinBalancer : public LoadBalancer
+        {
+        public:
+            using LoadBalancer::LoadBalancer;
+
+        protected:
+            bool pick(const std::string &, const std::vector<public_data::host_addr_t> &excluded, bool check_health, size_t &index) override
+            {
+                return nextIndex(excluded, check_health, index);
+            }
+        };
+
+        // 最少未完成请求
+        // 从轮询位置开始比较，未完成请求相同的提供者之间仍然轮询
+        class LeastOutstandingBalancer : public LoadBalancer
+        {
+        public:
+            using LoadBalancer::LoadBalancer;
+
+        protected:
+            bool pick(const std::string &, const std::vector<public_data::host_addr_t> &excluded, bool check_health, size_t &index) override
+            {
+                size_t start = next_.fetch_add(1, std::memory_order_relaxed);
+                size_t best = endpoints_.size();
+                int64_t best_outstanding = 0;
+                for (size_t i = 0; i < endpoints_.size(); i++)
+                {
+                    size_t cur = (start + i) % endpoints_.size();
+                    if (isExcluded(excluded, check_health, cur))
+                        continue;
+
+                    int64_t outstanding = endpoints_[cur].stats->outstanding();
+                    if (best == endpoints_.size() || outstanding < best_outstanding)
+                    {
+                        best = cur;
+                        best_outstanding = outstanding;
+                    }
+                }
+
+                if (best == endpoints_.size())
+                    return false;
+
+                index = best;
+                return true;
+            }
+        };
+
+        // 两次随机选择（power of two choices）
+        // 随机选择两个提供者，代价为EWMA耗时 * (未完成请求 + 1)，选择代价小的一个
+        // 只需要读取两个提供者的负载，避免所有客户端同时涌向同一个最空闲的提供者
+        class P2CEwmaBalancer : public LoadBalancer
+        {
+        public:
+            using LoadBalancer::LoadBalancer;
+
+        protected:
+            bool pick(const std::string &, const std::vector<public_data::host_addr_t> &excluded, bool check_health, size_t &index) override
+            {
+                // 存在被排除的主机时先找出所有候选主机，通常只有对冲、重试和存在隔离的提供者时才需要
+                std::vector<size_t> candidates;
+                size_t count = endpoints_.size();
+                if (!excluded.empty() || (check_health && !allHealthy()))
+                {
+                    for (size_t i = 0; i < endpoints_.size(); i++)
+                    {
+                        if (!isExcluded(excluded, check_health, i))
+                            candidates.push_back(i);
+                    }
+                    count = candidates.size();
+                }
+                if (count == 0)
+                    return false;
+
+                thread_local std::mt19937 rng(std::random_device{}());
+                size_t a = rng() % count;
+                size_t b = count > 1 ? (a + 1 + rng() % (count - 1)) % count : a;
+                if (!candidates.empty())
+                {
+                    a = candidates[a];
+                    b = candidates[b];
+                }
+
+                index = cost(a, b) <= cost(b, a) ? a : b;
+                return true;
+            }
+
+        private:
+            bool allHealthy() const
+            {
+                for (const auto &endpoint : endpoints_)
+                {
+                    if (endpoint.stats->state() != HostState::Healthy)
+                        return false;
+                }
+                return true;
+            }
+
+            // index的代价，还没有耗时样本时使用另一个提供者的耗时，只比较未完成请求
+            double cost(size_t index, size_t other) const
+            {
+                const auto &stats = endpoints_[index].stats;
+                int64_t ewma = stats->ewmaUs();
+                if (ewma == 0)
+                    ewma = endpoints_[other].stats->ewmaUs();
+                return static_cast<double>(ewma + 1) * static_cast<double>(stats->outstanding() + 1);
+            }
+        };
+
+        // 平滑加权轮询
+        // 创建时按照nginx的平滑加权轮询算法计算出一轮完整的选择顺序，选择时只需要原子地递增位置
+        // 例如权重{5, 1, 1}的顺序为a a b a c a a，而不是a a a a a b c
+        class WeightedRoundRobinBalancer : public LoadBalancer
+        {
+        public:
+            WeightedRoundRobinBalancer(const endpoints_t &endpoints)
+                : LoadBalancer(endpoints)
+            {
+                int total = 0;
+                std::vector<int> current(endpoints_.size(), 0);
+                for (const auto &endpoint : endpoints_)
+                    total += endpoint.weight;
+
+                for (int n = 0; n < total; n++)
+                {
+                    size_t best = 0;
+                    for (size_t i = 0; i < endpoints_.size(); i++)
+                    {
+                        current[i] += endpoints_[i].weight;
+                        if (current[i] > current[best])
+                            best = i;
+                    }
+                    current[best] -= total;
+                    schedule_.push_back(best);
+                }
+            }
+
+        protected:
+            bool pick(const std::string &, const std::vector<public_data::host_addr_t> &excluded, bool check_health, size_t &index) override
+            {
+                if (schedule_.empty())
+                    return false;
+
+                size_t start = next_.fetch_add(1, std::memory_order_relaxed);
+                for (size_t i = 0; i < schedule_.size(); i++)
+                {
+                    index = schedule_[(start + i) % schedule_.size()];
+                    if (!isExcluded(excluded, check_health, index))
+                        return true;
+                }
+
+                return false;
+            }
+
+        private:
+            std::vector<size_t> schedule_; // 一轮完整的选择顺序，长度为权重之和
+        };
+
+        // 一致性哈希
+        // 每个提供者在哈希环上放置virtual_nodes * 权重个虚拟节点，请求选择哈希键顺时针方向的第一个节点
+        // 提供者上线或者下线时只有相邻区间的键改变归属；被排除时继续沿顺时针方向寻找
+        class ConsistentHashBalancer : public LoadBalancer
+        {
+        public:
+            static const int virtual_nodes = 64; // 权重为1时的虚拟节点个数
+
+            ConsistentHashBalancer(const endpoints_t &endpoints)
+                : LoadBalancer(endpoints)
+            {
+                for (size_t i = 0; i < endpoints_.size(); i++)
+                {
+                    std::string name = endpoints_[i].host.first + ":" + std::to_string(endpoints_[i].host.second) + "#";
+                    for (int n = 0; n < virtual_nodes * endpoints_[i].weight; n++)
+                        ring_.emplace_back(hash(name + std::to_string(n)), i);
+                }
+                std::sort(ring_.begin(), ring_.end());
+            }
+
+            // FNV-1a哈希再经过splitmix64混合，结果不依赖标准库实现，不同进程中相同的键映射到相同的位置
+            static uint64_t hash(const std::string &key)
+            {
+                uint64_t h = 14695981039346656037ULL;
+                for (unsigned char c : key)
+                {
+                    h ^= c;
+                    h *= 1099511628211ULL;
+                }
+
+                h += 0x9e3779b97f4a7c15ULL;
+                h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+                h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+                return h ^ (h >> 31);
+            }
+
+        protected:
+            bool pick(const std::string &key, const std::vector<public_data::host_addr_t> &excluded, bool check_health, size_t &index) override
+            {
+                if (ring_.empty())
+                    return false;
+
+                auto pos = std::lower_bound(ring_.begin(), ring_.end(), std::make_pair(hash(key), static_cast<size_t>(0)));
+                size_t start = pos - ring_.begin();
+                for (size_t i = 0; i < ring_.size(); i++)
+                {
+                    index = ring_[(start + i) % ring_.size()].second;
+                    if (!isExcluded(excluded, check_health, index))
+                        return true;
+                }
+
+                return false;
+            }
+
+        private:
+            std::vector<std::pair<uint64_t, size_t>> ring_; // 哈希环：{节点哈希值, 提供者下标}
+        };
+
+        class LoadBalancerFactory
+        {
+        public:
+            static LoadBalancer::ptr create(Strategy strategy, const endpoints_t &endpoints)
+            {
+                switch (strategy)
+                {
+                case Strategy::LeastOutstanding:
+                    return std::make_shared<LeastOutstandingBalancer>(endpoints);
+                case Strategy::P2CEwma:
+                    return std::make_shared<P2CEwmaBalancer>(endpoints);
+                case Strategy::WeightedRoundRobin:
+                    return std::make_shared<WeightedRoundRobinBalancer>(endpoints);
+                case Strategy::ConsistentHash:
+                    return std::make_shared<ConsistentHashBalancer>(endpoints);
+                default:
+                    return std::make_shared<RoundRobinBalancer>(endpoints);
+                }
+            }
+        };
+
+        // 主机地址的哈希函数
+        struct HostAddrHash
+        {
+            size_t operator()(const public_data::host_addr_t &h) const
+            {
+                return std::hash<std::string>{}(h.first) ^ (static_cast<size_t>(h.second) * 0x9e3779b97f4a7c15ULL);
+            }
+        };
+    }
+}
+
+#endif
@@ -4,10 +4,16 @@
 #include <rpc_framework/client/requestor.h>
 #include <rpc_framework/client/rpc_registry_client.h>
 #include <rpc_framework/client/rpc_caller.h>
+#include <rpc_framework/client/rpc_stream_client.h>
 #include <rpc_framework/base/dispatcher.h>
 #include <rpc_framework/base/base_client.h>
 #include <rpc_framework/factories/client_factory.h>
 #include <rpc_framework/client/rpc_topic_client.h>
+#include <rpc_framework/client/hedging.h>
+#include <rpc_framework/client/retry.h>
+#include <rpc_framework/base/call_context.h>
+#include <rpc_framework/utils/timer_queue.h>
+#include <rpc_framework/utils/rcu_snapshot.h>
 
 namespace rpc_client
 {
@@ -25,6 +31,8 @@ namespace rpc_client
 
                 client_ = client_factory::ClientFactory::clientCreateFactory(ip, port);
                 client_->setMessageCallback(std::bind(&dispatcher_rpc_framework::Dispatcher::executeService, dispatcher_.get(), std::placeholders::_1, std::placeholders::_2));
+                // 连接断开时结束所有未完成的请求
+                client_->setCloseCallback(std::bind(&rpc_client::requestor_rpc_framework::Requestor::handleConnectionShutdown, requestor_.get(), std::placeholders::_1));
 
                 // 连接服务端
                 client_->connect();
@@ -59,6 +67,8 @@ namespace rpc_client
 
                 client_ = client_factory::ClientFactory::clientCreateFactory(ip, port);
                 client_->setMessageCallback(std::bind(&dispatcher_rpc_framework::Dispatcher::executeService, dispatcher_.get(), std::placeholders::_1, std::placeholders::_2));
+                // 连接断开时结束所有未完成的请求
+                client_->setCloseCallback(std::bind(&rpc_client::requestor_rpc_framework::Requestor::handleConnectionShutdown, requestor_.get(), std::placeholders::_1));
 
                 // 连接服务端
                 client_->connect();
@@ -68,6 +78,39 @@ namespace rpc_client
                 return discoverer_->discoverHost(client_->connection(), method, host);
             }
 
+            // 选择不在excluded中的服务提供者
+            bool toDiscoverHost(const std::string &method, const std::vector<public_data::host_addr_t> &excluded, public_data::host_addr_t &host)
+            {
+                return discoverer_->discoverHost(client_->connection(), method, excluded, host);
+            }
+
+            // 按照方法的负载均衡策略选择不在excluded中的服务提供者，同时返回提供者的负载信息
+            bool toDiscoverHost(const std::string &method, const std::string &key, const std::vector<public_data::host_addr_t> &excluded, load_balance::Endpoint &endpoint,
+                                bool admit_probe = true)
+            {
+                return discoverer_->discoverHost(client_->connection(), method, key, excluded, endpoint, admit_probe);
+            }
+
+            void setStrategy(const std::string &method, load_balance::Strategy strategy)
+            {
+                discoverer_->setStrategy(method, strategy);
+            }
+
+            void setHostWeight(const public_data::host_addr_t &host, int weight)
+            {
+                discoverer_->setHostWeight(host, weight);
+            }
+
+            void setOutlierPolicy(const std::string &method, const outlier::OutlierPolicy &policy, const outlier::OutlierDetector::event_callback_t &cb)
+            {
+                discoverer_->setOutlierPolicy(method, policy, cb);
+            }
+
+            Json::Value loadBalanceStats()
+            {
+                return discoverer_->stats();
+            }
+
             // void shutdown()
             // {
             //     client_->shutdown();
@@ -86,13 +129,18 @@ namespace rpc_client
         {
         public:
             using ptr = std::shared_ptr<RpcClient>;
+            using hash_key_t = std::function<std::string(const Json::Value &)>; // 从参数中计算一致性哈希的键
 
             RpcClient(bool isToDiscover, const std::string &ip, const uint16_t port)
                 : isToDiscover_(isToDiscover), requestor_(std::make_shared<requestor_rpc_framework::Requestor>()), dispatcher_(std::make_shared<dispatcher_rpc_framework::Dispatcher>()),
-                  rpc_caller_(std::make_shared<rpc_client::rpc_caller::RpcCaller>(requestor_))
+                  rpc_caller_(std::make_shared<rpc_client::rpc_caller::RpcCaller>(requestor_)),
+                  stream_caller_(std::make_shared<rpc_client::rpc_stream_client::StreamCaller>(requestor_))
             {
                 // 处理RPC调用的回调
                 dispatcher_->registerService<base_message::BaseMessage>(public_data::MType::Resp_rpc, std::bind(&rpc_client::requestor_rpc_framework::Requestor::handleResponse, requestor_.get(), std::placeholders::_1, std::placeholders::_2));
+                dispatcher_->registerService<base_message::BaseMessage>(public_data::MType::Resp_batch_rpc, std::bind(&rpc_client::requestor_rpc_framework::Requestor::handleResponse, requestor_.get(), std::placeholders::_1, std::placeholders::_2));
+                dispatcher_->registerService<stream_message::StreamMessage>(public_data::MType::Stream_frame, std::bind(&rpc_client::rpc_stream_client::StreamCaller::handleStreamMessage, stream_caller_.get(), std::placeholders::_1, std::placeholders::_2));
+                dispatcher_->registerService<base_message::BaseMessage>(public_data::MType::Resp_stream_rpc, std::bind(&rpc_client::requestor_rpc_framework::Requestor::handleResponse, requestor_.get(), std::placeholders::_1, std::placeholders::_2));
 
                 if (isToDiscover_)
                 {
@@ -106,10 +154,140 @@ namespace rpc_client
                     // 此时就是进行RPC调用
                     client_ = client_factory::ClientFactory::clientCreateFactory(ip, port);
                     client_->setMessageCallback(std::bind(&dispatcher_rpc_framework::Dispatcher::executeService, dispatcher_.get(), std::placeholders::_1, std::placeholders::_2));
+                    client_->setCloseCallback(std::bind(&RpcClient::handleConnectionShutdown, this, std::placeholders::_1));
 
                     // 连接服务端
                     client_->connect();
+                    // 获取服务端的方法表，之后的调用只携带方法编号
+                    rpc_caller_->fetchMethodTable(client_->connection());
+                }
+            }
+
+            // 定时线程和发送线程互相添加任务，先停止定时线程，再停止发送线程，发送线程中添加的定时任务被丢弃
+            // 客户端的回调绑定了当前对象，先停止服务发现（不再通知下线），再结束所有连接上未完成的调用并销毁客户端
+            // 客户端销毁时等待IO线程退出，之后不会再执行任何回调
+            ~RpcClient()
+            {
+                policy_timer_.stop();
+                policy_sender_.stop();
+                discoverer_client_.reset();
+
+                clients_t clients;
+                {
+                    std::unique_lock<std::mutex> lock(manage_map_mtx_);
+                    clients.swap(clients_);
+                }
+                for (auto &client : clients)
+                {
+                    if (client.second->connection())
+                        handleConnectionShutdown(client.second->connection());
+                }
+                clients.clear();
+                if (client_ && client_->connection())
+                    handleConnectionShutdown(client_->connection());
+                client_.reset();
+            }
+
+            // 设置方法的对冲策略
+            // 只能用于只读（幂等）的方法，需要开启服务发现并且存在多个服务提供者时才会发出对冲请求
+            // 对冲对同步、异步和回调方式的调用生效
+            void setHedgePolicy(const std::string &method_name, const hedging::HedgePolicy &policy)
+            {
+                auto hedger = std::make_shared<hedging::Hedger>(policy);
+                policies_.update([&](policies_t &policies)
+                                 { policies[method_name].hedger = hedger; });
+            }
+
+            // 设置方法的重试策略，同时将方法标记为幂等
+            // 只能用于幂等的方法，重试优先发送给还没有尝试过的服务提供者，没有其他提供者时重试原来的提供者
+            // 重试对同步、异步和回调方式的调用生效
+            void setRetryPolicy(const std::string &method_name, const retry::RetryPolicy &policy)
+            {
+                auto retrier = std::make_shared<retry::Retrier>(policy);
+                policies_.update([&](policies_t &policies)
+                                 { policies[method_name].retrier = retrier; });
+            }
+
+            // 设置方法的负载均衡策略，只在开启服务发现时生效，默认为轮询
+            // 一致性哈希使用hash_key从参数中计算请求的哈希键，为空时使用整个参数，相同参数的请求发送给同一个提供者
+            void setLoadBalance(const std::string &method_name, load_balance::Strategy strategy, const hash_key_t &hash_key = hash_key_t())
+            {
+                if (!isToDiscover_)
+                {
+                    LOG(Level::Warning, "未开启服务发现，负载均衡策略不生效");
+                    return;
+                }
+
+                discoverer_client_->setStrategy(method_name, strategy);
+                hash_key_t key = hash_key;
+                if (strategy != load_balance::Strategy::ConsistentHash)
+                    key = hash_key_t();
+                else if (!key)
+                    key = [](const Json::Value &params)
+                    { return json_util::JsonUtil::canonicalize(params); };
+                policies_.update([&](policies_t &policies)
+                                 { policies[method_name].hash_key = key; });
+            }
+
+            // 设置服务提供者的权重（1~100，默认为1），用于加权轮询和一致性哈希
+            void setHostWeight(const public_data::host_addr_t &host, int weight)
+            {
+                if (isToDiscover_)
+                    discoverer_client_->setHostWeight(host, weight);
+            }
+
+            // 开启方法的异常检测（熔断），只在开启服务发现时生效
+            // 连续出错、错误率过高或者明显慢于其他提供者的提供者被临时隔离，到期后试探成功自动恢复
+            // cb在提供者被隔离和恢复时调用，在记录请求结果的线程中执行，最近的事件也可以通过loadBalanceStats获取
+            void setOutlierPolicy(const std::string &method_name, const outlier::OutlierPolicy &policy,
+                                  const outlier::OutlierDetector::event_callback_t &cb = outlier::OutlierDetector::event_callback_t())
+            {
+                if (!isToDiscover_)
+                {
+                    LOG(Level::Warning, "未开启服务发现，异常检测不生效");
+                    return;
+                }
+
+                discoverer_client_->setOutlierPolicy(method_name, policy, cb);
+            }
+
+            // 获取负载均衡统计信息：{方法名: {strategy, hosts: [{host, weight, outstanding, ewma_us, state, probes}], outlier}}
+            Json::Value loadBalanceStats()
+            {
+                if (!isToDiscover_)
+                    return Json::Value(Json::objectValue);
+                return discoverer_client_->loadBalanceStats();
+            }
+
+            // 获取对冲统计信息：{方法名: {calls, hedges, hedge_wins, throttled, delay_us}}
+            Json::Value hedgeStats()
+            {
+                Json::Value result(Json::objectValue);
+                for (const auto &policy : *policies_.snapshot())
+                {
+                    if (policy.second.hedger)
+                        result[policy.first] = policy.second.hedger->stats();
+                }
+                return result;
+            }
+
+            // 获取重试统计信息：{方法名: {calls, retries, throttled, exhausted}}
+            Json::Value retryStats()
+            {
+                Json::Value result(Json::objectValue);
+                for (const auto &policy : *policies_.snapshot())
+                {
+                    if (policy.second.retrier)
+                        result[policy.first] = policy.second.retrier->stats();
                 }
+                return result;
+            }
+
+            // 设置默认超时时间（毫秒），小于0表示不限制
+            // 单次调用可以通过call_context::CallContext::Scope设置更短的超时时间
+            void setTimeout(int timeout_ms)
+            {
+                requestor_->setDefaultTimeout(timeout_ms);
             }
 
             // 同步函数
@@ -117,8 +295,30 @@ namespace rpc_client
             {
                 // debug
                 LOG(Level::Debug, "进入RpcClient的call同步函数");
+                // 只有设置了对冲或者重试的方法经过policyCall，其他调用直接发送，服务发现模式下由提供者的观察者记录负载和耗时
+                MethodPolicy policy;
+                if (findPolicy(method_name, policy) && (policy.hedger || policy.retrier))
+                {
+                    auto promise = std::make_shared<std::promise<Json::Value>>();
+                    std::future<Json::Value> future = promise->get_future();
+                    if (!policyCall(method_name, params, policy, futureDone(promise)))
+                        return false;
+
+                    try
+                    {
+                        result = future.get();
+                    }
+                    catch (const rpc_client::rpc_caller::RpcError &e)
+                    {
+                        LOG(Level::Warning, "结果异常，原因：{}", e.what());
+                        return false;
+                    }
+                    return true;
+                }
+
                 // 获取到指定的客户端调用
-                base_client::BaseClient::ptr client = getClient(method_name);
+                load_balance::Endpoint endpoint;
+                base_client::BaseClient::ptr client = getClient(method_name, hashKey(policy, params), std::vector<public_data::host_addr_t>(), endpoint);
                 if (!client)
                 {
                     LOG(Level::Warning, "获取客户端错误");
@@ -126,14 +326,23 @@ namespace rpc_client
                 }
 
                 // 调用Rpc调用接口执行任务
-                return rpc_caller_->call(client->connection(), method_name, params, result);
+                return rpc_caller_->call(client->connection(), method_name, params, result, endpoint.observer);
             }
 
             // 异步函数
             bool call(const std::string &method_name, const Json::Value &params, rpc_client::rpc_caller::RpcCaller::aysnc_response &result)
             {
+                MethodPolicy policy;
+                if (findPolicy(method_name, policy) && (policy.hedger || policy.retrier))
+                {
+                    auto promise = std::make_shared<std::promise<Json::Value>>();
+                    result = promise->get_future();
+                    return policyCall(method_name, params, policy, futureDone(promise));
+                }
+
                 // 获取到指定的客户端调用
-                base_client::BaseClient::ptr client = getClient(method_name);
+                load_balance::Endpoint endpoint;
+                base_client::BaseClient::ptr client = getClient(method_name, hashKey(policy, params), std::vector<public_data::host_addr_t>(), endpoint);
                 if (!client)
                 {
                     LOG(Level::Warning, "获取客户端错误");
@@ -141,14 +350,28 @@ namespace rpc_client
                 }
 
                 // 调用Rpc调用接口执行任务
-                return rpc_caller_->call(client->connection(), method_name, params, result);
+                return rpc_caller_->call(client->connection(), method_name, params, result, endpoint.observer);
             }
 
             // 回调函数
             bool call(const std::string &method_name, const Json::Value &params, const rpc_client::rpc_caller::RpcCaller::callback_t &cb)
             {
+                MethodPolicy policy;
+                if (findPolicy(method_name, policy) && (policy.hedger || policy.retrier))
+                {
+                    return policyCall(method_name, params, policy, [cb](public_data::RCode rcode, const Json::Value &result)
+                                      {
+                        if (rcode != public_data::RCode::RCode_fine)
+                        {
+                            LOG(Level::Warning, "结果异常，原因：{}", errReason(rcode));
+                            return;
+                        }
+                        cb(result); });
+                }
+
                 // 获取到指定的客户端调用
-                base_client::BaseClient::ptr client = getClient(method_name);
+                load_balance::Endpoint endpoint;
+                base_client::BaseClient::ptr client = getClient(method_name, hashKey(policy, params), std::vector<public_data::host_addr_t>(), endpoint);
                 if (!client)
                 {
                     LOG(Level::Warning, "获取客户端错误");
@@ -156,12 +379,357 @@ namespace rpc_client
                 }
 
                 // 调用Rpc调用接口执行任务
-                return rpc_caller_->call(client->connection(), method_name, params, cb);
+                return rpc_caller_->call(client->connection(), method_name, params, cb, endpoint.observer);
+            }
+
+#ifdef RPC_HAS_COROUTINE
+            // 协程调用函数：Json::Value result = co_await client.call("add", params);
+            // 获取客户端失败时在co_await处抛出RpcError
+            // ! 协程在连接的IO线程中恢复，恢复后不能执行阻塞操作，见RpcCaller::CallAwaiter
+            rpc_client::rpc_caller::RpcCaller::CallAwaiter call(const std::string &method_name, const Json::Value &params)
+            {
+                MethodPolicy policy;
+                findPolicy(method_name, policy);
+                load_balance::Endpoint endpoint;
+                base_client::BaseClient::ptr client = getClient(method_name, hashKey(policy, params), std::vector<public_data::host_addr_t>(), endpoint);
+                if (!client)
+                    LOG(Level::Warning, "获取客户端错误");
+
+                return rpc_caller_->call(client ? client->connection() : nullptr, method_name, params, endpoint.observer);
+            }
+#endif
+
+            // 流式调用函数
+            // 流的结果不交给异常检测，选择提供者时不发出试探请求
+            bool callStream(const std::string &method_name, const Json::Value &params,
+                            const rpc_client::rpc_caller::RpcCaller::stream_item_callback_t &item_cb,
+                            const rpc_client::rpc_caller::RpcCaller::stream_done_callback_t &done_cb)
+            {
+                load_balance::Endpoint endpoint;
+                base_client::BaseClient::ptr client = getClient(method_name, std::string(), std::vector<public_data::host_addr_t>(), endpoint, false);
+                if (!client)
+                {
+                    LOG(Level::Warning, "获取客户端错误");
+                    return false;
+                }
+
+                return rpc_caller_->callStream(client->connection(), method_name, params, item_cb, done_cb);
+            }
+
+            // 打开双向流，与流式调用一样不发出试探请求
+            bool openStream(const std::string &method_name, rpc_stream::RpcStream::ptr &stream, int recv_window = public_data::default_stream_window,
+                            int timeout_ms = public_data::default_stream_open_timeout)
+            {
+                load_balance::Endpoint endpoint;
+                base_client::BaseClient::ptr client = getClient(method_name, std::string(), std::vector<public_data::host_addr_t>(), endpoint, false);
+                if (!client)
+                {
+                    LOG(Level::Warning, "获取客户端错误");
+                    return false;
+                }
+
+                return stream_caller_->openStream(client->connection(), method_name, stream, recv_window, timeout_ms);
+            }
+
+            // 批量调用函数
+            // 一个批量请求只会发送给一个服务提供者，根据第一次调用的方法选择提供者
+            bool call(const rpc_client::rpc_caller::RpcBatch::ptr &batch)
+            {
+                if (!batch || batch->size() == 0)
+                {
+                    LOG(Level::Warning, "批量调用为空");
+                    return false;
+                }
+
+                load_balance::Endpoint endpoint;
+                base_client::BaseClient::ptr client = getClient(batch->firstMethod(), std::string(), std::vector<public_data::host_addr_t>(), endpoint);
+                if (!client)
+                {
+                    LOG(Level::Warning, "获取客户端错误");
+                    return false;
+                }
+
+                return rpc_caller_->call(client->connection(), batch, endpoint.observer);
             }
 
         private:
-            // 找到合适的客户端调用接口
-            base_client::BaseClient::ptr getClient(const std::string &method)
+            // 方法的调用策略
+            struct MethodPolicy
+            {
+                hedging::Hedger::ptr hedger;  // 对冲策略，为空表示不对冲
+                retry::Retrier::ptr retrier;  // 重试策略，为空表示不重试
+                hash_key_t hash_key;          // 一致性哈希的键，为空表示不使用一致性哈希
+            };
+
+            // 一次带有调用策略的调用状态，所有请求（原请求、对冲请求和重试请求）共享
+            struct PolicyCall
+            {
+                std::string method;
+                Json::Value params;
+                std::string key; // 一致性哈希的键，对冲和重试时沿用
+                MethodPolicy policy;
+                rpc_client::rpc_caller::RpcCaller::done_callback_t done; // 调用者的回调
+                bool has_deadline = false;                               // 调用者是否设置了截止时间
+                call_context::CallContext::clock_t::time_point deadline; // 调用者的截止时间，发送线程中发送请求时沿用
+
+                std::mutex mtx;
+                bool finished = false;                               // 是否已经交给调用者结果
+                int attempts = 0;                                    // 已经发送的请求个数（不包括对冲请求）
+                int outstanding = 0;                                 // 尚未返回的请求个数
+                std::vector<public_data::host_addr_t> hosts;         // 已经发送过的服务提供者
+                timer_queue::TimerQueue::timer_id_t timer_id = 0;    // 对冲或者重试定时器编号
+            };
+
+            using policies_t = std::unordered_map<std::string, MethodPolicy>;
+
+            // 读取策略快照，不加锁，只有方法存在策略时才复制
+            bool findPolicy(const std::string &method_name, MethodPolicy &policy)
+            {
+                const policies_t &policies = policies_.read();
+                auto pos = policies.find(method_name);
+                if (pos == policies.end())
+                    return false;
+
+                policy = pos->second;
+                return true;
+            }
+
+            // 一致性哈希的键，方法没有使用一致性哈希时为空
+            static std::string hashKey(const MethodPolicy &policy, const Json::Value &params)
+            {
+                return policy.hash_key ? policy.hash_key(params) : std::string();
+            }
+
+            // 结果交给future，失败时抛出RpcError
+            static rpc_client::rpc_caller::RpcCaller::done_callback_t futureDone(const std::shared_ptr<std::promise<Json::Value>> &promise)
+            {
+                return [promise](public_data::RCode rcode, const Json::Value &result)
+                {
+                    if (rcode == public_data::RCode::RCode_fine)
+                        promise->set_value(result);
+                    else
+                        promise->set_exception(std::make_exception_ptr(rpc_client::rpc_caller::RpcError(rcode)));
+                };
+            }
+
+            // 带有调用策略的调用
+            // 对冲：超过对冲等待时间仍未返回时向另一个服务提供者发送相同的请求，第一个成功的结果交给调用者
+            // 重试：所有已发送的请求都失败且状态码可以重试时，退避一段时间后向未尝试过的服务提供者重新发送
+            // 不再重试时返回最后一个错误
+            bool policyCall(const std::string &method_name, const Json::Value &params, const MethodPolicy &policy,
+                            const rpc_client::rpc_caller::RpcCaller::done_callback_t &done)
+            {
+                std::string key = hashKey(policy, params);
+                load_balance::Endpoint endpoint;
+                base_client::BaseClient::ptr client = getClient(method_name, key, std::vector<public_data::host_addr_t>(), endpoint);
+                if (!client)
+                {
+                    LOG(Level::Warning, "获取客户端错误");
+                    return false;
+                }
+
+                if (policy.hedger)
+                    policy.hedger->onCall();
+                if (policy.retrier)
+                    policy.retrier->onCall();
+
+                auto state = std::make_shared<PolicyCall>();
+                state->method = method_name;
+                state->params = params;
+                state->key = std::move(key);
+                state->policy = policy;
+                state->done = done;
+                state->has_deadline = call_context::CallContext::hasDeadline();
+                state->deadline = call_context::CallContext::deadline();
+                startAttempt(state, client, endpoint);
+                return true;
+            }
+
+            // 发送一次请求（第一次或者重试），开启对冲时同时添加对冲定时器
+            void startAttempt(const std::shared_ptr<PolicyCall> &state, const base_client::BaseClient::ptr &client, const load_balance::Endpoint &endpoint)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(state->mtx);
+                    state->attempts++;
+                    state->outstanding++;
+                    state->hosts.push_back(endpoint.host);
+
+                    // 只有服务发现模式下才可能存在其他服务提供者
+                    auto delay = state->policy.hedger ? state->policy.hedger->delay() : std::chrono::microseconds(-1);
+                    if (isToDiscover_ && delay.count() >= 0)
+                        state->timer_id = addPolicyTimer(delay, [this, state]()
+                                                         { sendHedge(state); });
+                }
+
+                sendAttempt(state, client, endpoint, false);
+            }
+
+            // 添加对冲或者重试定时器，到期后把发送交给发送线程
+            // 发送时可能进行服务发现或者建立连接，在定时线程中执行会推迟其他调用的对冲和重试
+            timer_queue::TimerQueue::timer_id_t addPolicyTimer(timer_queue::TimerQueue::clock_t::duration delay, const timer_queue::TimerQueue::task_t &send)
+            {
+                return policy_timer_.add(delay, [this, send]()
+                                         { policy_sender_.add(timer_queue::TimerQueue::clock_t::duration::zero(), send); });
+            }
+
+            // 对冲定时器到期，请求仍未返回时向另一个服务提供者发送请求，在发送线程中执行
+            void sendHedge(const std::shared_ptr<PolicyCall> &state)
+            {
+                std::vector<public_data::host_addr_t> excluded;
+                {
+                    // 所有请求都已经失败（正在等待重试）时不再对冲
+                    std::unique_lock<std::mutex> lock(state->mtx);
+                    if (state->finished || state->outstanding == 0)
+                        return;
+                    excluded = state->hosts;
+                }
+
+                load_balance::Endpoint endpoint;
+                base_client::BaseClient::ptr client = getClient(state->method, state->key, excluded, endpoint);
+                if (!client || !state->policy.hedger->tryHedge())
+                    return;
+
+                {
+                    std::unique_lock<std::mutex> lock(state->mtx);
+                    if (state->finished || state->outstanding == 0)
+                        return;
+                    state->outstanding++;
+                    state->hosts.push_back(endpoint.host);
+                }
+
+                LOG(Level::Debug, "方法：{}向{}:{}发送对冲请求", state->method, endpoint.host.first, endpoint.host.second);
+                sendAttempt(state, client, endpoint, true);
+            }
+
+            // 重试定时器到期，向还没有尝试过的服务提供者重新发送，所有提供者都尝试过时重新选择，在发送线程中执行
+            void sendRetry(const std::shared_ptr<PolicyCall> &state)
+            {
+                std::vector<public_data::host_addr_t> excluded;
+                {
+                    std::unique_lock<std::mutex> lock(state->mtx);
+                    if (state->finished)
+                        return;
+                    excluded = state->hosts;
+                }
+
+                load_balance::Endpoint endpoint;
+                base_client::BaseClient::ptr client = getClient(state->method, state->key, excluded, endpoint);
+                if (!client)
+                    client = getClient(state->method, state->key, std::vector<public_data::host_addr_t>(), endpoint);
+                if (!client)
+                {
+                    finishCall(state, public_data::RCode::RCode_disconneted, Json::Value());
+                    return;
+                }
+
+                LOG(Level::Debug, "方法：{}向{}:{}重试", state->method, endpoint.host.first, endpoint.host.second);
+                startAttempt(state, client, endpoint);
+            }
+
+            // 向一个服务提供者发送请求，结束时交给finishAttempt
+            // 在发送线程中发送时沿用调用者的截止时间；服务发现模式下由提供者的观察者记录未完成请求、耗时和健康状态
+            void sendAttempt(const std::shared_ptr<PolicyCall> &state, const base_client::BaseClient::ptr &client,
+                             const load_balance::Endpoint &endpoint, bool is_hedge)
+            {
+                auto start = std::chrono::steady_clock::now();
+                auto done = [this, state, start, is_hedge](public_data::RCode rcode, const Json::Value &result)
+                {
+                    if (rcode == public_data::RCode::RCode_fine && state->policy.hedger)
+                        state->policy.hedger->record(std::chrono::steady_clock::now() - start);
+                    finishAttempt(state, is_hedge, rcode, result);
+                };
+
+                if (!client->connected())
+                {
+                    // 连接未建立时不经过RpcCaller，同样记录到提供者的负载和健康状态中
+                    if (endpoint.observer)
+                    {
+                        endpoint.observer->onStart();
+                        endpoint.observer->onFinish(public_data::RCode::RCode_disconneted, std::chrono::steady_clock::duration::zero());
+                    }
+                    done(public_data::RCode::RCode_disconneted, Json::Value());
+                    return;
+                }
+
+                bool ret = false;
+                if (state->has_deadline)
+                {
+                    call_context::CallContext::Scope scope(state->deadline);
+                    ret = rpc_caller_->callAsync(client->connection(), state->method, state->params, done, endpoint.observer);
+                }
+                else
+                    ret = rpc_caller_->callAsync(client->connection(), state->method, state->params, done, endpoint.observer);
+
+                // 发送失败时RpcCaller已经通知观察者
+                if (!ret)
+                    done(public_data::RCode::RCode_disconneted, Json::Value());
+            }
+
+            // 一个请求结束
+            // 成功时立即结束调用，之后返回的结果被忽略；失败时等待其他未返回的请求，全部失败后决定是否重试
+            void finishAttempt(const std::shared_ptr<PolicyCall> &state, bool is_hedge, public_data::RCode rcode, const Json::Value &result)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(state->mtx);
+                    if (state->finished)
+                        return;
+                    state->outstanding--;
+                    if (rcode != public_data::RCode::RCode_fine)
+                    {
+                        if (state->outstanding > 0)
+                            return;
+
+                        // 超过调用者的截止时间后不再重试
+                        bool expired = state->has_deadline && call_context::CallContext::clock_t::now() >= state->deadline;
+                        const auto &retrier = state->policy.retrier;
+                        if (retrier && !expired && retrier->shouldRetry(state->attempts, rcode))
+                        {
+                            if (state->timer_id)
+                                policy_timer_.cancel(state->timer_id);
+                            state->timer_id = addPolicyTimer(retrier->backoff(state->attempts), [this, state]()
+                                                             { sendRetry(state); });
+                            return;
+                        }
+                    }
+                }
+
+                if (is_hedge && rcode == public_data::RCode::RCode_fine)
+                    state->policy.hedger->onHedgeWin();
+                finishCall(state, rcode, result);
+            }
+
+            // 结束调用，结果交给调用者，只执行一次
+            void finishCall(const std::shared_ptr<PolicyCall> &state, public_data::RCode rcode, const Json::Value &result)
+            {
+                rpc_client::rpc_caller::RpcCaller::done_callback_t done;
+                timer_queue::TimerQueue::timer_id_t timer_id = 0;
+                {
+                    std::unique_lock<std::mutex> lock(state->mtx);
+                    if (state->finished)
+                        return;
+                    state->finished = true;
+                    done = std::move(state->done);
+                    timer_id = state->timer_id;
+                }
+
+                if (timer_id)
+                    policy_timer_.cancel(timer_id);
+                done(rcode, result);
+            }
+
+            // 连接断开时结束该连接上所有未完成的调用和双向流，删除方法表
+            void handleConnectionShutdown(const base_connection::BaseConnection::ptr &con)
+            {
+                requestor_->handleConnectionShutdown(con);
+                stream_caller_->handleConnectionShutdown(con);
+                rpc_caller_->removeMethodTable(con);
+            }
+
+            // 按照方法的负载均衡策略选择不在excluded中的服务提供者，同时返回提供者的地址和负载信息（不使用服务发现时负载信息为空）
+            // 不使用服务发现时只有一个客户端，excluded不为空时返回nullptr
+            // 调用结果不会交给endpoint.observer时admit_probe必须为false，见HostManager::choostHost
+            base_client::BaseClient::ptr getClient(const std::string &method, const std::string &key, const std::vector<public_data::host_addr_t> &excluded, load_balance::Endpoint &endpoint,
+                                                   bool admit_probe = true)
             {
                 base_client::BaseClient::ptr client;
                 // 判断是否需要发现客户端
@@ -169,8 +737,7 @@ namespace rpc_client
                 // 否则使用固定的客户端返回信息
                 if (isToDiscover_)
                 {
-                    public_data::host_addr_t host;
-                    bool ret = discoverer_client_->toDiscoverHost(method, host);
+                    bool ret = discoverer_client_->toDiscoverHost(method, key, excluded, endpoint, admit_probe);
                     if (!ret)
                     {
                         LOG(Level::Warning, "Rpc客户端服务发现失败");
@@ -178,14 +745,14 @@ namespace rpc_client
                     }
 
                     // 判断是否已经存在对应的服务提供者
-                    client = findClient(host);
+                    client = findClient(endpoint.host);
                     if (!client)
                     {
                         // 不存在就创建
-                        client = createClient(host);
+                        client = createClient(endpoint.host);
                     }
                 }
-                else
+                else if (excluded.empty())
                 {
                     client = client_;
                 }
@@ -198,9 +765,11 @@ namespace rpc_client
             {
                 base_client::BaseClient::ptr client = client_factory::ClientFactory::clientCreateFactory(host.first, host.second);
                 client->setMessageCallback(std::bind(&dispatcher_rpc_framework::Dispatcher::executeService, dispatcher_.get(), std::placeholders::_1, std::placeholders::_2));
+                client->setCloseCallback(std::bind(&RpcClient::handleConnectionShutdown, this, std::placeholders::_1));
 
                 // 连接服务端
                 client->connect();
+                rpc_caller_->fetchMethodTable(client->connection());
 
                 insertClient(host, client);
 
@@ -208,6 +777,7 @@ namespace rpc_client
             }
 
             // 对客户端集合进行增、删和获取
+            // 客户端只由集合持有，删除后随之销毁，客户端的回调绑定了当前对象，不能让其他地方长期持有
             void insertClient(const public_data::host_addr_t &host, const base_client::BaseClient::ptr &client)
             {
                 std::unique_lock<std::mutex> lock(manage_map_mtx_);
@@ -216,15 +786,21 @@ namespace rpc_client
 
             void removeClient(const public_data::host_addr_t &host)
             {
-                std::unique_lock<std::mutex> lock(manage_map_mtx_);
-                auto pos = clients_.find(host);
-                if (pos == clients_.end())
+                base_client::BaseClient::ptr client;
                 {
-                    LOG(Level::Warning, "不存在指定的服务提供者，删除失败");
-                    return;
+                    std::unique_lock<std::mutex> lock(manage_map_mtx_);
+                    auto pos = clients_.find(host);
+                    if (pos == clients_.end())
+                    {
+                        LOG(Level::Warning, "不存在指定的服务提供者，删除失败");
+                        return;
+                    }
+                    client = pos->second;
+                    clients_.erase(pos);
                 }
 
-                clients_.erase(host);
+                // 服务提供者下线后客户端随之销毁，不会再收到响应
+                handleConnectionShutdown(client->connection());
             }
 
             base_client::BaseClient::ptr findClient(const public_data::host_addr_t &host)
@@ -232,10 +808,7 @@ namespace rpc_client
                 std::unique_lock<std::mutex> lock(manage_map_mtx_);
                 auto pos = clients_.find(host);
                 if (pos == clients_.end())
-                {
-                    LOG(Level::Warning, "不存在指定的服务提供者，删除失败");
                     return base_client::BaseClient::ptr();
-                }
 
                 return pos->second;
             }
@@ -252,14 +825,20 @@ namespace rpc_client
                     return std::hash<std::string>{}(host);
                 }
             };
+            using clients_t = std::unordered_map<public_data::host_addr_t, base_client::BaseClient::ptr, hostAddrHash>;
+
             bool isToDiscover_;                       // 是否需要进行服务发现
             DiscovererClient::ptr discoverer_client_; // 进行服务发现时启用服务发现客户端
             requestor_rpc_framework::Requestor::ptr requestor_;
             rpc_client::rpc_caller::RpcCaller::ptr rpc_caller_;
+            rpc_client::rpc_stream_client::StreamCaller::ptr stream_caller_; // 用于双向流调用
             dispatcher_rpc_framework::Dispatcher::ptr dispatcher_;
             base_client::BaseClient::ptr client_;
             std::mutex manage_map_mtx_;
-            std::unordered_map<public_data::host_addr_t, base_client::BaseClient::ptr, hostAddrHash> clients_; // 可以正常发起RPC请求的客户端
+            clients_t clients_;                                                     // 可以正常发起RPC请求的客户端
+            rcu_snapshot::RcuSnapshot<policies_t> policies_;                        // 方法名与调用策略映射
+            timer_queue::TimerQueue policy_sender_;                                 // 发送对冲和重试请求的线程，避免阻塞定时线程
+            timer_queue::TimerQueue policy_timer_;                                  // 对冲和重试定时器，在析构函数中最先停止，不会在客户端销毁后执行回调
         };
 
         class TopicClient
@@ -276,6 +855,8 @@ namespace rpc_client
                 // 此时就是进行RPC调用
                 client_ = client_factory::ClientFactory::clientCreateFactory(ip, port);
                 client_->setMessageCallback(std::bind(&dispatcher_rpc_framework::Dispatcher::executeService, dispatcher_.get(), std::placeholders::_1, std::placeholders::_2));
+                // 连接断开时结束所有未完成的请求
+                client_->setCloseCallback(std::bind(&rpc_client::requestor_rpc_framework::Requestor::handleConnectionShutdown, requestor_.get(), std::placeholders::_1));
 
                 // 连接服务端
                 client_->connect();
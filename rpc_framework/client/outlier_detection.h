@@ -0,0 +1,290 @@
+#ifndef __rpc_outlier_detection_h__
+#define __rpc_outlier_detection_h__
+
+#include <mutex>
+#include <deque>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include "jsoncpp/json/json.h"
+#include <rpc_framework/base/log.h>
+#include <rpc_framework/base/public_data.h>
+#include <rpc_framework/client/load_balance.h>
+
+namespace rpc_client
+{
+    namespace outlier
+    {
+        using namespace log_system;
+
+        // 异常检测策略
+        // 服务提供者连续出错、错误率过高或者耗时明显高于其他提供者时被临时隔离（熔断），隔离期间不再选择
+        // 隔离到期后放行一个试探请求（半开），成功则恢复，失败则继续隔离并延长隔离时间
+        struct OutlierPolicy
+        {
+            int consecutive_errors = 5;       // 连续错误达到该次数立即隔离
+            double error_rate = 0.5;          // 一个统计周期内错误率达到该比例时隔离
+            int64_t min_requests = 20;        // 统计周期内请求数达到该值才计算错误率
+            double latency_factor = 3;        // 耗时（EWMA）超过所有提供者中位数的倍数时隔离
+            int min_latency_ms = 10;          // 耗时低于该值时不按耗时隔离，避免正常的小抖动
+            int interval_ms = 1000;           // 统计周期，每个周期检查一次错误率和耗时
+            int base_ejection_ms = 1000;      // 第一次隔离的时间，之后每次隔离按次数成倍增加
+            int max_ejection_ms = 30000;      // 隔离时间上限
+            int max_ejection_percent = 50;    // 同时被隔离的提供者最多占的比例，至少保留一部分提供者
+        };
+
+        // 隔离和恢复事件
+        struct OutlierEvent
+        {
+            std::string method;
+            public_data::host_addr_t host;
+            std::string type;        // eject：隔离，restore：恢复
+            std::string reason;      // 隔离原因：consecutive_errors、error_rate、latency、probe_failed
+            int64_t duration_ms = 0; // 隔离时间
+            int64_t timestamp_ms = 0; // 发生时间（系统时间，毫秒）
+
+            Json::Value toJson() const
+            {
+                Json::Value val;
+                val["method"] = method;
+                val["host"] = host.first + ":" + std::to_string(host.second);
+                val["type"] = type;
+                if (!reason.empty())
+                    val["reason"] = reason;
+                if (duration_ms)
+                    val["duration_ms"] = static_cast<Json::Int64>(duration_ms);
+                val["timestamp_ms"] = static_cast<Json::Int64>(timestamp_ms);
+                return val;
+            }
+        };
+
+        // 一个方法的异常检测
+        // 请求结果通过onResult记录到每个提供者的HostStats中，连续错误和试探结果立即处理
+        // 错误率和耗时在统计周期到期后由当时记录结果的线程检查一次，不需要额外的线程
+        class OutlierDetector
+        {
+        public:
+            using ptr = std::shared_ptr<OutlierDetector>;
+            using event_callback_t = std::function<void(const OutlierEvent &)>;
+            using clock_t = std::chrono::steady_clock;
+
+            OutlierDetector(const std::string &method, const OutlierPolicy &policy, const event_callback_t &cb = event_callback_t())
+                : method_(method), policy_(policy), event_cb_(cb),
+                  next_sweep_(nowCount() + toCount(std::chrono::milliseconds(policy.interval_ms)))
+            {
+            }
+
+            // 主机列表变化时由HostManager更新，保留已有提供者的隔离次数
+            void setHosts(const load_balance::endpoints_t &endpoints)
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                std::vector<Host> hosts;
+                for (const auto &endpoint : endpoints)
+                {
+                    auto pos = findHost(endpoint.host);
+                    hosts.push_back(Host{endpoint.host, endpoint.stats, pos == hosts_.end() ? 0 : pos->ejections});
+                }
+                hosts_.swap(hosts);
+            }
+
+            // 记录一次请求结果，probe为发出请求时选择结果中的试探请求编号
+            // 试探期间只统计当前试探请求的结果，隔离前发出的请求和已经作废的试探请求返回时不影响恢复
+            void onResult(const public_data::host_addr_t &host, const load_balance::HostStats::ptr &stats, public_data::RCode rcode, int64_t probe = 0)
+            {
+                bool error = isHostError(rcode);
+                std::vector<OutlierEvent> events;
+                auto state = stats->state();
+                if (state == load_balance::HostState::Probing)
+                {
+                    // 试探请求的结果：成功恢复，失败继续隔离
+                    std::unique_lock<std::mutex> lock(mtx_);
+                    if (stats->state() == load_balance::HostState::Probing && probe != 0 && probe == stats->probeId())
+                    {
+                        if (error)
+                            eject(host, stats, "probe_failed", true, events);
+                        else
+                            restore(host, stats, events);
+                    }
+                }
+                else if (state == load_balance::HostState::Healthy)
+                {
+                    // 隔离期间返回的（隔离前发出的）请求不再统计
+                    int64_t consecutive = stats->onResult(error);
+                    if (error && consecutive >= policy_.consecutive_errors)
+                    {
+                        std::unique_lock<std::mutex> lock(mtx_);
+                        if (stats->state() == load_balance::HostState::Healthy)
+                            eject(host, stats, "consecutive_errors", false, events);
+                    }
+                }
+
+                int64_t now = nowCount();
+                int64_t next = next_sweep_.load(std::memory_order_relaxed);
+                if (now >= next && next_sweep_.compare_exchange_strong(next, now + toCount(std::chrono::milliseconds(policy_.interval_ms))))
+                {
+                    std::unique_lock<std::mutex> lock(mtx_);
+                    sweep(events);
+                }
+
+                notify(events);
+            }
+
+            // 获取统计信息：{ejections, restores, events: [最近的事件]}
+            Json::Value stats()
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                Json::Value result;
+                result["ejections"] = static_cast<Json::UInt64>(ejections_);
+                result["restores"] = static_cast<Json::UInt64>(restores_);
+                result["events"] = Json::Value(Json::arrayValue);
+                for (const auto &event : events_)
+                    result["events"].append(event.toJson());
+                return result;
+            }
+
+        private:
+            struct Host
+            {
+                public_data::host_addr_t host;
+                load_balance::HostStats::ptr stats;
+                int ejections = 0; // 连续被隔离的次数，正常的统计周期会逐渐减少
+            };
+
+            static const size_t max_events = 64; // 保留的最近事件个数
+
+            // 提供者自身的问题才计入错误，参数错误等调用方的问题不计入
+            static bool isHostError(public_data::RCode rcode)
+            {
+                return rcode == public_data::RCode::RCode_disconneted ||
+                       rcode == public_data::RCode::RCode_internal_error ||
+                       rcode == public_data::RCode::RCode_timeout ||
+                       rcode == public_data::RCode::RCode_overloaded;
+            }
+
+            static int64_t nowCount()
+            {
+                return clock_t::now().time_since_epoch().count();
+            }
+
+            template <class D>
+            static int64_t toCount(D duration)
+            {
+                return std::chrono::duration_cast<clock_t::duration>(duration).count();
+            }
+
+            // 以下函数调用者需要持有锁
+            std::vector<Host>::iterator findHost(const public_data::host_addr_t &host)
+            {
+                return std::find_if(hosts_.begin(), hosts_.end(), [&host](const Host &h)
+                                    { return h.host == host; });
+            }
+
+            // 隔离提供者，超过最大隔离比例时放弃（试探失败的提供者本来就处于隔离中，不受限制）
+            void eject(const public_data::host_addr_t &host, const load_balance::HostStats::ptr &stats, const std::string &reason,
+                       bool probe_failed, std::vector<OutlierEvent> &events)
+            {
+                auto pos = findHost(host);
+                if (pos == hosts_.end())
+                    return;
+
+                if (!probe_failed)
+                {
+                    size_t ejected = std::count_if(hosts_.begin(), hosts_.end(), [](const Host &h)
+                                                   { return h.stats->state() != load_balance::HostState::Healthy; });
+                    if ((ejected + 1) * 100 > hosts_.size() * static_cast<size_t>(policy_.max_ejection_percent))
+                        return;
+                }
+
+                pos->ejections++;
+                int64_t duration_ms = std::min<int64_t>(static_cast<int64_t>(policy_.base_ejection_ms) * pos->ejections, policy_.max_ejection_ms);
+                stats->eject(std::chrono::milliseconds(duration_ms));
+                ejections_++;
+                LOG(Level::Warning, "方法：{}的服务提供者{}:{}被隔离{}ms，原因：{}", method_, host.first, host.second, duration_ms, reason);
+                record(OutlierEvent{method_, host, "eject", reason, duration_ms, systemMs()}, events);
+            }
+
+            void restore(const public_data::host_addr_t &host, const load_balance::HostStats::ptr &stats, std::vector<OutlierEvent> &events)
+            {
+                stats->restore();
+                restores_++;
+                LOG(Level::Info, "方法：{}的服务提供者{}:{}试探成功，恢复正常", method_, host.first, host.second);
+                record(OutlierEvent{method_, host, "restore", "", 0, systemMs()}, events);
+            }
+
+            // 统计周期到期：检查错误率和耗时，正常的提供者减少一次隔离次数
+            void sweep(std::vector<OutlierEvent> &events)
+            {
+                std::vector<int64_t> latencies;
+                for (const auto &h : hosts_)
+                {
+                    if (h.stats->state() == load_balance::HostState::Healthy && h.stats->ewmaUs() > 0)
+                        latencies.push_back(h.stats->ewmaUs());
+                }
+
+                int64_t median = 0;
+                if (latencies.size() >= 2)
+                {
+                    std::nth_element(latencies.begin(), latencies.begin() + (latencies.size() - 1) / 2, latencies.end());
+                    median = latencies[(latencies.size() - 1) / 2];
+                }
+
+                for (auto &h : hosts_)
+                {
+                    int64_t requests = 0, errors = 0;
+                    h.stats->takeInterval(requests, errors);
+                    if (h.stats->state() != load_balance::HostState::Healthy)
+                        continue;
+
+                    int64_t ewma = h.stats->ewmaUs();
+                    if (requests >= policy_.min_requests && errors >= policy_.error_rate * requests)
+                        eject(h.host, h.stats, "error_rate", false, events);
+                    else if (median > 0 && ewma >= policy_.min_latency_ms * 1000LL && ewma > policy_.latency_factor * median)
+                        eject(h.host, h.stats, "latency", false, events);
+                    else if (requests > 0 && h.ejections > 0)
+                        h.ejections--;
+                }
+            }
+
+            void record(OutlierEvent event, std::vector<OutlierEvent> &events)
+            {
+                if (events_.size() >= max_events)
+                    events_.pop_front();
+                events_.push_back(event);
+                events.push_back(std::move(event));
+            }
+
+            // 在锁外调用事件回调
+            void notify(const std::vector<OutlierEvent> &events)
+            {
+                if (!event_cb_)
+                    return;
+                for (const auto &event : events)
+                    event_cb_(event);
+            }
+
+            static int64_t systemMs()
+            {
+                return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+            }
+
+        private:
+            const std::string method_;
+            const OutlierPolicy policy_;
+            const event_callback_t event_cb_;
+            std::atomic<int64_t> next_sweep_; // 下一次检查的时间，steady_clock计数
+
+            std::mutex mtx_;                  // 保护以下成员，只在隔离、恢复和周期检查时使用
+            std::vector<Host> hosts_;         // 方法的所有提供者
+            std::deque<OutlierEvent> events_; // 最近的事件
+            uint64_t ejections_ = 0;          // 隔离次数
+            uint64_t restores_ = 0;           // 恢复次数
+        };
+    }
+}
+
+#endif
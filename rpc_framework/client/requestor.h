@@ -1,12 +1,25 @@
 #ifndef __rpc_requestor_h__
 #define __rpc_requestor_h__
 
+#include <array>
+#include <mutex>
+#include <atomic>
+#include <chrono>
 #include <future>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
 #include <functional>
+#include <unordered_map>
+#include <condition_variable>
 #include <rpc_framework/base/public_data.h>
 #include <rpc_framework/base/base_message.h>
 #include <rpc_framework/base/base_connection.h>
+#include <rpc_framework/base/json_message.h>
+#include <rpc_framework/base/stream_message.h>
 #include <rpc_framework/base/log.h>
+#include <rpc_framework/factories/message_factory.h>
 
 namespace rpc_client
 {
@@ -14,6 +27,11 @@ namespace rpc_client
 
     namespace requestor_rpc_framework
     {
+        // 请求发送与响应分发
+        // 未完成的请求按请求ID分散到多个分片中，每个分片使用独立的互斥锁，不同线程的请求很少竞争同一把锁
+        // 请求ID使用递增的数字，低位直接决定分片；其他模块生成的非数字ID（例如UUID）按哈希值分片
+        // 超时定时器同样按分片保存在各自的时间轮中，添加、完成请求（包括添加和取消定时器）都只需要锁一次对应的分片
+        // 一个定时线程每个刻度依次检查各分片时间轮中到期的请求，不存在所有请求共用的锁
         class Requestor
         {
         public:
@@ -22,36 +40,132 @@ namespace rpc_client
             using async_response = std::future<base_message::BaseMessage::ptr>;
             // 回调类型
             using callback_t = std::function<void(base_message::BaseMessage::ptr &)>;
+            // 流式回调类型，返回true表示流已经结束
+            using stream_callback_t = std::function<bool(base_message::BaseMessage::ptr &)>;
 
+            // 请求描述，保存一个未完成请求的状态
+            // 收到响应、超时或者连接断开时通过complete把响应交给调用者，不同的发送模式由子类实现
+            // 上层模块可以继承RequestDesc，把自己的调用状态和结果处理放在同一个对象中，每次请求只分配一次
             struct RequestDesc
             {
                 using ptr = std::shared_ptr<RequestDesc>;
 
-                base_message::BaseMessage::ptr request;                // 请求描述
-                public_data::RType send_type;                          // 消息发送模式
-                std::promise<base_message::BaseMessage::ptr> response; // 存储异步请求响应结果
-                callback_t callback;                                   // 回调处理函数
+                virtual ~RequestDesc() {}
+
+                // 交给调用者一个响应
+                // 非流式请求只调用一次；流式请求每收到一个响应调用一次，返回true表示流已经结束
+                virtual bool complete(base_message::BaseMessage::ptr &msg) = 0;
+
+                base_message::BaseMessage::ptr request;                              // 请求描述
+                public_data::RType send_type = public_data::RType::Req_callback;     // 消息发送模式
+                base_connection::BaseConnection::ptr con;                            // 发送请求的连接，连接断开时结束请求
+
+                // 以下由Requestor在添加请求时设置
+                size_t shard = 0;        // 所在分片，添加时根据请求ID计算一次
+                int64_t timer_tick = -1; // 超时的时间轮刻度，小于0表示没有超时时间
+                size_t timer_pos = 0;    // 在时间轮格子中的位置，用于取消时直接删除
             };
 
+            Requestor()
+                : start_(tick_clock_t::now())
+            {
+            }
+
+            // 未完成的请求直接丢弃
+            ~Requestor()
+            {
+                {
+                    std::unique_lock<std::mutex> lock(tick_mtx_);
+                    stop_ = true;
+                }
+                tick_cond_.notify_all();
+                if (ticker_.joinable())
+                {
+                    // 超时回调中释放了最后一个引用时，析构发生在定时线程中，不能等待自己
+                    if (ticker_.get_id() == std::this_thread::get_id())
+                        ticker_.detach();
+                    else
+                        ticker_.join();
+                }
+            }
+
+            Requestor(const Requestor &) = delete;
+            Requestor &operator=(const Requestor &) = delete;
+
+            // 设置默认超时时间（毫秒），小于0表示不限制
+            // 请求没有携带超时时间时使用默认超时时间，并写入请求交给服务端
+            // 流式请求不使用默认超时时间，只在请求携带了超时时间时限制整个流的时间
+            void setDefaultTimeout(int timeout_ms)
+            {
+                default_timeout_ms_ = timeout_ms;
+            }
+
+            // 生成新的请求ID，同一个Requestor中不会重复
+            std::string nextRequestId()
+            {
+                return std::to_string(next_id_.fetch_add(1, std::memory_order_relaxed) + 1);
+            }
+
             // 收到服务端响应时的回调函数
             void handleResponse(const base_connection::BaseConnection::ptr &con, base_message::BaseMessage::ptr &msg)
             {
-                // 1. 查找到指定的描述字段
-                RequestDesc::ptr rd = findRequestDesc(msg->getReqRespId());
+                // 1. 查找到指定的描述字段，非流式请求同时删除描述
+                // 请求已经超时或者连接已经断开时，描述字段已经被删除，忽略迟到的响应
+                std::string rid = msg->getReqRespId();
+                RequestDesc::ptr rd = acquireRequestDesc(rid);
                 if(!rd.get())
                 {
-                    LOG(Level::Warning, "不存在请求ID：{}对应的描述字段", msg->getReqRespId());
+                    LOG(Level::Warning, "不存在请求ID：{}对应的描述字段", rid);
                     return;
                 }
 
-                // 2. 根据异步或者回调获取结果
-                if(rd->send_type == public_data::RType::Req_async)
-                    rd->response.set_value(msg);
-                else if(rd->send_type == public_data::RType::Req_callback)
-                    (rd->callback)(msg);
+                // 2. 流式请求在流结束前保留请求描述等待后续响应
+                if(rd->send_type == public_data::RType::Req_stream)
+                {
+                    if(rd->complete(msg))
+                        takeRequestDesc(rd->shard, rid);
+                    return;
+                }
+
+                // 3. 其他请求的描述和定时器已经删除，与超时和连接断开竞争时只有一方能取到描述
+                rd->complete(msg);
+            }
 
-                // 3. 处理完当前响应后说明对应的请求结束，删除对应的rid
-                removeRequestDesc(msg->getReqRespId());
+            // 连接断开时的回调函数，连接上所有未完成的请求以连接断开结束
+            void handleConnectionShutdown(const base_connection::BaseConnection::ptr &con)
+            {
+                std::vector<RequestDesc::ptr> pending;
+                for (auto &shard : shards_)
+                {
+                    std::unique_lock<std::mutex> lock(shard.mtx);
+                    for (auto it = shard.requests.begin(); it != shard.requests.end();)
+                    {
+                        if (it->second->con == con)
+                        {
+                            pending.push_back(it->second);
+                            it = eraseLocked(shard, it);
+                        }
+                        else
+                            ++it;
+                    }
+                }
+
+                if (!pending.empty())
+                    LOG(Level::Warning, "连接断开，结束{}个未完成的请求", pending.size());
+                for (auto &rd : pending)
+                    fail(rd, public_data::RCode::RCode_disconneted);
+            }
+
+            // 获取未完成的请求个数
+            size_t pendingCount()
+            {
+                size_t count = 0;
+                for (auto &shard : shards_)
+                {
+                    std::unique_lock<std::mutex> lock(shard.mtx);
+                    count += shard.requests.size();
+                }
+                return count;
             }
 
             // 同步发送接口
@@ -66,7 +180,7 @@ namespace rpc_client
                     return false;
                 }
 
-                // 不存在结果时会阻塞
+                // 不存在结果时会阻塞，超时或者连接断开时得到对应状态码的响应
                 resp = resp_async.get();
 
                 return true;
@@ -76,79 +190,365 @@ namespace rpc_client
             bool sendRequest(const base_connection::BaseConnection::ptr &con, const base_message::BaseMessage::ptr &msg, async_response &resp)
             {
                 // 创建出请求描述
-                RequestDesc::ptr rd = insertRequestDesc(msg, msg->getReqRespId(), public_data::RType::Req_async);
-                if(!rd.get())
-                {
-                    LOG(Level::Error, "异步发送创建请求描述失败");
-                    return false;
-                }
-
-                // 发送请求
-                con->send(msg);
-
-                // 获取future对象
+                auto rd = std::make_shared<AsyncDesc>();
+                rd->request = msg;
+                rd->send_type = public_data::RType::Req_async;
+                // 先获取future对象，超时可能在发送后立即发生
                 resp = rd->response.get_future();
 
-                return true;
+                return sendRequest(con, rd);
             }
 
             // 回调发送接口
             bool sendRequest(const base_connection::BaseConnection::ptr &con, const base_message::BaseMessage::ptr &msg, callback_t &cb)
             {
                 // 创建出请求描述
-                RequestDesc::ptr rd = insertRequestDesc(msg, msg->getReqRespId(), public_data::RType::Req_callback, cb);
-                if (!rd.get())
+                auto rd = std::make_shared<CallbackDesc>();
+                rd->request = msg;
+                rd->callback = cb;
+
+                return sendRequest(con, rd);
+            }
+
+            // 流式发送接口
+            // 同一个请求ID的响应会依次交给回调，直到回调返回true
+            bool sendStreamRequest(const base_connection::BaseConnection::ptr &con, const base_message::BaseMessage::ptr &msg, const stream_callback_t &cb)
+            {
+                auto rd = std::make_shared<StreamDesc>();
+                rd->request = msg;
+                rd->send_type = public_data::RType::Req_stream;
+                rd->stream_callback = cb;
+
+                return sendRequest(con, rd);
+            }
+
+            // 发送上层构造的请求描述，rd->request为要发送的请求，响应通过rd->complete交给上层
+            bool sendRequest(const base_connection::BaseConnection::ptr &con, const RequestDesc::ptr &rd)
+            {
+                if (!rd->request)
                 {
-                    LOG(Level::Error, "回调发送创建请求描述失败");
+                    LOG(Level::Error, "请求描述中不存在请求");
                     return false;
                 }
 
-                // 发送请求
-                con->send(msg);
-                
+                insertRequestDesc(con, rd);
+                // 连接可能在插入之前已经断开，断开时的清理不会再结束这个请求，插入之后再检查一次
+                // 断开时的清理和这里只有取出描述的一方结束请求
+                if (!con->connected())
+                {
+                    RequestDesc::ptr taken = takeRequestDesc(rd->shard, rd->request->getReqRespId());
+                    if (taken)
+                    {
+                        LOG(Level::Warning, "连接已断开，请求ID：{}未发送", rd->request->getReqRespId());
+                        fail(taken, public_data::RCode::RCode_disconneted);
+                    }
+                    return true;
+                }
+                con->send(rd->request);
+
                 return true;
             }
         private:
+            using tick_clock_t = std::chrono::steady_clock;
+            using requests_t = std::unordered_map<std::string, RequestDesc::ptr>;
+
+            // 时间轮的刻度和格子个数，一圈为tick_ms * wheel_size毫秒，更长的超时时间在格子中等待多圈
+            static constexpr int64_t tick_ms = 10;
+            static constexpr size_t wheel_size = 64;
+
+            // 分片个数，必须是2的幂
+            static const size_t shard_count = 64;
+
+            // 单个分片，按缓存行对齐，避免不同分片的互斥锁互相干扰
+            struct alignas(64) Shard
+            {
+                std::mutex mtx;                                // 管理当前分片的互斥锁
+                requests_t requests;                           // 请求ID与描述映射
+                std::vector<std::vector<RequestDesc *>> wheel; // 时间轮，每个格子保存到期刻度落在该格子的请求，第一次添加定时器时创建
+            };
+
+            // 异步请求：结果交给promise
+            struct AsyncDesc : public RequestDesc
+            {
+                std::promise<base_message::BaseMessage::ptr> response; // 存储异步请求响应结果
+
+                bool complete(base_message::BaseMessage::ptr &msg) override
+                {
+                    response.set_value(msg);
+                    return true;
+                }
+            };
+
+            // 回调请求：结果交给回调函数
+            struct CallbackDesc : public RequestDesc
+            {
+                callback_t callback; // 回调处理函数
+
+                bool complete(base_message::BaseMessage::ptr &msg) override
+                {
+                    callback(msg);
+                    return true;
+                }
+            };
+
+            // 流式请求：每个响应交给流式回调
+            struct StreamDesc : public RequestDesc
+            {
+                stream_callback_t stream_callback; // 流式回调处理函数
+
+                bool complete(base_message::BaseMessage::ptr &msg) override
+                {
+                    return stream_callback(msg);
+                }
+            };
+
             // 添加请求描述
-            RequestDesc::ptr insertRequestDesc(const base_message::BaseMessage::ptr &req, std::string rid, public_data::RType rtype, const callback_t &cb = nullptr)
-            {
-                std::unique_lock<std::mutex> lock(manage_map_mtx_);
-                // 构建RequestDesc对象
-                RequestDesc::ptr rd = std::make_shared<RequestDesc>();
-                rd->request = req;
-                rd->send_type = rtype;
-                if(rtype == public_data::RType::Req_callback && cb)
-                    rd->callback = cb;
-                
-                request_map_.insert({rid, rd});
+            // 请求存在超时时间时同时放入分片的时间轮
+            void insertRequestDesc(const base_connection::BaseConnection::ptr &con, const RequestDesc::ptr &rd)
+            {
+                rd->con = con;
+                std::string rid = rd->request->getReqRespId();
+                int timeout_ms = requestTimeout(rd->request, rd->send_type);
+                rd->shard = shardIndex(rid);
+                rd->timer_tick = -1;
+                if (timeout_ms >= 0)
+                    startTicker();
 
-                return rd;
-            }   
+                Shard &shard = shards_[rd->shard];
+                std::unique_lock<std::mutex> lock(shard.mtx);
+                auto ret = shard.requests.insert({std::move(rid), rd});
+                if (ret.second && timeout_ms >= 0)
+                    addTimerLocked(shard, rd.get(), timeout_ms);
+            }
 
-            // 删除请求描述
-            void removeRequestDesc(std::string rid)
+            // 获取请求的超时时间，小于0表示不限制
+            // 打开双向流的请求不是JsonRequest，超时时间保存在打开帧中，只限制等待接受帧的时间
+            int requestTimeout(const base_message::BaseMessage::ptr &req, public_data::RType rtype)
             {
-                std::unique_lock<std::mutex> lock(manage_map_mtx_);
-                request_map_.erase(rid);
+                auto json_req = std::dynamic_pointer_cast<json_message::JsonRequest>(req);
+                if(!json_req)
+                {
+                    auto open_req = std::dynamic_pointer_cast<stream_message::StreamMessage>(req);
+                    if(!open_req || open_req->getStreamOptype() != public_data::StreamOptype::Stream_open)
+                        return -1;
+
+                    int timeout_ms = open_req->getTimeout();
+                    return timeout_ms < 0 ? default_timeout_ms_ : timeout_ms;
+                }
+
+                int timeout_ms = json_req->getTimeout();
+                if(timeout_ms < 0 && default_timeout_ms_ >= 0 && rtype != public_data::RType::Req_stream)
+                {
+                    timeout_ms = default_timeout_ms_;
+                    json_req->setTimeout(timeout_ms);
+                }
+
+                return timeout_ms;
             }
 
-            // 查找请求描述
-            RequestDesc::ptr findRequestDesc(std::string rid)
+            // 取出并删除请求描述，同时取消超时定时器，不存在时返回nullptr
+            RequestDesc::ptr takeRequestDesc(const std::string &rid)
             {
-                std::unique_lock<std::mutex> lock(manage_map_mtx_);
-                auto pos = request_map_.find(rid);
-                if(pos == request_map_.end())
+                return takeRequestDesc(shardIndex(rid), rid);
+            }
+
+            RequestDesc::ptr takeRequestDesc(size_t index, const std::string &rid)
+            {
+                Shard &shard = shards_[index];
+                std::unique_lock<std::mutex> lock(shard.mtx);
+                auto pos = shard.requests.find(rid);
+                if(pos == shard.requests.end())
+                    return nullptr;
+
+                RequestDesc::ptr rd = pos->second;
+                eraseLocked(shard, pos);
+                return rd;
+            }
+
+            // 以指定的状态码结束请求
+            // 构造与请求类型对应的响应交给调用者，调用者按照普通的错误响应处理
+            void fail(const RequestDesc::ptr &rd, public_data::RCode rcode)
+            {
+                public_data::MType mtype = public_data::MType::Resp_rpc;
+                switch (rd->request->getMtype())
                 {
-                    LOG(Level::Warning, "不存在请求ID为：{}对应的请求描述", rid);
+                case public_data::MType::Req_topic:
+                    mtype = public_data::MType::Resp_topic;
+                    break;
+                case public_data::MType::Req_service:
+                    mtype = public_data::MType::Resp_service;
+                    break;
+                case public_data::MType::Req_batch_rpc:
+                    mtype = public_data::MType::Resp_batch_rpc;
+                    break;
+                default:
+                    break;
+                }
+
+                base_message::BaseMessage::ptr msg = message_factory::MessageFactory::messageCreateFactory(mtype);
+                msg->setId(rd->request->getReqRespId());
+                msg->setMType(mtype);
+                std::dynamic_pointer_cast<json_message::JsonResponse>(msg)->setRCode(rcode);
+
+                rd->complete(msg);
+            }
+
+            // 查找请求描述，非流式请求在同一次加锁中删除描述，流式请求保留描述等待后续响应
+            RequestDesc::ptr acquireRequestDesc(const std::string &rid)
+            {
+                Shard &shard = shards_[shardIndex(rid)];
+                std::unique_lock<std::mutex> lock(shard.mtx);
+                auto pos = shard.requests.find(rid);
+                if(pos == shard.requests.end())
                     return nullptr;
+
+                RequestDesc::ptr rd = pos->second;
+                if(rd->send_type != public_data::RType::Req_stream)
+                    eraseLocked(shard, pos);
+                return rd;
+            }
+
+            // 删除请求描述，同时从时间轮中删除，调用者需要持有分片的锁
+            requests_t::iterator eraseLocked(Shard &shard, requests_t::iterator pos)
+            {
+                RequestDesc *rd = pos->second.get();
+                if (rd->timer_tick >= 0)
+                {
+                    // 与格子中最后一个定时器交换后删除，不需要移动其他定时器
+                    std::vector<RequestDesc *> &slot = shard.wheel[static_cast<size_t>(rd->timer_tick) % wheel_size];
+                    slot[rd->timer_pos] = slot.back();
+                    slot[rd->timer_pos]->timer_pos = rd->timer_pos;
+                    slot.pop_back();
+                    rd->timer_tick = -1;
                 }
 
-                return pos->second;
+                return shard.requests.erase(pos);
+            }
+
+            // 把请求放入时间轮，调用者需要持有分片的锁
+            // 定时线程在处理某个刻度前先记录该刻度，持有分片的锁读取后，新定时器不会放入正在处理或者已经处理过的刻度
+            void addTimerLocked(Shard &shard, RequestDesc *rd, int timeout_ms)
+            {
+                int64_t expire_ms = std::chrono::duration_cast<std::chrono::milliseconds>(tick_clock_t::now() - start_).count() + timeout_ms;
+                int64_t tick = std::max((expire_ms + tick_ms - 1) / tick_ms, processed_tick_.load(std::memory_order_seq_cst) + 1);
+                if (shard.wheel.empty())
+                    shard.wheel.resize(wheel_size);
+
+                std::vector<RequestDesc *> &slot = shard.wheel[static_cast<size_t>(tick) % wheel_size];
+                rd->timer_tick = tick;
+                rd->timer_pos = slot.size();
+                slot.push_back(rd);
+            }
+
+            int64_t nowTick()
+            {
+                return std::chrono::duration_cast<std::chrono::milliseconds>(tick_clock_t::now() - start_).count() / tick_ms;
+            }
+
+            // 第一次添加带超时时间的请求时创建定时线程
+            void startTicker()
+            {
+                if (ticker_started_.load(std::memory_order_acquire))
+                    return;
+
+                std::unique_lock<std::mutex> lock(tick_mtx_);
+                if (ticker_started_.load(std::memory_order_relaxed) || stop_)
+                    return;
+                ticker_ = std::thread(&Requestor::runTicker, this);
+                ticker_started_.store(true, std::memory_order_release);
+            }
+
+            // 定时线程：每个刻度检查所有分片中对应格子里到期的请求，以超时结束
+            // 落后超过一圈时（例如长时间阻塞）一次检查所有格子
+            void runTicker()
+            {
+                std::vector<RequestDesc::ptr> expired;
+                int64_t next = nowTick();
+                while (true)
+                {
+                    {
+                        std::unique_lock<std::mutex> lock(tick_mtx_);
+                        tick_cond_.wait_until(lock, start_ + std::chrono::milliseconds(next * tick_ms), [this]()
+                                              { return stop_; });
+                        if (stop_)
+                            return;
+                    }
+
+                    int64_t now = nowTick();
+                    if (now < next)
+                        continue;
+
+                    processed_tick_.store(now, std::memory_order_seq_cst);
+                    int64_t first = std::max(next, now - static_cast<int64_t>(wheel_size) + 1);
+                    for (auto &shard : shards_)
+                    {
+                        std::unique_lock<std::mutex> lock(shard.mtx);
+                        if (shard.wheel.empty())
+                            continue;
+
+                        for (int64_t tick = first; tick <= now; tick++)
+                        {
+                            std::vector<RequestDesc *> &slot = shard.wheel[static_cast<size_t>(tick) % wheel_size];
+                            for (size_t i = 0; i < slot.size();)
+                            {
+                                // 还需要等待更多圈的定时器留在格子中
+                                if (slot[i]->timer_tick > now)
+                                {
+                                    i++;
+                                    continue;
+                                }
+
+                                auto pos = shard.requests.find(slot[i]->request->getReqRespId());
+                                expired.push_back(pos->second);
+                                eraseLocked(shard, pos);
+                            }
+                        }
+                    }
+                    next = now + 1;
+
+                    for (auto &rd : expired)
+                    {
+                        LOG(Level::Warning, "请求ID：{}超时", rd->request->getReqRespId());
+                        fail(rd, public_data::RCode::RCode_timeout);
+                    }
+                    expired.clear();
+                }
             }
 
         private:
-            std::unordered_map<std::string, RequestDesc::ptr> request_map_; // 请求ID与描述映射
-            std::mutex manage_map_mtx_;                                         // 用于管理哈希表的互斥锁
+            // 获取请求ID所在的分片
+            // 数字ID使用低位，连续的请求依次分布到不同分片；其他ID使用哈希值
+            // 只在添加请求和收到响应时计算，之后使用请求描述中记录的分片
+            size_t shardIndex(const std::string &rid)
+            {
+                uint64_t id = 0;
+                bool numeric = !rid.empty();
+                for (char c : rid)
+                {
+                    if (c < '0' || c > '9')
+                    {
+                        numeric = false;
+                        break;
+                    }
+                    id = id * 10 + static_cast<uint64_t>(c - '0');
+                }
+
+                size_t index = numeric ? static_cast<size_t>(id) : std::hash<std::string>{}(rid);
+                return index & (shard_count - 1);
+            }
+
+        private:
+            std::array<Shard, shard_count> shards_; // 未完成的请求
+            std::atomic<uint64_t> next_id_{0};      // 最近一次生成的请求ID
+            int default_timeout_ms_ = -1;           // 默认超时时间（毫秒），小于0表示不限制
+
+            tick_clock_t::time_point start_;                 // 时间轮刻度的起点
+            std::atomic<int64_t> processed_tick_{-1};   // 定时线程正在处理或者已经处理的最大刻度
+            std::mutex tick_mtx_;                       // 保护定时线程的创建和停止
+            std::condition_variable tick_cond_;
+            std::atomic<bool> ticker_started_{false};
+            bool stop_ = false;
+            std::thread ticker_;                        // 定时线程，析构函数中最先停止，不会在请求表销毁后执行回调
         };
     }
 }
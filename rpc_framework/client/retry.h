@@ -0,0 +1,119 @@
+#ifndef __rpc_retry_h__
+#define __rpc_retry_h__
+
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include "jsoncpp/json/json.h"
+#include <rpc_framework/base/public_data.h>
+#include <rpc_framework/utils/token_budget.h>
+
+namespace rpc_client
+{
+    namespace retry
+    {
+        // 重试策略
+        // 调用返回可重试的状态码时等待一段退避时间后重试，优先选择还没有尝试过的服务提供者
+        // 只能用于幂等的方法，重试可能让服务端执行多次
+        struct RetryPolicy
+        {
+            int max_attempts = 3;          // 最多尝试次数（包括第一次）
+            std::vector<public_data::RCode> retryable_codes = {public_data::RCode::RCode_disconneted,
+                                                               public_data::RCode::RCode_internal_error,
+                                                               public_data::RCode::RCode_timeout}; // 可以重试的状态码
+            int initial_backoff_ms = 10;   // 第一次重试前的退避时间
+            int max_backoff_ms = 1000;     // 退避时间的上限
+            double backoff_multiplier = 2; // 每次重试退避时间的增长倍数
+            double budget_ratio = 0.1;     // 重试最多占普通调用的比例，防止服务端故障时重试放大流量
+        };
+
+        // 单个方法的重试状态：策略、重试预算和统计信息
+        class Retrier
+        {
+        public:
+            using ptr = std::shared_ptr<Retrier>;
+
+            Retrier(const RetryPolicy &policy)
+                : policy_(policy), budget_(policy.budget_ratio, max_tokens)
+            {
+            }
+
+            // 一次普通调用，增加重试预算
+            void onCall()
+            {
+                budget_.deposit();
+                std::unique_lock<std::mutex> lock(mtx_);
+                calls_++;
+            }
+
+            // 第attempts次尝试返回rcode后是否重试，允许时消耗一次重试预算
+            bool shouldRetry(int attempts, public_data::RCode rcode)
+            {
+                if (std::find(policy_.retryable_codes.begin(), policy_.retryable_codes.end(), rcode) == policy_.retryable_codes.end())
+                    return false;
+
+                std::unique_lock<std::mutex> lock(mtx_);
+                if (attempts >= policy_.max_attempts)
+                {
+                    exhausted_++;
+                    return false;
+                }
+
+                if (!budget_.tryAcquire())
+                {
+                    throttled_++;
+                    return false;
+                }
+
+                retries_++;
+                return true;
+            }
+
+            // 第retry次重试前的退避时间
+            // 指数增长并加入随机抖动（在[一半, 全部]之间），避免多个客户端同时重试
+            std::chrono::milliseconds backoff(int retry)
+            {
+                double base = policy_.initial_backoff_ms;
+                for (int i = 1; i < retry && base < policy_.max_backoff_ms; i++)
+                    base *= policy_.backoff_multiplier;
+                base = std::min(base, static_cast<double>(policy_.max_backoff_ms));
+
+                thread_local std::mt19937 rng(std::random_device{}());
+                std::uniform_real_distribution<double> jitter(0.5, 1.0);
+                return std::chrono::milliseconds(static_cast<int64_t>(base * jitter(rng)));
+            }
+
+            // 获取统计信息：{calls, retries, throttled, exhausted}
+            // throttled为因为预算不足放弃的重试，exhausted为达到最多尝试次数仍然失败的调用
+            Json::Value stats()
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                Json::Value result;
+                result["calls"] = static_cast<Json::UInt64>(calls_);
+                result["retries"] = static_cast<Json::UInt64>(retries_);
+                result["throttled"] = static_cast<Json::UInt64>(throttled_);
+                result["exhausted"] = static_cast<Json::UInt64>(exhausted_);
+                return result;
+            }
+
+        private:
+            static constexpr double max_tokens = 10; // 重试预算允许的突发个数
+
+        private:
+            RetryPolicy policy_;
+            token_budget::TokenBudget budget_;
+
+            std::mutex mtx_;
+            uint64_t calls_ = 0;     // 调用次数
+            uint64_t retries_ = 0;   // 重试次数
+            uint64_t throttled_ = 0; // 因为预算不足放弃的重试次数
+            uint64_t exhausted_ = 0; // 达到最多尝试次数的调用次数
+        };
+    }
+}
+
+#endif
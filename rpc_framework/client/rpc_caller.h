@@ -1,23 +1,107 @@
 #ifndef __rpc_rpc_caller_h__
 #define __rpc_rpc_caller_h__
 
+#include <chrono>
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
 #include <rpc_framework/base/base_connection.h>
+#include <rpc_framework/base/call_context.h>
 #include <rpc_framework/factories/message_factory.h>
 #include <rpc_framework/client/requestor.h>
-#include <rpc_framework/utils/uuid_generator.h>
+#include <rpc_framework/utils/coroutine_task.h>
 #include "jsoncpp/json/value.h"
 
 namespace rpc_client
 {
     namespace rpc_caller
     {
+        // 调用失败时通过future抛出的异常，携带返回状态码
+        class RpcError : public std::runtime_error
+        {
+        public:
+            RpcError(public_data::RCode code)
+                : std::runtime_error(public_data::errReason(code)), code_(code)
+            {
+            }
+
+            public_data::RCode code() const
+            {
+                return code_;
+            }
+
+        private:
+            public_data::RCode code_;
+        };
+
+        // 调用的观察者，上层用于记录每一次调用的负载、耗时和结果，例如负载均衡和异常检测
+        // 发送前调用onStart，调用结束（包括超时、连接断开和发送失败）时调用一次onFinish
+        class CallObserver
+        {
+        public:
+            using ptr = std::shared_ptr<CallObserver>;
+
+            virtual ~CallObserver() {}
+            virtual void onStart() = 0;
+            virtual void onFinish(public_data::RCode rcode, std::chrono::steady_clock::duration latency) = 0;
+        };
+
+        // 批量调用
+        // 先收集多次调用，再通过RpcCaller一次性发送，每一次调用通过自己的future获取结果
+        // 一次最多发送public_data::max_batch_calls个调用
+        class RpcBatch
+        {
+        public:
+            using ptr = std::shared_ptr<RpcBatch>;
+
+            // 添加一次调用，返回该次调用结果对应的future
+            std::future<Json::Value> addCall(const std::string &method_name, const Json::Value &params)
+            {
+                calls_.emplace_back();
+                calls_.back().method = method_name;
+                calls_.back().params = params;
+
+                return calls_.back().result.get_future();
+            }
+
+            // 获取调用个数
+            size_t size() const
+            {
+                return calls_.size();
+            }
+
+            // 获取第一次调用的方法名，用于选择服务提供者
+            std::string firstMethod() const
+            {
+                return calls_.empty() ? std::string() : calls_.front().method;
+            }
+
+        private:
+            friend class RpcCaller;
+
+            struct CallEntry
+            {
+                std::string method;                 // 方法名
+                Json::Value params;                 // 方法参数
+                std::promise<Json::Value> result;   // 该次调用的结果
+            };
+
+            std::vector<CallEntry> calls_;
+        };
+
         class RpcCaller
         {
         public:
             using ptr = std::shared_ptr<RpcCaller>;
             using aysnc_response = std::future<Json::Value>;
             using callback_t = std::function<void(const Json::Value &)>;
+            // 带返回状态码的回调，调用失败时同样调用一次，结果为空
+            using done_callback_t = std::function<void(public_data::RCode, const Json::Value &)>;
+            // 流式调用中每收到一个元素调用一次
+            using stream_item_callback_t = std::function<void(const Json::Value &)>;
+            // 流式调用结束时调用一次，正常结束时状态码为RCode_fine
+            using stream_done_callback_t = std::function<void(public_data::RCode)>;
 
             RpcCaller(const requestor_rpc_framework::Requestor::ptr &requestor)
                 : requestor_(requestor)
@@ -25,126 +109,629 @@ namespace rpc_client
             }
 
             // 同步调用函数
-            bool call(const base_connection::BaseConnection::ptr &con, const std::string &method_name, const Json::Value &params, Json::Value &result)
+            // 以下普通调用的observer不为空时记录这一次调用，只有一次分配的调用状态中同时保存观察者
+            bool call(const base_connection::BaseConnection::ptr &con, const std::string &method_name, const Json::Value &params, Json::Value &result,
+                      const CallObserver::ptr &observer = nullptr)
+            {
+                // 通过异步调用发送，等待future中的结果
+                aysnc_response resp;
+                if (!call(con, method_name, params, resp, observer))
+                {
+                    LOG(Level::Warning, "同步处理请求失败");
+                    return false;
+                }
+
+                // 不存在结果时会阻塞，超时或者连接断开时得到对应状态码的异常
+                try
+                {
+                    result = resp.get();
+                }
+                catch (const RpcError &e)
+                {
+                    return false;
+                }
+
+                return true;
+            }
+
+            // 异步调用函数
+            bool call(const base_connection::BaseConnection::ptr &con, const std::string &method_name, const Json::Value &params, aysnc_response &result,
+                      const CallObserver::ptr &observer = nullptr)
             {
                 // 1. 创建请求
                 auto rpc_req = message_factory::MessageFactory::messageCreateFactory<request_message::RpcRequest>();
-                rpc_req->setId(uuid_generator::UuidGenerator::generate_uuid());
+                rpc_req->setId(requestor_->nextRequestId());
                 rpc_req->setMType(public_data::MType::Req_rpc);
-                rpc_req->setMethod(method_name);
+                bool by_id = setRequestMethod(con, rpc_req, method_name);
                 rpc_req->setParams(params);
 
                 // 2. 发送请求
-                base_message::BaseMessage::ptr base_msg;
-                // 重载函数必须保证类型完全一致，而父类和子类之间的关系也属于类型不一致
-                bool ret = requestor_->sendRequest(con, std::dynamic_pointer_cast<base_message::BaseMessage>(rpc_req), base_msg);
+                // 请求、promise和结果处理放在同一个调用状态中，一次调用只分配一次
+                auto call = std::make_shared<AsyncCall>();
+                call->init(this, rpc_req, by_id, method_name);
+                result = call->result.get_future();
+                bool ret = sendCall(con, call, observer);
                 if (!ret)
                 {
-                    LOG(Level::Warning, "同步处理请求失败");
+                    LOG(Level::Warning, "异步处理请求失败");
                     return false;
                 }
 
-                // 3. 等待结果
-                auto rpc_resp = std::dynamic_pointer_cast<response_message::RpcResponse>(base_msg);
-                if (rpc_resp->getRCode() != public_data::RCode::RCode_fine)
+                return true;
+            }
+
+            // 回调方式调用函数
+            bool call(const base_connection::BaseConnection::ptr &con, const std::string &method_name, const Json::Value &params, const callback_t &cb,
+                      const CallObserver::ptr &observer = nullptr)
+            {
+                // 1. 创建请求
+                auto rpc_req = message_factory::MessageFactory::messageCreateFactory<request_message::RpcRequest>();
+                rpc_req->setId(requestor_->nextRequestId());
+                rpc_req->setMType(public_data::MType::Req_rpc);
+                bool by_id = setRequestMethod(con, rpc_req, method_name);
+                rpc_req->setParams(params);
+
+                // 设置回调函数
+                auto call = std::make_shared<CallbackCall>();
+                call->init(this, rpc_req, by_id, method_name);
+                call->cb = cb;
+                bool ret = sendCall(con, call, observer);
+                if (!ret)
                 {
-                    LOG(Level::Warning, "结果异常，原因：{}", errReason(rpc_resp->getRCode()));
+                    LOG(Level::Warning, "回调处理请求失败");
                     return false;
                 }
 
-                result = rpc_resp->getResult();
                 return true;
             }
 
-            // 异步调用函数
-            bool call(const base_connection::BaseConnection::ptr &con, const std::string &method_name, const Json::Value &params, aysnc_response &result)
+            // 带返回状态码的回调方式调用函数
+            // 成功和失败（包括超时、连接断开）都会调用一次done，用于上层实现对冲、重试等策略
+            bool callAsync(const base_connection::BaseConnection::ptr &con, const std::string &method_name, const Json::Value &params, done_callback_t done,
+                           const CallObserver::ptr &observer = nullptr)
             {
                 // 1. 创建请求
                 auto rpc_req = message_factory::MessageFactory::messageCreateFactory<request_message::RpcRequest>();
-                rpc_req->setId(uuid_generator::UuidGenerator::generate_uuid());
+                rpc_req->setId(requestor_->nextRequestId());
                 rpc_req->setMType(public_data::MType::Req_rpc);
-                rpc_req->setMethod(method_name);
+                bool by_id = setRequestMethod(con, rpc_req, method_name);
                 rpc_req->setParams(params);
 
                 // 2. 发送请求
-                // 使用智能指针防止局部promise变量被销毁导致错误
-                std::shared_ptr<std::promise<Json::Value>> json_promise = std::make_shared<std::promise<Json::Value>>();
-                result = json_promise->get_future();
-                requestor_rpc_framework::Requestor::callback_t cb = std::bind(&RpcCaller::async_callback, this, json_promise, std::placeholders::_1);
-                // 重载函数必须保证类型完全一致，而父类和子类之间的关系也属于类型不一致
-                bool ret = requestor_->sendRequest(con, std::dynamic_pointer_cast<base_message::BaseMessage>(rpc_req), cb);
+                auto call = std::make_shared<DoneCall>();
+                call->init(this, rpc_req, by_id, method_name);
+                call->done = std::move(done);
+                bool ret = sendCall(con, call, observer);
                 if (!ret)
                 {
-                    LOG(Level::Warning, "异步处理请求失败");
+                    LOG(Level::Warning, "回调处理请求失败");
                     return false;
                 }
 
                 return true;
             }
 
-            // 回调方式调用函数
-            bool call(const base_connection::BaseConnection::ptr &con, const std::string &method_name, const Json::Value &params, const callback_t &cb)
+#ifdef RPC_HAS_COROUTINE
+        private:
+            struct AwaitCall;
+
+        public:
+            // 协程调用的等待体
+            // 挂起时发送请求，响应到达、超时或者连接断开后都在发送请求的连接所属的IO线程中恢复协程
+            // 调用失败时在co_await处抛出RpcError
+            // ! co_await之后直到下一次挂起之前不能执行阻塞操作（包括同步调用），
+            // ! 否则会阻塞该连接上所有响应的接收，需要阻塞时先把工作交给其他线程
+            class CallAwaiter
+            {
+                friend struct AwaitCall;
+
+            public:
+                CallAwaiter(RpcCaller *caller, const base_connection::BaseConnection::ptr &con, const std::string &method_name, const Json::Value &params,
+                            const CallObserver::ptr &observer)
+                    : caller_(caller), con_(con), method_name_(method_name), params_(params), observer_(observer)
+                {
+                }
+
+                bool await_ready() const noexcept
+                {
+                    return false;
+                }
+
+                // 返回false表示发送失败，不挂起直接恢复
+                bool await_suspend(std::coroutine_handle<> handle)
+                {
+                    if (!con_)
+                    {
+                        failed_ = true;
+                        return false;
+                    }
+
+                    handle_ = handle;
+                    auto rpc_req = message_factory::MessageFactory::messageCreateFactory<request_message::RpcRequest>();
+                    rpc_req->setId(caller_->requestor_->nextRequestId());
+                    rpc_req->setMType(public_data::MType::Req_rpc);
+                    bool by_id = caller_->setRequestMethod(con_, rpc_req, method_name_);
+                    rpc_req->setParams(params_);
+
+                    // ! 响应可能在sendRequest返回之前就在IO线程中到达并恢复协程，此后不能再访问当前对象
+                    auto call = std::make_shared<AwaitCall>();
+                    call->init(caller_, rpc_req, by_id, method_name_);
+                    call->awaiter = this;
+                    if (!caller_->sendCall(con_, call, observer_))
+                    {
+                        failed_ = true;
+                        return false;
+                    }
+
+                    return true;
+                }
+
+                Json::Value await_resume()
+                {
+                    if (failed_)
+                        throw RpcError(public_data::RCode::RCode_disconneted);
+
+                    auto rpc_resp = std::dynamic_pointer_cast<response_message::RpcResponse>(response_);
+                    if (!rpc_resp)
+                        throw RpcError(public_data::RCode::RCode_invalid_msg);
+                    if (rpc_resp->getRCode() != public_data::RCode::RCode_fine)
+                        throw RpcError(rpc_resp->getRCode());
+
+                    return rpc_resp->takeResult();
+                }
+
+            private:
+                RpcCaller *caller_;
+                base_connection::BaseConnection::ptr con_;
+                std::string method_name_;
+                Json::Value params_;
+                CallObserver::ptr observer_;
+                std::coroutine_handle<> handle_;
+                base_message::BaseMessage::ptr response_;
+                bool failed_ = false;
+            };
+
+            // 协程调用函数：Json::Value result = co_await caller->call(con, "add", params);
+            CallAwaiter call(const base_connection::BaseConnection::ptr &con, const std::string &method_name, const Json::Value &params,
+                             const CallObserver::ptr &observer = nullptr)
+            {
+                return CallAwaiter(this, con, method_name, params, observer);
+            }
+#endif
+
+            // 流式调用函数
+            // 元素到达后立即交给item_cb处理，流结束或出错时调用一次done_cb
+            bool callStream(const base_connection::BaseConnection::ptr &con, const std::string &method_name, const Json::Value &params,
+                            const stream_item_callback_t &item_cb, const stream_done_callback_t &done_cb)
             {
                 // 1. 创建请求
                 auto rpc_req = message_factory::MessageFactory::messageCreateFactory<request_message::RpcRequest>();
-                rpc_req->setId(uuid_generator::UuidGenerator::generate_uuid());
+                rpc_req->setId(requestor_->nextRequestId());
                 rpc_req->setMType(public_data::MType::Req_rpc);
-                rpc_req->setMethod(method_name);
+                bool by_id = setRequestMethod(con, rpc_req, method_name);
                 rpc_req->setParams(params);
 
-                // 设置回调函数
-                requestor_rpc_framework::Requestor::callback_t req_cb = std::bind(&RpcCaller::cb_callback, this, cb, std::placeholders::_1);
-                bool ret = requestor_->sendRequest(con, std::dynamic_pointer_cast<base_message::BaseMessage>(rpc_req), req_cb);
+                // 2. 发送请求
+                auto call = std::make_shared<StreamCall>();
+                call->init(this, rpc_req, by_id, method_name);
+                call->send_type = public_data::RType::Req_stream;
+                call->item_cb = item_cb;
+                call->done_cb = done_cb;
+                bool ret = requestor_->sendRequest(con, call);
                 if (!ret)
                 {
-                    LOG(Level::Warning, "回调处理请求失败");
+                    LOG(Level::Warning, "流式处理请求失败");
+                    return false;
+                }
+
+                return true;
+            }
+
+            // 批量调用函数
+            // 所有调用放在一个请求中发送，响应到达后按位置设置每一次调用的结果
+            // 发送后批量对象中的调用被取走，同一个批量对象不能重复发送
+            // observer不为空时把整个批量请求作为一次调用记录
+            bool call(const base_connection::BaseConnection::ptr &con, const RpcBatch::ptr &batch, const CallObserver::ptr &observer = nullptr)
+            {
+                if (!batch || batch->calls_.empty())
+                {
+                    LOG(Level::Warning, "批量调用为空");
+                    return false;
+                }
+
+                // 服务端拒绝超过上限的批量调用，直接以数据过大结束所有调用
+                if (batch->calls_.size() > public_data::max_batch_calls)
+                {
+                    LOG(Level::Warning, "批量调用包含{}个调用，超过上限{}", batch->calls_.size(), public_data::max_batch_calls);
+                    for (auto &c : batch->calls_)
+                        c.result.set_exception(std::make_exception_ptr(RpcError(public_data::RCode::RCode_too_large)));
+                    batch->calls_.clear();
+                    return false;
+                }
+
+                // 1. 创建请求
+                auto batch_req = message_factory::MessageFactory::messageCreateFactory<request_message::BatchRpcRequest>();
+                batch_req->setId(requestor_->nextRequestId());
+                batch_req->setMType(public_data::MType::Req_batch_rpc);
+                bool by_id = false;
+                for (auto &c : batch->calls_)
+                {
+                    int method_id = findMethodId(con, c.method);
+                    by_id = by_id || method_id >= 0;
+                    batch_req->addCall(c.method, method_id, c.params);
+                }
+                setRequestTimeout(batch_req);
+
+                // 2. 取走所有调用，由响应回调负责设置结果
+                auto call = std::make_shared<BatchCall>();
+                call->request = batch_req;
+                call->caller = this;
+                call->by_id = by_id;
+                call->calls = std::move(batch->calls_);
+                batch->calls_.clear();
+
+                bool ret = sendCall(con, call, observer);
+                if (!ret)
+                {
+                    LOG(Level::Warning, "批量处理请求失败");
                     return false;
                 }
 
                 return true;
             }
 
+            // 获取服务端的方法表，连接建立后调用
+            // 获取失败时（例如服务端不支持方法表）继续使用方法名调用
+            bool fetchMethodTable(const base_connection::BaseConnection::ptr &con)
+            {
+                Json::Value table;
+                if (!call(con, public_data::method_table_name, Json::Value(Json::objectValue), table) || !table.isObject())
+                {
+                    LOG(Level::Info, "服务端未提供方法表，使用方法名进行调用");
+                    return false;
+                }
+
+                std::unordered_map<std::string, int> ids;
+                for (const auto &name : table.getMemberNames())
+                    ids.insert({name, table[name].asInt()});
+
+                std::unique_lock<std::mutex> lock(manage_table_mtx_);
+                method_tables_[con] = std::move(ids);
+
+                return true;
+            }
+
+            // 连接断开时删除对应的方法表
+            void removeMethodTable(const base_connection::BaseConnection::ptr &con)
+            {
+                std::unique_lock<std::mutex> lock(manage_table_mtx_);
+                method_tables_.erase(con);
+            }
+
         private:
-            // 回调请求函数
-            void cb_callback(const callback_t &cb, base_message::BaseMessage::ptr &msg)
+            // 设置请求中的方法
+            // 存在方法编号时只携带编号，不存在时携带方法名，返回是否只携带了编号
+            bool setRequestMethod(const base_connection::BaseConnection::ptr &con, const request_message::RpcRequest::ptr &rpc_req, const std::string &method_name)
             {
-                auto resp_rpc = std::dynamic_pointer_cast<response_message::RpcResponse>(msg);
-                if (!resp_rpc)
+                setRequestTimeout(rpc_req);
+
+                int method_id = findMethodId(con, method_name);
+                if (method_id >= 0)
                 {
-                    LOG(Level::Warning, "异步回调内部对象转换失败");
-                    return;
+                    rpc_req->setMethodId(method_id);
+                    return true;
                 }
 
-                if (resp_rpc->getRCode() != public_data::RCode::RCode_fine)
+                rpc_req->setMethod(method_name);
+                return false;
+            }
+
+            // 缓存的方法编号失效后重新发送调用，请求已经改为携带方法名
+            // 删除连接的方法表，之后的调用都携带方法名
+            bool resend(const requestor_rpc_framework::Requestor::RequestDesc::ptr &rd)
+            {
+                LOG(Level::Info, "方法编号已经失效，使用方法名重新调用");
+                removeMethodTable(rd->con);
+                rd->request->setId(requestor_->nextRequestId());
+                return requestor_->sendRequest(rd->con, rd);
+            }
+
+            // 当前线程设置了截止时间时（在服务端的业务回调中或者调用者设置了Scope），请求携带剩余时间
+            static void setRequestTimeout(const json_message::JsonRequest::ptr &req)
+            {
+                if (call_context::CallContext::hasDeadline())
+                    req->setTimeout(call_context::CallContext::remainingMs());
+            }
+
+            // 从连接对应的方法表中查找方法编号，不存在时返回-1
+            int findMethodId(const base_connection::BaseConnection::ptr &con, const std::string &method_name)
+            {
+                std::unique_lock<std::mutex> lock(manage_table_mtx_);
+                auto it_table = method_tables_.find(con);
+                if (it_table == method_tables_.end())
+                    return -1;
+
+                auto it_id = it_table->second.find(method_name);
+                if (it_id == it_table->second.end())
+                    return -1;
+
+                return it_id->second;
+            }
+
+            // 流式请求回调函数，返回true表示流已经结束
+            static bool stream_callback(const stream_item_callback_t &item_cb, const stream_done_callback_t &done_cb, base_message::BaseMessage::ptr &msg)
+            {
+                auto stream_resp = std::dynamic_pointer_cast<response_message::RpcStreamResponse>(msg);
+                if (!stream_resp)
                 {
-                    LOG(Level::Warning, "结果异常，原因：{}", errReason(resp_rpc->getRCode()));
-                    return;
+                    // 服务端在进入流之前出错（例如服务不存在）或者调用的是普通服务时返回普通响应
+                    // 普通服务的结果视为只有一个元素的流
+                    auto rpc_resp = std::dynamic_pointer_cast<response_message::RpcResponse>(msg);
+                    public_data::RCode rcode = rpc_resp ? rpc_resp->getRCode() : public_data::RCode::RCode_invalid_msg;
+                    if (rcode == public_data::RCode::RCode_fine && item_cb)
+                        item_cb(rpc_resp->takeResult());
+                    if (done_cb)
+                        done_cb(rcode);
+                    return true;
                 }
 
-                // 调用回调函数处理结果
-                cb(resp_rpc->getResult());
+                switch (stream_resp->getStreamState())
+                {
+                case public_data::StreamState::Stream_item:
+                    if (item_cb)
+                        item_cb(stream_resp->takeResult());
+                    return false;
+                case public_data::StreamState::Stream_end:
+                    if (done_cb)
+                        done_cb(public_data::RCode::RCode_fine);
+                    return true;
+                default:
+                    LOG(Level::Warning, "流式结果异常，原因：{}", errReason(stream_resp->getRCode()));
+                    if (done_cb)
+                        done_cb(stream_resp->getRCode());
+                    return true;
+                }
             }
 
-            // 异步请求回调函数
-            void async_callback(std::shared_ptr<std::promise<Json::Value>> result, base_message::BaseMessage::ptr &msg)
+            // 批量请求回调函数
+            static void batch_callback(std::vector<RpcBatch::CallEntry> &calls, base_message::BaseMessage::ptr &msg)
             {
-                auto resp_rpc = std::dynamic_pointer_cast<response_message::RpcResponse>(msg);
-                if (!resp_rpc)
+                auto batch_resp = std::dynamic_pointer_cast<response_message::BatchRpcResponse>(msg);
+                public_data::RCode rcode = batch_resp ? batch_resp->getRCode() : public_data::RCode::RCode_invalid_msg;
+                if (rcode != public_data::RCode::RCode_fine)
                 {
-                    LOG(Level::Warning, "异步回调内部对象转换失败");
+                    LOG(Level::Warning, "批量结果异常，原因：{}", errReason(rcode));
+                    for (auto &c : calls)
+                        c.result.set_exception(std::make_exception_ptr(RpcError(rcode)));
                     return;
                 }
 
-                if (resp_rpc->getRCode() != public_data::RCode::RCode_fine)
+                // 结果与调用按位置对应，缺少的结果视为无效消息
+                size_t count = batch_resp->resultCount();
+                for (size_t i = 0; i < calls.size(); i++)
                 {
-                    LOG(Level::Warning, "结果异常，原因：{}", errReason(resp_rpc->getRCode()));
-                    return;
+                    public_data::RCode call_rcode = i < count ? batch_resp->getRCode(i) : public_data::RCode::RCode_invalid_msg;
+                    if (call_rcode != public_data::RCode::RCode_fine)
+                        calls[i].result.set_exception(std::make_exception_ptr(RpcError(call_rcode)));
+                    else
+                        calls[i].result.set_value(batch_resp->takeResult(i));
+                }
+            }
+
+            // 以下为一次调用的状态，继承请求描述，请求、结果和回调处理只占一次分配
+            // 响应只交给这一次调用，结果直接从响应中取走，不再复制
+
+            // 调用状态的公共部分
+            // 只携带方法编号的调用返回服务不存在时，服务端可能删除后重新注册了该方法，缓存的编号已经失效
+            // 此时改为携带方法名重新发送一次，不交给调用者
+            struct RpcCall : public requestor_rpc_framework::Requestor::RequestDesc, public std::enable_shared_from_this<RpcCall>
+            {
+                RpcCaller *caller = nullptr;
+                std::string method_name; // 只携带方法编号时记录方法名，重新发送后清空
+                CallObserver::ptr observer;                  // 调用的观察者，为空表示不记录
+                std::chrono::steady_clock::time_point start; // 发送时间，存在观察者时记录
+
+                void init(RpcCaller *c, const request_message::RpcRequest::ptr &req, bool by_id, const std::string &method)
+                {
+                    caller = c;
+                    request = req;
+                    if (by_id)
+                        method_name = method;
                 }
-                result->set_value(resp_rpc->getResult());
+
+                bool complete(base_message::BaseMessage::ptr &msg) override
+                {
+                    if (toMethodName(msg) && caller->resend(shared_from_this()))
+                        return true;
+
+                    if (observer)
+                    {
+                        auto resp = std::dynamic_pointer_cast<json_message::JsonResponse>(msg);
+                        observer->onFinish(resp ? resp->getRCode() : public_data::RCode::RCode_invalid_msg, std::chrono::steady_clock::now() - start);
+                    }
+                    return onResponse(msg);
+                }
+
+                // 处理调用的响应，返回true表示调用已经结束
+                virtual bool onResponse(base_message::BaseMessage::ptr &msg) = 0;
+
+                // 缓存的编号失效时将请求改为携带方法名，返回true表示需要重新发送
+                virtual bool toMethodName(base_message::BaseMessage::ptr &msg)
+                {
+                    auto resp = std::dynamic_pointer_cast<json_message::JsonResponse>(msg);
+                    if (method_name.empty() || !resp || resp->getRCode() != public_data::RCode::RCode_not_found_service)
+                        return false;
+
+                    auto rpc_req = std::static_pointer_cast<request_message::RpcRequest>(request);
+                    rpc_req->clearMethodId();
+                    rpc_req->setMethod(method_name);
+                    method_name.clear();
+                    return true;
+                }
+            };
+
+            // 异步调用：结果交给future
+            struct AsyncCall : public RpcCall
+            {
+                std::promise<Json::Value> result;
+
+                bool onResponse(base_message::BaseMessage::ptr &msg) override
+                {
+                    auto resp_rpc = std::dynamic_pointer_cast<response_message::RpcResponse>(msg);
+                    if (!resp_rpc)
+                    {
+                        LOG(Level::Warning, "异步回调内部对象转换失败");
+                        result.set_exception(std::make_exception_ptr(RpcError(public_data::RCode::RCode_invalid_msg)));
+                        return true;
+                    }
+
+                    // 错误状态码（例如服务过载）通过异常交给调用者，避免future一直等待
+                    if (resp_rpc->getRCode() != public_data::RCode::RCode_fine)
+                    {
+                        LOG(Level::Warning, "结果异常，原因：{}", errReason(resp_rpc->getRCode()));
+                        result.set_exception(std::make_exception_ptr(RpcError(resp_rpc->getRCode())));
+                        return true;
+                    }
+
+                    result.set_value(resp_rpc->takeResult());
+                    return true;
+                }
+            };
+
+            // 回调调用：成功时调用回调处理结果
+            struct CallbackCall : public RpcCall
+            {
+                callback_t cb;
+
+                bool onResponse(base_message::BaseMessage::ptr &msg) override
+                {
+                    auto resp_rpc = std::dynamic_pointer_cast<response_message::RpcResponse>(msg);
+                    if (!resp_rpc)
+                    {
+                        LOG(Level::Warning, "异步回调内部对象转换失败");
+                        return true;
+                    }
+
+                    if (resp_rpc->getRCode() != public_data::RCode::RCode_fine)
+                    {
+                        LOG(Level::Warning, "结果异常，原因：{}", errReason(resp_rpc->getRCode()));
+                        return true;
+                    }
+
+                    // 调用回调函数处理结果
+                    cb(resp_rpc->takeResult());
+                    return true;
+                }
+            };
+
+            // 带返回状态码的回调调用：成功和失败都调用一次done
+            struct DoneCall : public RpcCall
+            {
+                done_callback_t done;
+
+                bool onResponse(base_message::BaseMessage::ptr &msg) override
+                {
+                    auto resp_rpc = std::dynamic_pointer_cast<response_message::RpcResponse>(msg);
+                    if (!resp_rpc)
+                        done(public_data::RCode::RCode_invalid_msg, Json::Value());
+                    else
+                        done(resp_rpc->getRCode(), resp_rpc->takeResult());
+                    return true;
+                }
+            };
+
+            // 流式调用：每个元素交给item_cb，返回true表示流已经结束
+            struct StreamCall : public RpcCall
+            {
+                stream_item_callback_t item_cb;
+                stream_done_callback_t done_cb;
+
+                bool onResponse(base_message::BaseMessage::ptr &msg) override
+                {
+                    return stream_callback(item_cb, done_cb, msg);
+                }
+            };
+
+#ifdef RPC_HAS_COROUTINE
+            // 协程调用：保存响应，在连接的IO线程中恢复协程
+            // 超时在Requestor的定时线程、连接断开在处理断开的线程中完成请求，不能直接在这些线程中恢复
+            struct AwaitCall : public RpcCall
+            {
+                CallAwaiter *awaiter = nullptr;
+
+                bool onResponse(base_message::BaseMessage::ptr &msg) override
+                {
+                    awaiter->response_ = msg;
+                    std::coroutine_handle<> handle = awaiter->handle_;
+                    con->runInLoop([handle]()
+                                   { handle.resume(); });
+                    return true;
+                }
+            };
+#endif
+
+            // 批量调用：响应到达后按位置设置每一次调用的结果
+
+            // 只携带方法编号的调用返回服务不存在时，整个批量改为携带方法名重新发送一次
+            struct BatchCall : public RpcCall
+            {
+                std::vector<RpcBatch::CallEntry> calls;
+                bool by_id = false; // 是否存在只携带方法编号的调用
+
+                bool onResponse(base_message::BaseMessage::ptr &msg) override
+                {
+                    batch_callback(calls, msg);
+                    return true;
+                }
+
+                bool toMethodName(base_message::BaseMessage::ptr &msg) override
+                {
+                    auto batch_resp = std::dynamic_pointer_cast<response_message::BatchRpcResponse>(msg);
+                    if (!by_id || !batch_resp || batch_resp->getRCode() != public_data::RCode::RCode_fine)
+                        return false;
+
+                    auto batch_req = std::static_pointer_cast<request_message::BatchRpcRequest>(request);
+                    size_t count = std::min(batch_resp->resultCount(), calls.size());
+                    bool stale = false;
+                    for (size_t i = 0; i < count && !stale; i++)
+                        stale = batch_resp->getRCode(i) == public_data::RCode::RCode_not_found_service && batch_req->getMethodId(i) >= 0;
+                    if (!stale)
+                        return false;
+
+                    auto req = message_factory::MessageFactory::messageCreateFactory<request_message::BatchRpcRequest>();
+                    req->setMType(public_data::MType::Req_batch_rpc);
+                    for (auto &c : calls)
+                        req->addCall(c.method, -1, c.params);
+                    if (batch_req->getTimeout() >= 0)
+                        req->setTimeout(batch_req->getTimeout());
+                    request = req;
+                    by_id = false;
+                    return true;
+                }
+            };
+
+            // 发送普通调用，存在观察者时记录开始时间，发送失败时同样通知观察者
+            bool sendCall(const base_connection::BaseConnection::ptr &con, const std::shared_ptr<RpcCall> &call, const CallObserver::ptr &observer)
+            {
+                if (observer)
+                {
+                    call->observer = observer;
+                    call->start = std::chrono::steady_clock::now();
+                    observer->onStart();
+                }
+
+                if (requestor_->sendRequest(con, call))
+                    return true;
+
+                if (observer)
+                    observer->onFinish(public_data::RCode::RCode_disconneted, std::chrono::steady_clock::duration::zero());
+                return false;
             }
 
         private:
             requestor_rpc_framework::Requestor::ptr requestor_; // 调用Requestor模块中的发送函数
+            std::mutex manage_table_mtx_;                       // 管理方法表的互斥锁
+            std::unordered_map<base_connection::BaseConnection::ptr, std::unordered_map<std::string, int>> method_tables_; // 每一个连接对应的方法表
         };
     }
 }
@@ -1,9 +1,13 @@
 #ifndef __rpc_rpc_registry_client_h__
 #define __rpc_rpc_registry_client_h__
 
+#include <algorithm>
 #include <rpc_framework/client/requestor.h>
+#include <rpc_framework/client/rpc_caller.h>
+#include <rpc_framework/client/load_balance.h>
+#include <rpc_framework/client/outlier_detection.h>
 #include <rpc_framework/factories/message_factory.h>
-#include <rpc_framework/utils/uuid_generator.h>
+#include <rpc_framework/utils/rcu_snapshot.h>
 
 namespace rpc_client
 {
@@ -28,7 +32,7 @@ namespace rpc_client
                 // 创建服务注册请求并填充字段
                 auto service_req = message_factory::MessageFactory::messageCreateFactory<request_message::ServiceRequest>();
 
-                service_req->setId(uuid_generator::UuidGenerator::generate_uuid());
+                service_req->setId(requestor_->nextRequestId());
                 service_req->setMethod(method);
                 service_req->setHost(host);
                 service_req->setServiceOptype(public_data::ServiceOptype::Service_register);
@@ -59,59 +63,215 @@ namespace rpc_client
             rpc_client::requestor_rpc_framework::Requestor::ptr requestor_;
         };
 
-        // 使用RR轮询的策略请求服务，提供指定函数的提供者信息和对应下标的结构
+        // 把一个提供者上的调用记录到它的负载信息和方法的异常检测中
+        // 每个主机在主机列表或者策略变化时创建一个，调用时直接随主机返回，不需要为每次调用分配
+        // 试探请求单独创建一个带有试探编号的观察者，异常检测只根据该请求的结果恢复或者继续隔离
+        class EndpointObserver : public rpc_caller::CallObserver
+        {
+        public:
+            EndpointObserver(const public_data::host_addr_t &host, const load_balance::HostStats::ptr &stats, const outlier::OutlierDetector::ptr &detector,
+                             int64_t probe = 0)
+                : host_(host), stats_(stats), detector_(detector), probe_(probe)
+            {
+            }
+
+            virtual void onStart() override
+            {
+                stats_->onStart();
+            }
+
+            virtual void onFinish(public_data::RCode rcode, std::chrono::steady_clock::duration latency) override
+            {
+                stats_->onFinish(latency, rcode == public_data::RCode::RCode_fine);
+                if (detector_)
+                    detector_->onResult(host_, stats_, rcode, probe_);
+            }
+
+        private:
+            public_data::host_addr_t host_;
+            load_balance::HostStats::ptr stats_;
+            outlier::OutlierDetector::ptr detector_;
+            int64_t probe_; // 试探请求编号，0表示普通请求
+        };
+
+        // 一个方法的所有服务提供者，按照负载均衡策略选择
+        // 主机列表或者策略变化时重新创建负载均衡器并替换快照，选择时读取快照，不需要加锁
+        // 开启异常检测后跳过被隔离的提供者
         class HostManager
         {
         public:
             using ptr = std::shared_ptr<HostManager>;
+            using weights_t = std::unordered_map<public_data::host_addr_t, int, load_balance::HostAddrHash>;
 
-            HostManager(const std::vector<public_data::host_addr_t> &hosts = std::vector<public_data::host_addr_t>())
-                : hosts_(hosts), index_(0)
+            HostManager(const std::vector<public_data::host_addr_t> &hosts = std::vector<public_data::host_addr_t>(),
+                        load_balance::Strategy strategy = load_balance::Strategy::RoundRobin, const weights_t &weights = weights_t())
+                : strategy_(strategy)
             {
+                std::unique_lock<std::mutex> lock(manage_mtx_);
+                for (const auto &host : hosts)
+                    addEndpoint(host, weights);
+                rebuild();
             }
 
             void insertHost(const public_data::host_addr_t &host)
             {
                 std::unique_lock<std::mutex> lock(manage_mtx_);
-                hosts_.push_back(host);
+                if (findEndpoint(host) != endpoints_.end())
+                    return;
+
+                addEndpoint(host, weights_t());
+                rebuild();
             }
 
             public_data::host_addr_t choostHost()
             {
-                std::unique_lock<std::mutex> lock(manage_mtx_);
-                auto pos = (index_++) % hosts_.size();
+                load_balance::Endpoint endpoint;
+                choostHost(std::string(), std::vector<public_data::host_addr_t>(), endpoint, false);
+                return endpoint.host;
+            }
+
+            // 选择一个不在excluded中的主机，例如对冲请求需要选择与原请求不同的主机
+            // 所有主机都被排除时返回false
+            bool choostHost(const std::vector<public_data::host_addr_t> &excluded, public_data::host_addr_t &host)
+            {
+                load_balance::Endpoint endpoint;
+                if (!choostHost(std::string(), excluded, endpoint, false))
+                    return false;
 
-                return hosts_[pos];
+                host = endpoint.host;
+                return true;
+            }
+
+            // 按照负载均衡策略选择一个不在excluded中的主机，同时返回主机的负载信息用于记录调用
+            // key为请求的哈希键，只有一致性哈希策略使用
+            // 调用结果不会交给endpoint.observer时admit_probe必须为false，否则试探请求的结果丢失，提供者在下一次试探前无法恢复
+            bool choostHost(const std::string &key, const std::vector<public_data::host_addr_t> &excluded, load_balance::Endpoint &endpoint, bool admit_probe = true)
+            {
+                // 快照在当前线程下一次读取前有效，选择期间不会读取其他快照
+                const load_balance::LoadBalancer::ptr &balancer = balancer_.read();
+                if (!balancer || !balancer->select(key, excluded, endpoint, admit_probe))
+                    return false;
+
+                if (endpoint.probe)
+                    endpoint.observer = std::make_shared<EndpointObserver>(endpoint.host, endpoint.stats, endpoint.detector, endpoint.probe);
+                return true;
             }
 
             void removeHost(const public_data::host_addr_t &host)
             {
                 std::unique_lock<std::mutex> lock(manage_mtx_);
+                auto pos = findEndpoint(host);
+                if (pos == endpoints_.end())
+                    return;
 
-                auto it = hosts_.begin();
-                std::vector<public_data::host_addr_t>::iterator pos;
-                while (it != hosts_.end())
+                endpoints_.erase(pos);
+                rebuild();
+            }
+
+            bool emptyHosts()
+            {
+                std::unique_lock<std::mutex> lock(manage_mtx_);
+                return endpoints_.empty();
+            }
+
+            // 修改负载均衡策略，已有主机的负载信息保留
+            void setStrategy(load_balance::Strategy strategy)
+            {
+                std::unique_lock<std::mutex> lock(manage_mtx_);
+                strategy_ = strategy;
+                rebuild();
+            }
+
+            // 修改主机的权重，不存在该主机时忽略
+            void setWeight(const public_data::host_addr_t &host, int weight)
+            {
+                std::unique_lock<std::mutex> lock(manage_mtx_);
+                auto pos = findEndpoint(host);
+                if (pos == endpoints_.end())
+                    return;
+
+                pos->weight = clampWeight(weight);
+                rebuild();
+            }
+
+            // 开启异常检测，method用于事件中标识方法
+            void setOutlierPolicy(const std::string &method, const outlier::OutlierPolicy &policy, const outlier::OutlierDetector::event_callback_t &cb)
+            {
+                std::unique_lock<std::mutex> lock(manage_mtx_);
+                detector_ = std::make_shared<outlier::OutlierDetector>(method, policy, cb);
+                rebuild();
+            }
+
+            // 获取统计信息：{strategy, hosts: [{host, weight, outstanding, ewma_us, state, probes}], outlier}
+            Json::Value stats()
+            {
+                std::unique_lock<std::mutex> lock(manage_mtx_);
+                Json::Value result;
+                result["strategy"] = load_balance::strategyName(strategy_);
+                result["hosts"] = Json::Value(Json::arrayValue);
+                for (const auto &endpoint : endpoints_)
                 {
-                    if ((*it) == host)
-                    {
-                        pos = it;
-                        break;
-                    }
+                    Json::Value host;
+                    host["host"] = endpoint.host.first + ":" + std::to_string(endpoint.host.second);
+                    host["weight"] = endpoint.weight;
+                    host["outstanding"] = static_cast<Json::Int64>(endpoint.stats->outstanding());
+                    host["ewma_us"] = static_cast<Json::Int64>(endpoint.stats->ewmaUs());
+                    host["state"] = load_balance::hostStateName(endpoint.stats->state());
+                    host["probes"] = static_cast<Json::Int64>(endpoint.stats->probes());
+                    result["hosts"].append(host);
                 }
+                if (detector_)
+                    result["outlier"] = detector_->stats();
+                return result;
+            }
 
-                hosts_.erase(pos);
+        private:
+            static constexpr int max_weight = 100; // 权重上限，限制加权轮询一轮的长度和一致性哈希的虚拟节点个数
+
+            static int clampWeight(int weight)
+            {
+                return std::min(std::max(weight, 1), max_weight);
             }
 
-            bool emptyHosts()
+            // 调用者需要持有锁
+            load_balance::endpoints_t::iterator findEndpoint(const public_data::host_addr_t &host)
             {
-                std::unique_lock<std::mutex> lock(manage_mtx_);
-                return hosts_.empty();
+                return std::find_if(endpoints_.begin(), endpoints_.end(), [&host](const load_balance::Endpoint &endpoint)
+                                    { return endpoint.host == host; });
+            }
+
+            void addEndpoint(const public_data::host_addr_t &host, const weights_t &weights)
+            {
+                load_balance::Endpoint endpoint;
+                endpoint.host = host;
+                auto pos = weights.find(host);
+                endpoint.weight = pos == weights.end() ? 1 : clampWeight(pos->second);
+                endpoint.stats = std::make_shared<load_balance::HostStats>();
+                endpoints_.push_back(endpoint);
+            }
+
+            // 根据当前的主机列表和策略创建新的负载均衡器并替换快照
+            void rebuild()
+            {
+                for (auto &endpoint : endpoints_)
+                {
+                    endpoint.detector = detector_;
+                    endpoint.observer = std::make_shared<EndpointObserver>(endpoint.host, endpoint.stats, detector_);
+                }
+                if (detector_)
+                    detector_->setHosts(endpoints_);
+
+                auto balancer = load_balance::LoadBalancerFactory::create(strategy_, endpoints_);
+                balancer_.update([&balancer](load_balance::LoadBalancer::ptr &cur)
+                                 { cur = balancer; });
             }
 
         private:
-            std::mutex manage_mtx_; // 保证主机地址信息的线程安全
-            size_t index_;          // 当前选择的服务提供者对应的下标
-            std::vector<public_data::host_addr_t> hosts_;
+            std::mutex manage_mtx_;                                        // 保护主机列表和策略，只在修改时使用
+            load_balance::Strategy strategy_;                              // 负载均衡策略
+            load_balance::endpoints_t endpoints_;                          // 主机列表
+            outlier::OutlierDetector::ptr detector_;                       // 异常检测，为空表示不检测
+            rcu_snapshot::RcuSnapshot<load_balance::LoadBalancer::ptr> balancer_; // 负载均衡器快照
         };
 
         class Discoverer
@@ -142,19 +302,21 @@ namespace rpc_client
                     // 再添加到哈希表中
 
                     LOG(Level::Info, "服务提供者：{}:{}上线了一个{}服务", msg->getHost().first, msg->getHost().second, msg->getMethod());
-                    auto pos = service_providers_.find(method);
-                    if (pos == service_providers_.end())
+                    HostManager::ptr method_hosts = findHostManager(method);
+                    if (!method_hosts)
                     {
                         // 不存在指定服务
-                        auto host = std::make_shared<HostManager>();
-                        host->insertHost(msg->getHost());
-                        service_providers_[method] = host;
+                        auto host = createHostManager(method, std::vector<public_data::host_addr_t>{msg->getHost()});
+                        service_providers_.update([&method, &host](providers_t &providers)
+                                                  { providers[method] = host; });
                     }
                     else
                     {
                         // 存在直接添加
-                        auto method_hosts = pos->second;
                         method_hosts->insertHost(msg->getHost());
+                        auto weight = host_weights_.find(msg->getHost());
+                        if (weight != host_weights_.end())
+                            method_hosts->setWeight(msg->getHost(), weight->second);
                     }
                 }
                 else if(type == public_data::ServiceOptype::Service_offline)
@@ -163,13 +325,12 @@ namespace rpc_client
 
                     // 2. 服务下线请求处理
                     // 将对应服务的主机从管理主机信息的结构中移除
-                    auto pos = service_providers_.find(method);
-                    if(pos == service_providers_.end())
+                    HostManager::ptr method_hosts = findHostManager(method);
+                    if(!method_hosts)
                     {
                         LOG(Level::Warning, "不存在指定的服务");
                         return; 
                     }
-                    auto method_hosts = pos->second;
                     auto host = msg->getHost();
                     method_hosts->removeHost(host);
 
@@ -182,27 +343,41 @@ namespace rpc_client
             // 进行服务发现
             bool discoverHost(const base_connection::BaseConnection::ptr &con, const std::string &method, public_data::host_addr_t &host)
             {
+                return discoverHost(con, method, std::vector<public_data::host_addr_t>(), host);
+            }
+
+            // 进行服务发现，选择的主机不在excluded中，没有其他主机时返回false
+            bool discoverHost(const base_connection::BaseConnection::ptr &con, const std::string &method, const std::vector<public_data::host_addr_t> &excluded, public_data::host_addr_t &host)
+            {
+                load_balance::Endpoint endpoint;
+                if (!discoverHost(con, method, std::string(), excluded, endpoint, false))
+                    return false;
+
+                host = endpoint.host;
+                return true;
+            }
+
+            // 进行服务发现，按照方法的负载均衡策略选择不在excluded中的主机，同时返回主机的负载信息
+            // key为请求的哈希键，只有一致性哈希策略使用；admit_probe见HostManager::choostHost
+            bool discoverHost(const base_connection::BaseConnection::ptr &con, const std::string &method, const std::string &key,
+                              const std::vector<public_data::host_addr_t> &excluded, load_balance::Endpoint &endpoint, bool admit_probe = true)
+            {
+                // 判断是否存在指定的方法，如果存在，通过选择策略选择主机通过输出型参数返回给上层
+                // 方法表和主机列表都从快照中读取，选择过程不加锁
+                HostManager::ptr method_host = findHostManager(method);
+                if (method_host)
                 {
-                    std::unique_lock<std::mutex> lock(manage_mtx_);
-                    // 判断是否存在指定的方法，如果存在，通过选择策略选择主机通过输出型参数返回给上层
-                    auto pos = service_providers_.find(method);
-                    if (pos != service_providers_.end())
-                    {
-                        // 判断主机信息管理结构是否为空
-                        // 如果不为空，说明可以选择一个主机信息进行返回
-                        auto method_host = pos->second;
-                        if (!method_host->emptyHosts())
-                        {
-                            host = method_host->choostHost();
-                            return true;
-                        }
-                    }
+                    if (method_host->choostHost(key, excluded, endpoint, admit_probe))
+                        return true;
+                    // 存在主机但是都被排除了
+                    if (!method_host->emptyHosts())
+                        return false;
                 }
 
                 // 如果不存在指定的方法，那么肯定不存在对应的MethodHost结构
                 // 此时就需要向服务端发起服务发现的请求
                 auto service_req = message_factory::MessageFactory::messageCreateFactory<request_message::ServiceRequest>();
-                service_req->setId(uuid_generator::UuidGenerator::generate_uuid());
+                service_req->setId(requestor_->nextRequestId());
                 service_req->setMethod(method);
                 service_req->setMType(public_data::MType::Req_service);
                 service_req->setServiceOptype(public_data::ServiceOptype::Service_discover);
@@ -223,21 +398,98 @@ namespace rpc_client
                     return false;
                 }
 
-                std::unique_lock<std::mutex> lock(manage_mtx_);
-                // 此时说明一定存在服务了
-                // 构建MethodHost对象
-                auto methodHost = std::make_shared<HostManager>(service_resp->getHosts());
+                {
+                    std::unique_lock<std::mutex> lock(manage_mtx_);
+                    // 此时说明一定存在服务了
+                    // 构建MethodHost对象，已经存在（并发的发现或者上线通知）且不为空时沿用原来的对象
+                    method_host = findHostManager(method);
+                    if (!method_host || method_host->emptyHosts())
+                    {
+                        method_host = createHostManager(method, service_resp->getHosts());
+                        // 插入到映射表
+                        service_providers_.update([&method, &method_host](providers_t &providers)
+                                                  { providers[method] = method_host; });
+                    }
+                }
+
                 // 获取一个host返回
-                host = methodHost->choostHost();
-                // 插入到映射表
-                service_providers_[method] = methodHost;
+                return method_host->choostHost(key, excluded, endpoint, admit_probe);
+            }
 
-                return true;
+            // 设置方法的负载均衡策略，可以在服务发现之前设置
+            void setStrategy(const std::string &method, load_balance::Strategy strategy)
+            {
+                std::unique_lock<std::mutex> lock(manage_mtx_);
+                strategies_[method] = strategy;
+                HostManager::ptr method_host = findHostManager(method);
+                if (method_host)
+                    method_host->setStrategy(strategy);
+            }
+
+            // 开启方法的异常检测，可以在服务发现之前设置，cb在隔离和恢复时调用
+            void setOutlierPolicy(const std::string &method, const outlier::OutlierPolicy &policy, const outlier::OutlierDetector::event_callback_t &cb)
+            {
+                std::unique_lock<std::mutex> lock(manage_mtx_);
+                outlier_policies_[method] = OutlierConfig{policy, cb};
+                HostManager::ptr method_host = findHostManager(method);
+                if (method_host)
+                    method_host->setOutlierPolicy(method, policy, cb);
+            }
+
+            // 设置服务提供者的权重（1~100，默认为1），对提供者的所有方法生效
+            void setHostWeight(const public_data::host_addr_t &host, int weight)
+            {
+                std::unique_lock<std::mutex> lock(manage_mtx_);
+                host_weights_[host] = weight;
+                for (const auto &provider : *service_providers_.snapshot())
+                    provider.second->setWeight(host, weight);
+            }
+
+            // 获取负载均衡统计信息：{方法名: {strategy, hosts: [{host, weight, outstanding, ewma_us, state, probes}], outlier}}
+            Json::Value stats()
+            {
+                Json::Value result(Json::objectValue);
+                for (const auto &provider : *service_providers_.snapshot())
+                    result[provider.first] = provider.second->stats();
+                return result;
+            }
+
+        private:
+            using providers_t = std::unordered_map<std::string, HostManager::ptr>;
+
+            struct OutlierConfig
+            {
+                outlier::OutlierPolicy policy;
+                outlier::OutlierDetector::event_callback_t cb;
+            };
+
+            // 从快照中查找方法对应的主机管理对象，返回共享指针，不引用快照中的数据
+            HostManager::ptr findHostManager(const std::string &method)
+            {
+                const providers_t &providers = service_providers_.read();
+                auto pos = providers.find(method);
+                if (pos == providers.end())
+                    return HostManager::ptr();
+                return pos->second;
+            }
+
+            // 按照方法的负载均衡配置创建主机管理对象，调用者需要持有manage_mtx_
+            HostManager::ptr createHostManager(const std::string &method, const std::vector<public_data::host_addr_t> &hosts)
+            {
+                auto strategy = strategies_.find(method);
+                auto method_host = std::make_shared<HostManager>(hosts, strategy == strategies_.end() ? load_balance::Strategy::RoundRobin : strategy->second, host_weights_);
+                auto outlier = outlier_policies_.find(method);
+                if (outlier != outlier_policies_.end())
+                    method_host->setOutlierPolicy(method, outlier->second.policy, outlier->second.cb);
+                return method_host;
             }
 
         private:
-            std::mutex manage_mtx_;
-            std::unordered_map<std::string, HostManager::ptr> service_providers_; // 每一个方法对应的所有提供者信息和方法映射表
+            std::mutex manage_mtx_;                                    // 保护方法表的修改和负载均衡配置，选择主机时不使用
+            rcu_snapshot::RcuSnapshot<providers_t> service_providers_; // 每一个方法对应的所有提供者信息和方法映射表
+            std::unordered_map<std::string, load_balance::Strategy> strategies_; // 方法的负载均衡策略，默认轮询
+            HostManager::weights_t host_weights_;                                 // 服务提供者的权重
+            std::unordered_map<std::string, OutlierConfig> outlier_policies_;     // 方法的异常检测策略
             requestor_rpc_framework::Requestor::ptr requestor_;
             // 客户端离线时的处理回调
             offlineCallback_t offline_cb_;
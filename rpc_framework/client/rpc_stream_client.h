@@ -0,0 +1,112 @@
+#ifndef __rpc_rpc_stream_client_h__
+#define __rpc_rpc_stream_client_h__
+
+#include <string>
+#include <rpc_framework/base/base_connection.h>
+#include <rpc_framework/base/stream_message.h>
+#include <rpc_framework/base/rpc_stream.h>
+#include <rpc_framework/factories/message_factory.h>
+#include <rpc_framework/client/requestor.h>
+#include <rpc_framework/utils/uuid_generator.h>
+
+namespace rpc_client
+{
+    using namespace log_system;
+    namespace rpc_stream_client
+    {
+        // 双向流调用
+        // 打开流的请求通过Requestor同步发送，接受帧作为响应返回；之后的帧直接交给流表
+        class StreamCaller
+        {
+        public:
+            using ptr = std::shared_ptr<StreamCaller>;
+
+            StreamCaller(const requestor_rpc_framework::Requestor::ptr &requestor)
+                : requestor_(requestor), streams_(std::make_shared<rpc_stream::StreamTable>())
+            {
+            }
+
+            // 打开双向流，recv_window表示服务端在收到额度前最多可以发送的数据帧个数
+            // timeout_ms为等待接受帧的最长时间，小于0时使用Requestor的默认超时时间
+            bool openStream(const base_connection::BaseConnection::ptr &con, const std::string &method_name, rpc_stream::RpcStream::ptr &stream,
+                            int recv_window = public_data::default_stream_window, int timeout_ms = public_data::default_stream_open_timeout)
+            {
+                // 1. 创建请求
+                auto open_req = message_factory::MessageFactory::messageCreateFactory<stream_message::StreamMessage>();
+                open_req->setId(uuid_generator::UuidGenerator::generate_uuid());
+                open_req->setMType(public_data::MType::Stream_frame);
+                open_req->setStreamOptype(public_data::StreamOptype::Stream_open);
+                open_req->setMethod(method_name);
+                open_req->setCredit(recv_window);
+                if (timeout_ms >= 0)
+                    open_req->setTimeout(timeout_ms);
+
+                // 2. 先创建流对象，服务端在接受帧之后立即发送的数据可以直接进入流中
+                rpc_stream::RpcStream::ptr new_stream = streams_->createStream(con, open_req->getReqRespId(), method_name, recv_window);
+                if (!new_stream)
+                    return false;
+
+                // 3. 同步等待接受帧
+                base_message::BaseMessage::ptr base_msg;
+                bool ret = requestor_->sendRequest(con, std::dynamic_pointer_cast<base_message::BaseMessage>(open_req), base_msg);
+                auto resp = std::dynamic_pointer_cast<stream_message::StreamMessage>(base_msg);
+                if (!ret || !resp || resp->getStreamOptype() != public_data::StreamOptype::Stream_accept ||
+                    resp->getRCode() != public_data::RCode::RCode_fine)
+                {
+                    // 超时或者连接断开时Requestor构造的是普通错误响应
+                    auto err_resp = std::dynamic_pointer_cast<json_message::JsonResponse>(base_msg);
+                    public_data::RCode rcode = resp ? resp->getRCode() : (err_resp ? err_resp->getRCode() : public_data::RCode::RCode_timeout);
+                    LOG(Level::Warning, "打开双向流：{} 失败，原因：{}", method_name, errReason(rcode));
+
+                    // 服务端拒绝时流已经不存在；超时时服务端可能已经接受，发送终止帧让服务端结束该流
+                    if (resp && resp->getStreamOptype() == public_data::StreamOptype::Stream_reset)
+                        streams_->removeStream(con, open_req->getReqRespId());
+                    else
+                        new_stream->reset(rcode == public_data::RCode::RCode_fine ? public_data::RCode::RCode_invalid_msg : rcode);
+                    return false;
+                }
+
+                stream = new_stream;
+                return true;
+            }
+
+            // 提供给Dispatcher模块的注册回调
+            void handleStreamMessage(const base_connection::BaseConnection::ptr &con, stream_message::StreamMessage::ptr &msg)
+            {
+                if (!msg->check())
+                {
+                    LOG(Level::Warning, "双向流帧格式错误");
+                    return;
+                }
+
+                // 接受帧和打开阶段的终止帧是打开请求的响应，交给Requestor
+                public_data::StreamOptype op = msg->getStreamOptype();
+                rpc_stream::RpcStream::ptr stream = streams_->findStream(con, msg->getReqRespId());
+                bool opening = stream && !stream->accepted();
+                if (op == public_data::StreamOptype::Stream_accept || (op == public_data::StreamOptype::Stream_reset && opening))
+                {
+                    if (op == public_data::StreamOptype::Stream_accept)
+                        streams_->dispatch(con, msg);
+
+                    base_message::BaseMessage::ptr base_msg = msg;
+                    requestor_->handleResponse(con, base_msg);
+                    return;
+                }
+
+                streams_->dispatch(con, msg);
+            }
+
+            // 连接断开时终止该连接上的所有流
+            void handleConnectionShutdown(const base_connection::BaseConnection::ptr &con)
+            {
+                streams_->handleConnectionShutdown(con);
+            }
+
+        private:
+            requestor_rpc_framework::Requestor::ptr requestor_;
+            rpc_stream::StreamTable::ptr streams_;
+        };
+    }
+}
+
+#endif
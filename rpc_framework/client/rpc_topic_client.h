@@ -5,7 +5,6 @@
 #include <rpc_framework/client/requestor.h>
 #include <rpc_framework/base/response_message.h>
 #include <rpc_framework/factories/message_factory.h>
-#include <rpc_framework/utils/uuid_generator.h>
 
 namespace rpc_client
 {
@@ -100,7 +99,7 @@ namespace rpc_client
             {
                 // 1. 构造出主题请求对象，并填充相关字段
                 auto topic_req = message_factory::MessageFactory::messageCreateFactory<request_message::TopicRequest>();
-                topic_req->setId(uuid_generator::UuidGenerator::generate_uuid());
+                topic_req->setId(requestor_->nextRequestId());
                 topic_req->setMType(public_data::MType::Req_topic);
                 topic_req->setTopicName(topic_name);
                 topic_req->setTopicOptype(topic_optype);
@@ -12,6 +12,15 @@ int main()
     // rpc_client::main_client::RpcClient client(false, "127.0.0.1", 8080);
     // 让客户端连接注册中心，再从注册中心获取到服务提供者
     rpc_client::main_client::RpcClient client(true, "127.0.0.1", 9090);
+    // add是只读方法，存在多个服务提供者时超过最近耗时的95分位仍未返回就向另一个提供者发送对冲请求
+    client.setHedgePolicy("add", rpc_client::hedging::HedgePolicy());
+    // add是幂等方法，连接断开、内部错误或者超时时最多尝试3次，重试优先发送给其他提供者
+    client.setRetryPolicy("add", rpc_client::retry::RetryPolicy());
+    // 按照耗时和未完成请求选择服务提供者，慢的提供者分到更少的请求
+    client.setLoadBalance("add", rpc_client::load_balance::Strategy::P2CEwma);
+    // 连续出错或者明显慢于其他提供者的提供者被临时隔离，隔离和恢复时打印事件
+    client.setOutlierPolicy("add", rpc_client::outlier::OutlierPolicy(), [](const rpc_client::outlier::OutlierEvent &event)
+                            { LOG(Level::Info, "异常检测事件：{}", event.toJson().toStyledString()); });
 
     // 同步处理
     std::string method = "add";
@@ -1,12 +1,250 @@
 #ifndef __rpc_message_factory_h__
 #define __rpc_message_factory_h__
 
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <cstddef>
+#include <algorithm>
 #include <rpc_framework/base/base_message.h>
 #include <rpc_framework/base/request_message.h>
 #include <rpc_framework/base/response_message.h>
+#include <rpc_framework/base/stream_message.h>
 
 namespace message_factory
 {
+    // 消息对象池
+    // 每种消息类型、每个线程各自维护一个空闲链表，获取和归还本线程的对象都不需要加锁
+    // 消息和shared_ptr的控制块放在同一个节点中，控制块通过节点的分配器构造在节点内部，命中时不需要分配内存
+    // 消息的引用计数归零时不释放空间，而是重置后放回空闲链表：
+    // 1. 由当前线程获取的消息放回当前线程的空闲链表
+    // 2. 由其他线程获取的消息（例如客户端在业务线程中创建、在IO线程中发送后释放的请求）放入有上限的共享链表
+    //    空闲链表为空的线程从共享链表中成批取回，避免对象在只释放不获取的线程中堆积
+    template <class T>
+    class MessagePool
+    {
+    public:
+        // 每个线程每种消息最多缓存的空闲对象个数
+        static constexpr size_t max_free_size = 1024;
+        // 共享链表中每种消息最多缓存的空闲对象个数
+        static constexpr size_t max_shared_size = 1024;
+        // 从共享链表中一次取回的对象个数
+        static constexpr size_t batch_size = 32;
+
+        // 从当前线程的空闲链表中获取消息，当前线程没有空闲消息时从共享链表中取回，都没有时再创建
+        static std::shared_ptr<T> acquire()
+        {
+            FreeList &list = freeList();
+            if (list.items_.empty())
+                refill(list);
+
+            Node *node = nullptr;
+            if (!list.items_.empty())
+            {
+                node = list.items_.back();
+                list.items_.pop_back();
+                list.hits_.fetch_add(1, std::memory_order_relaxed);
+            }
+            else
+            {
+                node = new Node();
+                list.misses_.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            node->owner = &list;
+            return std::shared_ptr<T>(&node->msg, Recycler(), NodeAllocator<T>(node));
+        }
+
+        // 获取所有线程的命中和未命中次数
+        static Json::Value stats()
+        {
+            std::unique_lock<std::mutex> lock(registry_mtx_);
+            uint64_t hits = retired_hits_, misses = retired_misses_;
+            for (FreeList *list : lists_)
+            {
+                hits += list->hits_.load(std::memory_order_relaxed);
+                misses += list->misses_.load(std::memory_order_relaxed);
+            }
+
+            Json::Value val;
+            val["hits"] = static_cast<Json::UInt64>(hits);
+            val["misses"] = static_cast<Json::UInt64>(misses);
+            return val;
+        }
+
+    private:
+        struct FreeList;
+
+        // 对象池节点：消息和shared_ptr控制块的空间
+        struct Node
+        {
+            T msg;
+            FreeList *owner = nullptr; // 获取该消息的线程的空闲链表，只用于比较，线程退出后不再访问
+            alignas(std::max_align_t) unsigned char block[64]; // 控制块的空间
+        };
+
+        // 引用计数归零时只重置消息，节点在控制块释放后才能复用
+        struct Recycler
+        {
+            void operator()(T *msg) const
+            {
+                msg->reset();
+            }
+        };
+
+        // 控制块的分配器，在节点内部构造控制块，释放控制块时归还节点
+        // 控制块大于节点中预留的空间时（不同的标准库实现）退回到普通的分配
+        template <class U>
+        struct NodeAllocator
+        {
+            using value_type = U;
+
+            Node *node;
+
+            explicit NodeAllocator(Node *n)
+                : node(n)
+            {
+            }
+
+            template <class V>
+            NodeAllocator(const NodeAllocator<V> &other)
+                : node(other.node)
+            {
+            }
+
+            U *allocate(size_t n)
+            {
+                if (n * sizeof(U) <= sizeof(node->block) && alignof(U) <= alignof(std::max_align_t))
+                    return reinterpret_cast<U *>(node->block);
+                return static_cast<U *>(::operator new(n * sizeof(U)));
+            }
+
+            // 分配器的副本在控制块析构前已经复制出来，可以在这里归还节点
+            void deallocate(U *p, size_t)
+            {
+                if (reinterpret_cast<unsigned char *>(p) != node->block)
+                    ::operator delete(p);
+                release(node);
+            }
+
+            template <class V>
+            bool operator==(const NodeAllocator<V> &other) const
+            {
+                return node == other.node;
+            }
+
+            template <class V>
+            bool operator!=(const NodeAllocator<V> &other) const
+            {
+                return node != other.node;
+            }
+        };
+
+        // 线程私有的空闲链表，创建时登记到全局列表中用于统计
+        struct FreeList
+        {
+            std::vector<Node *> items_;
+            std::atomic<uint64_t> hits_{0};
+            std::atomic<uint64_t> misses_{0};
+
+            FreeList()
+            {
+                std::unique_lock<std::mutex> lock(registry_mtx_);
+                lists_.push_back(this);
+            }
+
+            // 线程退出时释放所有空闲对象，并将统计数据合并到全局
+            ~FreeList()
+            {
+                closed() = true;
+                for (Node *node : items_)
+                    delete node;
+
+                std::unique_lock<std::mutex> lock(registry_mtx_);
+                retired_hits_ += hits_.load(std::memory_order_relaxed);
+                retired_misses_ += misses_.load(std::memory_order_relaxed);
+                for (auto it = lists_.begin(); it != lists_.end(); ++it)
+                {
+                    if (*it == this)
+                    {
+                        lists_.erase(it);
+                        break;
+                    }
+                }
+            }
+        };
+
+        // 所有线程共享的空闲链表
+        struct SharedList
+        {
+            std::mutex mtx;
+            std::vector<Node *> items;
+        };
+
+        // 归还节点，消息已经在引用计数归零时重置
+        static void release(Node *node)
+        {
+            // 线程正在退出时空闲链表已经销毁，直接放入共享链表
+            if (!closed())
+            {
+                FreeList &list = freeList();
+                if (node->owner == &list && list.items_.size() < max_free_size)
+                {
+                    list.items_.push_back(node);
+                    return;
+                }
+            }
+
+            SharedList &shared = sharedList();
+            {
+                std::unique_lock<std::mutex> lock(shared.mtx);
+                if (shared.items.size() < max_shared_size)
+                {
+                    shared.items.push_back(node);
+                    return;
+                }
+            }
+
+            delete node;
+        }
+
+        // 从共享链表中取回一批空闲对象
+        static void refill(FreeList &list)
+        {
+            SharedList &shared = sharedList();
+            std::unique_lock<std::mutex> lock(shared.mtx);
+            size_t count = std::min(batch_size, shared.items.size());
+            list.items_.insert(list.items_.end(), shared.items.end() - count, shared.items.end());
+            shared.items.resize(shared.items.size() - count);
+        }
+
+        static FreeList &freeList()
+        {
+            thread_local FreeList list;
+            return list;
+        }
+
+        // 空闲链表是否已经销毁，bool没有析构函数，线程退出过程中依旧可以访问
+        static bool &closed()
+        {
+            thread_local bool is_closed = false;
+            return is_closed;
+        }
+
+        // 共享链表不析构，程序退出过程中其他线程依旧可以归还对象
+        static SharedList &sharedList()
+        {
+            static SharedList *shared = new SharedList();
+            return *shared;
+        }
+
+    private:
+        static inline std::mutex registry_mtx_;    // 管理空闲链表列表的互斥锁
+        static inline std::vector<FreeList *> lists_; // 所有线程的空闲链表
+        static inline uint64_t retired_hits_ = 0;   // 已退出线程的命中次数
+        static inline uint64_t retired_misses_ = 0; // 已退出线程的未命中次数
+    };
+
     // BaseMessage工厂，用于统一构造BaseMessage子类对象
     class MessageFactory
     {
@@ -17,28 +255,59 @@ namespace message_factory
             switch (mtype)
             {
             case public_data::MType::Req_rpc:
-                return std::make_shared<request_message::RpcRequest>();
+                return MessagePool<request_message::RpcRequest>::acquire();
             case public_data::MType::Req_topic:
-                return std::make_shared<request_message::TopicRequest>();
+                return MessagePool<request_message::TopicRequest>::acquire();
             case public_data::MType::Req_service:
-                return std::make_shared<request_message::ServiceRequest>();
+                return MessagePool<request_message::ServiceRequest>::acquire();
             case public_data::MType::Resp_rpc:
-                return std::make_shared<response_message::RpcResponse>();
+                return MessagePool<response_message::RpcResponse>::acquire();
             case public_data::MType::Resp_topic:
-                return std::make_shared<response_message::TopicResponse>();
+                return MessagePool<response_message::TopicResponse>::acquire();
             case public_data::MType::Resp_service:
-                return std::make_shared<response_message::ServiceResponse>();
+                return MessagePool<response_message::ServiceResponse>::acquire();
+            case public_data::MType::Req_batch_rpc:
+                return MessagePool<request_message::BatchRpcRequest>::acquire();
+            case public_data::MType::Resp_batch_rpc:
+                return MessagePool<response_message::BatchRpcResponse>::acquire();
+            case public_data::MType::Resp_stream_rpc:
+                return MessagePool<response_message::RpcStreamResponse>::acquire();
+            case public_data::MType::Stream_frame:
+                return MessagePool<stream_message::StreamMessage>::acquire();
+            default:
+                break;
             }
             return base_message::BaseMessage::ptr(); // 相当于返回nullptr，即shared_ptr<base_message::BaseMessage>();
         }
 
         // 泛型版本
+        // 不带构造参数时从对象池中获取
         template<class T, class ...Args>
         static std::shared_ptr<T> messageCreateFactory(Args&& ...args)
         {
-            return std::make_shared<T>(std::forward<Args>(args)...);
+            if constexpr (sizeof...(Args) == 0)
+                return MessagePool<T>::acquire();
+            else
+                return std::make_shared<T>(std::forward<Args>(args)...);
+        }
+
+        // 获取各类消息对象池的命中统计
+        static Json::Value poolStats()
+        {
+            Json::Value stats;
+            stats["RpcRequest"] = MessagePool<request_message::RpcRequest>::stats();
+            stats["TopicRequest"] = MessagePool<request_message::TopicRequest>::stats();
+            stats["ServiceRequest"] = MessagePool<request_message::ServiceRequest>::stats();
+            stats["RpcResponse"] = MessagePool<response_message::RpcResponse>::stats();
+            stats["TopicResponse"] = MessagePool<response_message::TopicResponse>::stats();
+            stats["ServiceResponse"] = MessagePool<response_message::ServiceResponse>::stats();
+            stats["BatchRpcRequest"] = MessagePool<request_message::BatchRpcRequest>::stats();
+            stats["BatchRpcResponse"] = MessagePool<response_message::BatchRpcResponse>::stats();
+            stats["RpcStreamResponse"] = MessagePool<response_message::RpcStreamResponse>::stats();
+            stats["StreamMessage"] = MessagePool<stream_message::StreamMessage>::stats();
+            return stats;
         }
     };
 }
 
-#endif
\ No newline at end of file
+#endif
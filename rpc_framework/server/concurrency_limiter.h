@@ -0,0 +1,179 @@
+#ifndef __rpc_concurrency_limiter_h__
+#define __rpc_concurrency_limiter_h__
+
+#include <deque>
+#include <mutex>
+#include <cmath>
+#include <chrono>
+#include <memory>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include "jsoncpp/json/json.h"
+
+namespace rpc_server
+{
+    namespace concurrency_limiter
+    {
+        // 单个方法的并发限制
+        // 正在执行的调用个数达到上限时，新的调用进入等待队列；队列也满时拒绝，由调用者返回过载错误
+        // 每一次调用结束后必须调用release，释放的名额交给队列中最早的调用，在释放名额的线程中执行
+        // 开启自适应后，上限根据执行耗时调整：耗时接近无负载时的最小耗时则逐步放大，耗时增加则按比例缩小
+        class ConcurrencyLimiter
+        {
+        public:
+            using ptr = std::shared_ptr<ConcurrencyLimiter>;
+            using task_t = std::function<void()>;
+            using duration_t = std::chrono::steady_clock::duration;
+
+            // 固定上限：max_concurrency为最多同时执行的调用个数，max_queue为最多等待的调用个数
+            ConcurrencyLimiter(size_t max_concurrency, size_t max_queue)
+                : min_limit_(max_concurrency), max_limit_(max_concurrency), limit_(max_concurrency), max_queue_(max_queue)
+            {
+            }
+
+            // 自适应上限：上限在[min_limit, max_limit]之间调整，初始为min_limit
+            static ptr createAdaptive(size_t min_limit, size_t max_limit, size_t max_queue)
+            {
+                ptr limiter = std::make_shared<ConcurrencyLimiter>(std::max<size_t>(min_limit, 1), max_queue);
+                limiter->max_limit_ = std::max(max_limit, limiter->min_limit_);
+                limiter->adaptive_ = true;
+                return limiter;
+            }
+
+            // 提交一次调用：有空闲名额时在当前线程中立即执行，否则进入等待队列
+            // 队列已满时返回false，任务不会执行
+            bool submit(const task_t &task)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(mtx_);
+                    // 已经有调用在排队时同样排队，保证先到先执行
+                    if (running_ >= currentLimit() || !queue_.empty())
+                    {
+                        if (queue_.size() >= max_queue_)
+                        {
+                            rejected_++;
+                            return false;
+                        }
+
+                        queue_.push_back(task);
+                        return true;
+                    }
+                    running_++;
+                }
+
+                task();
+                return true;
+            }
+
+            // 一次调用结束，latency为调用的执行耗时（不包含排队时间），小于0表示没有执行，不参与上限调整
+            // 释放名额后在当前线程中依次执行队列中可以开始的调用
+            // 同一时刻只有一个线程负责执行队列中的调用，其他线程只释放名额，避免排队的同步调用递归调用release
+            void release(duration_t latency)
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                running_--;
+                if (adaptive_ && latency >= duration_t::zero())
+                    updateLimit(latency);
+                if (draining_)
+                    return;
+
+                draining_ = true;
+                task_t next;
+                while (popNext(next))
+                {
+                    lock.unlock();
+                    next();
+                    next = nullptr;
+                    lock.lock();
+                }
+                draining_ = false;
+            }
+
+            // 获取统计信息：{limit, running, queued, rejected}
+            Json::Value stats()
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                Json::Value result;
+                result["limit"] = static_cast<Json::UInt64>(currentLimit());
+                result["running"] = static_cast<Json::UInt64>(running_);
+                result["queued"] = static_cast<Json::UInt64>(queue_.size());
+                result["rejected"] = static_cast<Json::UInt64>(rejected_);
+                if (adaptive_)
+                    result["min_latency_us"] = min_latency_us_;
+                return result;
+            }
+
+        private:
+            // 每个采样窗口包含的调用个数，窗口结束时调整一次上限
+            static const size_t window_size = 32;
+            // 经过多少个窗口后重新测量最小耗时，适应服务本身耗时的变化
+            static const size_t probe_windows = 100;
+
+            size_t currentLimit() const
+            {
+                return static_cast<size_t>(limit_);
+            }
+
+            // 调用者需要持有锁
+            bool popNext(task_t &next)
+            {
+                if (queue_.empty() || running_ >= currentLimit())
+                    return false;
+
+                next = std::move(queue_.front());
+                queue_.pop_front();
+                running_++;
+                return true;
+            }
+
+            // 梯度算法：gradient = 最小耗时 / 窗口平均耗时，限制在[0.5, 1]之间
+            // 新上限 = 当前上限 * gradient + sqrt(当前上限)，平方根部分允许少量排队以探测更高的上限
+            // 调用者需要持有锁
+            void updateLimit(duration_t latency)
+            {
+                window_sum_us_ += std::chrono::duration<double, std::micro>(latency).count();
+                if (++window_count_ < window_size)
+                    return;
+
+                double avg = window_sum_us_ / window_count_;
+                window_sum_us_ = 0;
+                window_count_ = 0;
+                if (++windows_ >= probe_windows || min_latency_us_ <= 0 || avg < min_latency_us_)
+                {
+                    if (windows_ >= probe_windows)
+                        windows_ = 0;
+                    min_latency_us_ = avg;
+                }
+
+                // 允许耗时有一定的波动
+                const double tolerance = 1.5;
+                double gradient = std::max(0.5, std::min(1.0, tolerance * min_latency_us_ / std::max(avg, 1.0)));
+                double new_limit = limit_ * gradient + std::sqrt(limit_);
+                // 平滑调整，避免上限剧烈抖动
+                limit_ = limit_ * 0.8 + new_limit * 0.2;
+                limit_ = std::max(static_cast<double>(min_limit_), std::min(static_cast<double>(max_limit_), limit_));
+            }
+
+        private:
+            size_t min_limit_;       // 上限的最小值
+            size_t max_limit_;       // 上限的最大值
+            double limit_;           // 当前上限，固定上限时不变
+            size_t max_queue_;       // 等待队列的最大长度
+            bool adaptive_ = false;  // 是否根据耗时调整上限
+
+            std::mutex mtx_;
+            size_t running_ = 0;        // 正在执行的调用个数
+            bool draining_ = false;     // 是否有线程正在执行队列中的调用
+            std::deque<task_t> queue_;  // 等待执行的调用
+            uint64_t rejected_ = 0;     // 因为过载被拒绝的调用个数
+
+            double window_sum_us_ = 0;  // 当前窗口的耗时之和（微秒）
+            size_t window_count_ = 0;   // 当前窗口的调用个数
+            size_t windows_ = 0;        // 距离上一次重新测量最小耗时经过的窗口个数
+            double min_latency_us_ = 0; // 无负载时的最小耗时（微秒），使用窗口平均值估计
+        };
+    }
+}
+
+#endif
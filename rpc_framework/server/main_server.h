@@ -7,6 +7,7 @@
 #include <rpc_framework/client/main_client.h>
 #include <rpc_framework/server/rpc_router.h>
 #include <rpc_framework/server/rpc_topic_server.h>
+#include <rpc_framework/server/rpc_stream_server.h>
 
 namespace rpc_server
 {
@@ -58,12 +59,15 @@ namespace rpc_server
             // 是否需要启用服务注册功能取决于isToRegistry是否为true
             RpcServer(const public_data::host_addr_t &host_addr, bool isToRegistry = false, const public_data::host_addr_t &registry_addr = public_data::host_addr_t())
                 : rpc_router_(std::make_shared<rpc_router::RpcRouter>()),
+                  stream_router_(std::make_shared<rpc_stream_server::StreamRouter>()),
                   dispatcher_(std::make_shared<dispatcher_rpc_framework::Dispatcher>()),
                   isToRegistry_(isToRegistry),
                   host_addr_(host_addr)
             {
                 // 向dispatcher模块注册rpc处理函数
                 dispatcher_->registerService<request_message::RpcRequest>(public_data::MType::Req_rpc, std::bind(&rpc_router::RpcRouter::handleRpcRequest, rpc_router_.get(), std::placeholders::_1, std::placeholders::_2));
+                dispatcher_->registerService<request_message::BatchRpcRequest>(public_data::MType::Req_batch_rpc, std::bind(&rpc_router::RpcRouter::handleBatchRpcRequest, rpc_router_.get(), std::placeholders::_1, std::placeholders::_2));
+                dispatcher_->registerService<stream_message::StreamMessage>(public_data::MType::Stream_frame, std::bind(&rpc_stream_server::StreamRouter::handleStreamMessage, stream_router_.get(), std::placeholders::_1, std::placeholders::_2));
 
                 // 判断是否启用服务注册决定是否初始化服务注册客户端
                 if (isToRegistry_)
@@ -73,6 +77,8 @@ namespace rpc_server
                 server_ = server_factory::ServerFactory::serverCreateFactory(host_addr.second);
                 // 注册服务端的回调函数，由dispatcher提供
                 server_->setMessageCallback(std::bind(&dispatcher_rpc_framework::Dispatcher::executeService, dispatcher_.get(), std::placeholders::_1, std::placeholders::_2));
+                // 连接断开时终止该连接上的双向流
+                server_->setCloseCallback(std::bind(&rpc_stream_server::StreamRouter::handleConnectionShutdown, stream_router_.get(), std::placeholders::_1));
             }
 
             void start()
@@ -80,6 +86,15 @@ namespace rpc_server
                 server_->start();
             }
 
+            // 用于注册可以提供的双向流服务
+            void registryStream(const std::string &method, const rpc_stream_server::stream_accept_t &handler)
+            {
+                if (isToRegistry_)
+                    reg_client_->toRegisterService(method, host_addr_);
+
+                stream_router_->registerStream(method, handler);
+            }
+
             // 用于注册可以提供的服务
             void registryService(const rpc_router::ServiceDesc::ptr &s)
             {
@@ -91,10 +106,47 @@ namespace rpc_server
                 rpc_router_->registerService(s);
             }
 
+            // 删除方法的所有缓存结果
+            bool invalidateCache(const std::string &method)
+            {
+                return rpc_router_->invalidateCache(method);
+            }
+
+            // 删除方法在指定参数下的缓存结果
+            bool invalidateCache(const std::string &method, const Json::Value &params)
+            {
+                return rpc_router_->invalidateCache(method, params);
+            }
+
+            // 获取并发限制的统计信息
+            Json::Value limiterStats()
+            {
+                return rpc_router_->limiterStats();
+            }
+
+            // 获取服务端的统计信息，与内置的统计服务返回的结果相同
+            Json::Value stats()
+            {
+                return rpc_router_->stats();
+            }
+
+            // 获取相同请求合并的统计信息
+            Json::Value singleflightStats()
+            {
+                return rpc_router_->singleflightStats();
+            }
+
+            // 获取结果缓存的统计信息
+            Json::Value cacheStats()
+            {
+                return rpc_router_->cacheStats();
+            }
+
         private:
             bool isToRegistry_;                                       // 是否启用服务注册
             rpc_client::main_client::RegisterClient::ptr reg_client_; // 用于服务注册的客户端
             rpc_router::RpcRouter::ptr rpc_router_;                   // 用于处理RPC服务
+            rpc_stream_server::StreamRouter::ptr stream_router_;      // 用于处理双向流服务
             dispatcher_rpc_framework::Dispatcher::ptr dispatcher_;
             base_server::BaseServer::ptr server_; // 用于处理rpc服务的服务端
             public_data::host_addr_t host_addr_;  // 提供rpc服务的服务端信息
@@ -0,0 +1,295 @@
+#ifndef __rpc_method_stats_h__
+#define __rpc_method_stats_h__
+
+#include <array>
+#include <mutex>
+#include <chrono>
+#include <atomic>
+#include <memory>
+#include <deque>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include "jsoncpp/json/json.h"
+#include <rpc_framework/base/public_data.h>
+
+namespace rpc_server
+{
+    namespace method_stats
+    {
+        // 耗时分布的统计阶段
+        enum class Stage
+        {
+            Stage_queue = 0, // 从收到请求到开始执行业务回调（包括并发限制中的排队时间）
+            Stage_handler,   // 业务回调的执行时间，异步服务为从调用回调到应答
+            Stage_encode,    // 构建并发送响应
+            Stage_count      // 阶段个数，不是合法的阶段
+        };
+
+        // 对数线性分桶的耗时分布（微秒）
+        // 每个2的幂区间再均分为8个桶，相对误差不超过12.5%，最大约2^40微秒
+        class Histogram
+        {
+        public:
+            static const size_t sub_bits = 3;
+            static const size_t sub_count = 1 << sub_bits;
+            static const size_t max_exponent = 40;
+            static const size_t bucket_count = (max_exponent - sub_bits + 1) * sub_count;
+
+            // 计算数值所在的桶
+            static size_t bucketIndex(uint64_t v)
+            {
+                if (v < sub_count)
+                    return static_cast<size_t>(v);
+
+                size_t e = 63 - __builtin_clzll(v);
+                if (e >= max_exponent)
+                    return bucket_count - 1;
+
+                size_t sub = static_cast<size_t>(v >> (e - sub_bits)) & (sub_count - 1);
+                return (e - sub_bits + 1) * sub_count + sub;
+            }
+
+            // 桶的上界（不包含），作为该桶中数值的估计
+            static uint64_t bucketUpper(size_t index)
+            {
+                if (index < sub_count)
+                    return index + 1;
+
+                size_t e = index / sub_count + sub_bits - 1;
+                uint64_t sub = index % sub_count;
+                return (sub_count + sub + 1) << (e - sub_bits);
+            }
+
+            Histogram()
+            {
+                buckets_.fill(0);
+            }
+
+            // 合并其他线程记录的计数
+            void merge(const std::array<std::atomic<uint64_t>, bucket_count> &buckets, uint64_t sum, uint64_t max)
+            {
+                for (size_t i = 0; i < bucket_count; i++)
+                {
+                    uint64_t n = buckets[i].load(std::memory_order_relaxed);
+                    buckets_[i] += n;
+                    count_ += n;
+                }
+                sum_ += sum;
+                max_ = std::max(max_, max);
+            }
+
+            // 获取分位数，q在[0, 1]之间
+            uint64_t percentile(double q) const
+            {
+                if (count_ == 0)
+                    return 0;
+
+                uint64_t target = static_cast<uint64_t>(q * count_);
+                if (target >= count_)
+                    target = count_ - 1;
+                uint64_t seen = 0;
+                for (size_t i = 0; i < bucket_count; i++)
+                {
+                    seen += buckets_[i];
+                    if (seen > target)
+                        return std::min(bucketUpper(i), max_);
+                }
+
+                return max_;
+            }
+
+            // 转换为{count, mean, p50, p90, p99, p999, max}
+            Json::Value toJson() const
+            {
+                Json::Value result;
+                result["count"] = static_cast<Json::UInt64>(count_);
+                result["mean"] = count_ == 0 ? 0.0 : static_cast<double>(sum_) / count_;
+                result["p50"] = static_cast<Json::UInt64>(percentile(0.5));
+                result["p90"] = static_cast<Json::UInt64>(percentile(0.9));
+                result["p99"] = static_cast<Json::UInt64>(percentile(0.99));
+                result["p999"] = static_cast<Json::UInt64>(percentile(0.999));
+                result["max"] = static_cast<Json::UInt64>(max_);
+                return result;
+            }
+
+        private:
+            std::array<uint64_t, bucket_count> buckets_;
+            uint64_t count_ = 0;
+            uint64_t sum_ = 0;
+            uint64_t max_ = 0;
+        };
+
+        // 单个方法的调用统计
+        // 每个线程记录到自己的分片中，分片只有所属线程写入，记录时不加锁也不需要原子的读改写
+        // 读取统计时加锁遍历所有分片并合并，读到的是近似一致的结果
+        class MethodStats
+        {
+        public:
+            using ptr = std::shared_ptr<MethodStats>;
+            using duration_t = std::chrono::steady_clock::duration;
+
+            MethodStats()
+                : slot_(nextSlot()), created_(std::chrono::steady_clock::now())
+            {
+                samples_.push_back({created_, 0});
+            }
+
+            MethodStats(const MethodStats &) = delete;
+            MethodStats &operator=(const MethodStats &) = delete;
+
+            // 记录一个阶段的耗时
+            void record(Stage stage, duration_t elapsed)
+            {
+                int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+                localShard().record(stage, us < 0 ? 0 : static_cast<uint64_t>(us));
+            }
+
+            // 记录一次调用的结果，每一次调用只记录一次
+            void recordResult(public_data::RCode rcode)
+            {
+                localShard().recordResult(rcode);
+            }
+
+            // 获取统计信息
+            // {calls, uptime_ms, qps, rcodes: {错误原因: 次数}, queue_us, handler_us, encode_us}
+            // calls只增不减，监控可以用两次读取的calls和uptime_ms之差自行计算任意区间的速率
+            // qps为最近约qps_window_s秒的平均值，读取不会重置任何计数，多个读取者互不影响
+            Json::Value stats()
+            {
+                std::array<uint64_t, rcode_count> rcodes{};
+                std::array<Histogram, stage_count> stages;
+                std::unique_lock<std::mutex> lock(shards_mtx_);
+                for (const auto &shard : shards_)
+                {
+                    for (size_t i = 0; i < rcode_count; i++)
+                        rcodes[i] += shard->rcodes[i].load(std::memory_order_relaxed);
+                    for (size_t i = 0; i < stage_count; i++)
+                        shard->mergeInto(i, stages[i]);
+                }
+
+                uint64_t calls = 0;
+                Json::Value result;
+                Json::Value rcode_val(Json::objectValue);
+                for (size_t i = 0; i < rcode_count; i++)
+                {
+                    calls += rcodes[i];
+                    if (rcodes[i] > 0)
+                        rcode_val[public_data::errReason(static_cast<public_data::RCode>(i))] = static_cast<Json::UInt64>(rcodes[i]);
+                }
+
+                auto now = std::chrono::steady_clock::now();
+                result["calls"] = static_cast<Json::UInt64>(calls);
+                result["uptime_ms"] = static_cast<Json::UInt64>(std::chrono::duration_cast<std::chrono::milliseconds>(now - created_).count());
+                result["qps"] = windowQps(now, calls);
+
+                result["rcodes"] = rcode_val;
+                result["queue_us"] = stages[static_cast<size_t>(Stage::Stage_queue)].toJson();
+                result["handler_us"] = stages[static_cast<size_t>(Stage::Stage_handler)].toJson();
+                result["encode_us"] = stages[static_cast<size_t>(Stage::Stage_encode)].toJson();
+                return result;
+            }
+
+        private:
+            // 计算qps的窗口（秒）
+            static constexpr int qps_window_s = 10;
+
+            // 某一时刻的累计调用次数
+            struct Sample
+            {
+                std::chrono::steady_clock::time_point time;
+                uint64_t calls;
+            };
+
+            static const size_t rcode_count = static_cast<size_t>(public_data::RCode::RCode_count);
+            static const size_t stage_count = static_cast<size_t>(Stage::Stage_count);
+
+            // 线程私有的分片
+            // 计数器使用原子变量只是为了读取线程能够安全地读到值，写入只有所属线程，使用普通的加载和存储
+            struct Shard
+            {
+                std::array<std::atomic<uint64_t>, rcode_count> rcodes{};
+                std::array<std::array<std::atomic<uint64_t>, Histogram::bucket_count>, stage_count> buckets{};
+                std::array<std::atomic<uint64_t>, stage_count> sums{};
+                std::array<std::atomic<uint64_t>, stage_count> maxs{};
+
+                static void bump(std::atomic<uint64_t> &counter, uint64_t v)
+                {
+                    counter.store(counter.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+                }
+
+                void record(Stage stage, uint64_t us)
+                {
+                    size_t s = static_cast<size_t>(stage);
+                    bump(buckets[s][Histogram::bucketIndex(us)], 1);
+                    bump(sums[s], us);
+                    if (us > maxs[s].load(std::memory_order_relaxed))
+                        maxs[s].store(us, std::memory_order_relaxed);
+                }
+
+                void recordResult(public_data::RCode rcode)
+                {
+                    size_t r = static_cast<size_t>(rcode);
+                    if (r < rcode_count)
+                        bump(rcodes[r], 1);
+                }
+
+                // 合并到读取线程的分布中，调用者需要持有分片列表的锁
+                void mergeInto(size_t s, Histogram &hist) const
+                {
+                    hist.merge(buckets[s], sums[s].load(std::memory_order_relaxed), maxs[s].load(std::memory_order_relaxed));
+                }
+            };
+
+            // 获取当前线程在该方法上的分片，第一次记录时创建
+            // 线程私有的数组以方法编号为下标，编号全局递增不复用，已经销毁的方法对应的位置不会再被访问
+            Shard &localShard()
+            {
+                thread_local std::vector<Shard *> local;
+                if (slot_ >= local.size())
+                    local.resize(slot_ + 1, nullptr);
+                if (!local[slot_])
+                {
+                    std::unique_lock<std::mutex> lock(shards_mtx_);
+                    shards_.push_back(std::make_unique<Shard>());
+                    local[slot_] = shards_.back().get();
+                }
+
+                return *local[slot_];
+            }
+
+            // 计算最近一个窗口内的平均qps，调用者需要持有分片列表的锁
+            // 读取时最多每秒记录一次调用次数，保留覆盖窗口所需的最少记录，窗口起点为不晚于now - qps_window_s的最后一条记录
+            // 读取间隔超过窗口时，起点为上一次记录的时间
+            double windowQps(std::chrono::steady_clock::time_point now, uint64_t calls)
+            {
+                auto window_start = now - std::chrono::seconds(qps_window_s);
+                while (samples_.size() >= 2 && samples_[1].time <= window_start)
+                    samples_.pop_front();
+
+                const Sample &base = samples_.front();
+                double seconds = std::chrono::duration<double>(now - base.time).count();
+                double qps = seconds > 0 ? (calls - base.calls) / seconds : 0.0;
+
+                if (now - samples_.back().time >= std::chrono::seconds(1))
+                    samples_.push_back({now, calls});
+                return qps;
+            }
+
+            static size_t nextSlot()
+            {
+                static std::atomic<size_t> next_slot{0};
+                return next_slot.fetch_add(1, std::memory_order_relaxed);
+            }
+
+        private:
+            const size_t slot_;                         // 全局唯一的统计编号，用于定位线程私有的分片
+            std::mutex shards_mtx_;                     // 保护分片列表和调用次数记录
+            std::vector<std::unique_ptr<Shard>> shards_; // 所有线程的分片，随统计对象一起销毁
+            const std::chrono::steady_clock::time_point created_; // 统计对象创建的时间
+            std::deque<Sample> samples_;                // 读取时记录的调用次数，用于计算窗口内的qps
+        };
+    }
+}
+
+#endif
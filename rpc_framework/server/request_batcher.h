@@ -0,0 +1,194 @@
+#ifndef __rpc_request_batcher_h__
+#define __rpc_request_batcher_h__
+
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <exception>
+#include <algorithm>
+#include <functional>
+#include <condition_variable>
+#include "jsoncpp/json/json.h"
+#include <rpc_framework/base/public_data.h>
+#include <rpc_framework/base/log.h>
+
+namespace rpc_server
+{
+    using namespace log_system;
+    namespace request_batcher
+    {
+        // 批量业务回调函数类型：一次接收多组参数，按相同的顺序返回同样个数的结果
+        using batch_handler_t = std::function<void(const std::vector<Json::Value> &, std::vector<Json::Value> &)>;
+
+        // 请求聚合器
+        // 同一个方法的请求先放入队列，由聚合线程收集：第一个请求到达后最多等待一个时间窗口，
+        // 或者收集到最大批量后立即调用一次批量业务回调，再把结果分别交给每一个请求
+        // 超过最大批量时剩余的请求已经等待过，处理完当前批量后立即处理，不再等待新的时间窗口
+        class RequestBatcher
+        {
+        public:
+            using ptr = std::shared_ptr<RequestBatcher>;
+            // 单个请求的结果回调
+            using finish_t = std::function<void(public_data::RCode, const Json::Value &)>;
+
+            RequestBatcher(const batch_handler_t &handler, size_t max_batch, std::chrono::microseconds window)
+                : state_(std::make_shared<State>())
+            {
+                state_->handler = handler;
+                state_->max_batch = max_batch == 0 ? 1 : max_batch;
+                state_->window = window;
+                thread_ = std::thread(&RequestBatcher::run, state_);
+            }
+
+            ~RequestBatcher()
+            {
+                {
+                    std::unique_lock<std::mutex> lock(state_->mtx);
+                    state_->stop = true;
+                }
+                state_->cond.notify_all();
+
+                // 结果回调中释放了最后一个引用时，析构发生在聚合线程中，不能等待自己
+                // 聚合线程持有共享状态，分离后可以继续安全地退出
+                if (thread_.get_id() == std::this_thread::get_id())
+                    thread_.detach();
+                else
+                    thread_.join();
+            }
+
+            RequestBatcher(const RequestBatcher &) = delete;
+            RequestBatcher &operator=(const RequestBatcher &) = delete;
+
+            // 添加一个请求，结果在聚合线程中通过done返回
+            void add(const Json::Value &params, const finish_t &done)
+            {
+                bool notify = false;
+                {
+                    std::unique_lock<std::mutex> lock(state_->mtx);
+                    state_->pending.push_back(Item{params, done});
+                    // 队列由空变为非空时开始计时，达到最大批量时提前处理
+                    notify = state_->pending.size() == 1 || state_->pending.size() >= state_->max_batch;
+                }
+
+                if (notify)
+                    state_->cond.notify_one();
+            }
+
+            // 获取统计信息：{batches, items}
+            Json::Value stats()
+            {
+                std::unique_lock<std::mutex> lock(state_->mtx);
+                Json::Value result;
+                result["batches"] = static_cast<Json::UInt64>(state_->batches);
+                result["items"] = static_cast<Json::UInt64>(state_->items);
+                return result;
+            }
+
+        private:
+            struct Item
+            {
+                Json::Value params;
+                finish_t done;
+            };
+
+            // 聚合线程与聚合器共享的状态
+            struct State
+            {
+                batch_handler_t handler;          // 批量业务回调
+                size_t max_batch = 1;             // 一次最多处理的请求个数
+                std::chrono::microseconds window; // 第一个请求到达后最多等待的时间
+
+                std::mutex mtx;
+                std::condition_variable cond;
+                std::vector<Item> pending; // 等待处理的请求
+                bool stop = false;
+                uint64_t batches = 0; // 调用批量业务回调的次数
+                uint64_t items = 0;   // 处理的请求个数
+            };
+
+            static void run(std::shared_ptr<State> state)
+            {
+                std::unique_lock<std::mutex> lock(state->mtx);
+                bool flush = false; // 上一批之后是否还有剩余的请求
+                while (true)
+                {
+                    state->cond.wait(lock, [&state]()
+                                     { return state->stop || !state->pending.empty(); });
+                    // 停止时依旧处理已经收到的请求，保证每一个请求都有结果
+                    if (state->pending.empty())
+                        return;
+
+                    // 等待时间窗口结束或者收集到最大批量
+                    if (!flush)
+                    {
+                        auto deadline = std::chrono::steady_clock::now() + state->window;
+                        state->cond.wait_until(lock, deadline, [&state]()
+                                               { return state->stop || state->pending.size() >= state->max_batch; });
+                    }
+
+                    size_t count = std::min(state->pending.size(), state->max_batch);
+                    std::vector<Item> batch;
+                    batch.reserve(count);
+                    for (size_t i = 0; i < count; i++)
+                        batch.push_back(std::move(state->pending[i]));
+                    state->pending.erase(state->pending.begin(), state->pending.begin() + count);
+                    flush = !state->pending.empty();
+                    state->batches++;
+                    state->items += count;
+
+                    lock.unlock();
+                    process(state->handler, batch);
+                    lock.lock();
+                }
+            }
+
+            // 调用批量业务回调，结果个数不一致或者抛出异常时所有请求返回内部错误
+            static void process(const batch_handler_t &handler, std::vector<Item> &batch)
+            {
+                std::vector<Json::Value> params;
+                params.reserve(batch.size());
+                for (auto &item : batch)
+                    params.push_back(std::move(item.params));
+
+                std::vector<Json::Value> results;
+                bool ok = true;
+                try
+                {
+                    handler(params, results);
+                }
+                catch (const std::exception &e)
+                {
+                    LOG(Level::Warning, "批量业务回调异常：{}", e.what());
+                    ok = false;
+                }
+                catch (...)
+                {
+                    LOG(Level::Warning, "批量业务回调抛出未知异常");
+                    ok = false;
+                }
+
+                if (ok && results.size() != batch.size())
+                {
+                    LOG(Level::Warning, "批量业务回调结果个数错误：{}，参数个数：{}", results.size(), batch.size());
+                    ok = false;
+                }
+
+                for (size_t i = 0; i < batch.size(); i++)
+                {
+                    if (ok)
+                        batch[i].done(public_data::RCode::RCode_fine, results[i]);
+                    else
+                        batch[i].done(public_data::RCode::RCode_internal_error, Json::Value());
+                }
+            }
+
+        private:
+            std::shared_ptr<State> state_;
+            std::thread thread_; // 聚合线程
+        };
+    }
+}
+
+#endif
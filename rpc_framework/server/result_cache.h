@@ -0,0 +1,164 @@
+#ifndef __rpc_result_cache_h__
+#define __rpc_result_cache_h__
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <chrono>
+#include <memory>
+#include <cstdint>
+#include <unordered_map>
+#include "jsoncpp/json/json.h"
+#include <rpc_framework/utils/JsonUtil.h>
+
+namespace rpc_server
+{
+    namespace result_cache
+    {
+        // 单个方法的结果缓存
+        // 以规范化后的参数文本作为键，保存调用结果，超过有效期的结果视为不存在
+        // 条目个数或者占用字节数超过上限时淘汰最久未使用的条目
+        // ! 只适用于结果只由参数决定的幂等方法
+        class ResultCache
+        {
+        public:
+            using ptr = std::shared_ptr<ResultCache>;
+
+            // ttl_ms：结果有效期（毫秒），max_entries：最多缓存的条目个数，max_bytes：最多占用的字节数，0表示不限制
+            ResultCache(int ttl_ms, size_t max_entries, size_t max_bytes = 0)
+                : ttl_(std::chrono::milliseconds(ttl_ms)), max_entries_(max_entries), max_bytes_(max_bytes)
+            {
+            }
+
+            // 生成缓存键：规范化后的参数文本
+            static std::string makeKey(const Json::Value &params)
+            {
+                return json_util::JsonUtil::canonicalize(params);
+            }
+
+            // 查找结果，命中时更新为最近使用
+            bool get(const std::string &key, Json::Value &result)
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                auto pos = index_.find(key);
+                if (pos == index_.end())
+                {
+                    misses_++;
+                    return false;
+                }
+
+                // 过期条目直接删除
+                if (pos->second->expire <= std::chrono::steady_clock::now())
+                {
+                    eraseEntry(pos->second);
+                    misses_++;
+                    return false;
+                }
+
+                lru_.splice(lru_.begin(), lru_, pos->second);
+                result = pos->second->result;
+                hits_++;
+                return true;
+            }
+
+            // 保存结果，已经存在时覆盖
+            void put(const std::string &key, const Json::Value &result)
+            {
+                if (max_entries_ == 0)
+                    return;
+
+                size_t bytes = entryBytes(key, result);
+                std::unique_lock<std::mutex> lock(mtx_);
+                auto pos = index_.find(key);
+                if (pos != index_.end())
+                    eraseEntry(pos->second);
+
+                lru_.push_front(Entry{key, result, std::chrono::steady_clock::now() + ttl_, bytes});
+                index_[key] = lru_.begin();
+                bytes_ += bytes;
+
+                // 超过上限时从最久未使用的一端淘汰，刚插入的条目至少保留
+                while (lru_.size() > 1 && (lru_.size() > max_entries_ || (max_bytes_ > 0 && bytes_ > max_bytes_)))
+                {
+                    eraseEntry(std::prev(lru_.end()));
+                    evictions_++;
+                }
+            }
+
+            // 删除指定参数对应的结果
+            bool invalidate(const std::string &key)
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                auto pos = index_.find(key);
+                if (pos == index_.end())
+                    return false;
+
+                eraseEntry(pos->second);
+                return true;
+            }
+
+            // 删除所有结果
+            void clear()
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                lru_.clear();
+                index_.clear();
+                bytes_ = 0;
+            }
+
+            // 获取统计信息：{hits, misses, hit_ratio, entries, bytes, evictions}
+            // 字节数为键和序列化后结果的长度之和，用于估计占用的内存
+            Json::Value stats()
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                Json::Value result;
+                result["hits"] = static_cast<Json::UInt64>(hits_);
+                result["misses"] = static_cast<Json::UInt64>(misses_);
+                uint64_t total = hits_ + misses_;
+                result["hit_ratio"] = total == 0 ? 0.0 : static_cast<double>(hits_) / total;
+                result["entries"] = static_cast<Json::UInt64>(lru_.size());
+                result["bytes"] = static_cast<Json::UInt64>(bytes_);
+                result["evictions"] = static_cast<Json::UInt64>(evictions_);
+                return result;
+            }
+
+        private:
+            struct Entry
+            {
+                std::string key;
+                Json::Value result;
+                std::chrono::steady_clock::time_point expire; // 过期时间
+                size_t bytes;                                 // 估计占用的字节数
+            };
+            using entry_iter_t = std::list<Entry>::iterator;
+
+            static size_t entryBytes(const std::string &key, const Json::Value &result)
+            {
+                return key.size() + makeKey(result).size();
+            }
+
+            // 调用者需要持有锁
+            void eraseEntry(entry_iter_t it)
+            {
+                bytes_ -= it->bytes;
+                index_.erase(it->key);
+                lru_.erase(it);
+            }
+
+        private:
+            std::chrono::steady_clock::duration ttl_; // 结果有效期
+            size_t max_entries_;                      // 条目个数上限
+            size_t max_bytes_;                        // 字节数上限，0表示不限制
+
+            std::mutex mtx_;
+            std::list<Entry> lru_;                                  // 按使用时间排序，头部为最近使用
+            std::unordered_map<std::string, entry_iter_t> index_;   // 缓存键与条目的映射
+            size_t bytes_ = 0;                                      // 当前占用的字节数
+            uint64_t hits_ = 0;                                     // 命中次数
+            uint64_t misses_ = 0;                                   // 未命中次数
+            uint64_t evictions_ = 0;                                // 因为超过上限被淘汰的条目个数
+        };
+    }
+}
+
+#endif
@@ -10,6 +10,7 @@
 #include <rpc_framework/base/request_message.h>
 #include <rpc_framework/base/base_connection.h>
 #include <rpc_framework/factories/message_factory.h>
+#include <rpc_framework/factories/protocol_factory.h>
 #include <rpc_framework/utils/uuid_generator.h>
 
 namespace rpc_server
@@ -170,6 +171,11 @@ namespace rpc_server
         public:
             using ptr = std::shared_ptr<ServiceDiscovererManager>;
 
+            ServiceDiscovererManager()
+                : pro_(protocol_factory::ProtocolFactory::createProtocolFactory())
+            {
+            }
+
             // 添加发现者
             void insertDiscoverer(const base_connection::BaseConnection::ptr &con, const std::string &method)
             {
@@ -250,12 +256,16 @@ namespace rpc_server
                 service_msg->setMethod(method);
                 service_msg->setHost(addr);
                 service_msg->setServiceOptype(op);
+                service_msg->setMType(public_data::MType::Req_service);
 
+                // 只编码一次，再发送给所有发现者
+                base_connection::BaseConnection::frame_t frame = pro_->constructFrame(service_msg);
                 for (auto &d : pos->second)
-                    d->con_->send(service_msg);
+                    d->con_->sendFrame(frame);
             }
 
         private:
+            base_protocol::BaseProtocol::ptr pro_; // 用于对通知消息进行一次性编码
             std::mutex discover_mtx_;             // 用于提供者管理的线程安全
             std::unordered_map<std::string, std::set<ServiceDiscoverer::ptr>> discovers_;                   // 发现指定服务的所有客户端
             std::unordered_map<base_connection::BaseConnection::ptr, ServiceDiscoverer::ptr> con_discoverer_; // 管理连接和发现者
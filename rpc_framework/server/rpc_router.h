@@ -4,11 +4,22 @@
 #include <string>
 #include <vector>
 #include <functional>
+#include <cstring>
+#include <atomic>
+#include <optional>
 #include <rpc_framework/base/base_connection.h>
+#include <rpc_framework/base/call_context.h>
 #include <rpc_framework/base/request_message.h>
 #include <rpc_framework/base/response_message.h>
 #include <rpc_framework/factories/message_factory.h>
 #include <rpc_framework/base/log.h>
+#include <rpc_framework/utils/rcu_snapshot.h>
+#include <rpc_framework/utils/coroutine_task.h>
+#include <rpc_framework/server/result_cache.h>
+#include <rpc_framework/server/concurrency_limiter.h>
+#include <rpc_framework/server/singleflight.h>
+#include <rpc_framework/server/method_stats.h>
+#include <rpc_framework/server/request_batcher.h>
 
 namespace rpc_server
 {
@@ -25,8 +36,220 @@ namespace rpc_server
             Object,
         };
 
+        // 检查值的类型是否与给定类型一致
+        inline bool matchParamsType(params_type p, const Json::Value &val)
+        {
+            switch (p)
+            {
+            case params_type::Bool:
+                return val.isBool();
+            case params_type::Integral:
+                return val.isIntegral();
+            case params_type::Numeric:
+                return val.isNumeric();
+            case params_type::String:
+                return val.isString();
+            case params_type::Array:
+                return val.isArray();
+            case params_type::Object:
+                return val.isObject();
+            default:
+                break;
+            }
+
+            return false;
+        }
+
+        // 参数结构描述
+        // 由SchemaBuilder在注册服务时构建，之后不再修改，可以被多个线程同时用于校验
+        // 对象类型描述每一个字段，数组类型描述元素的结构，其余类型只描述自身类型
+        class ParamsSchema
+        {
+        public:
+            using ptr = std::shared_ptr<const ParamsSchema>;
+
+            struct Field
+            {
+                std::string name;        // 字段名
+                ParamsSchema::ptr schema; // 字段结构
+                bool required = true;    // 是否必须存在
+                Json::Value def;         // 可选字段缺少时填充的默认值，为空表示不填充
+            };
+
+            explicit ParamsSchema(params_type type)
+                : type_(type)
+            {
+            }
+
+            // 校验参数并为缺少的可选字段填充默认值
+            // 只按结构描述访问一次每一个字段，出错时立即返回，err中保存出错的字段路径
+            bool validate(Json::Value &val, std::string &err) const
+            {
+                if (!matchParamsType(type_, val))
+                {
+                    err = "：类型错误";
+                    return false;
+                }
+
+                if (type_ == params_type::Object)
+                {
+                    for (const auto &field : fields_)
+                    {
+                        Json::Value *member = val.demand(field.name.data(), field.name.data() + field.name.size());
+                        if (member->isNull())
+                        {
+                            if (field.required)
+                            {
+                                err = field.name + "：字段不存在";
+                                return false;
+                            }
+
+                            // 可选字段：有默认值时填充，否则删除demand插入的空字段
+                            if (field.def.isNull())
+                                val.removeMember(field.name);
+                            else
+                                *member = field.def;
+                            continue;
+                        }
+
+                        if (!field.schema->validate(*member, err))
+                        {
+                            err = joinPath(field.name, err);
+                            return false;
+                        }
+                    }
+                }
+                else if (type_ == params_type::Array && element_)
+                {
+                    for (Json::ArrayIndex i = 0; i < val.size(); i++)
+                    {
+                        if (!element_->validate(val[i], err))
+                        {
+                            err = joinPath("[" + std::to_string(i) + "]", err);
+                            return false;
+                        }
+                    }
+                }
+
+                return true;
+            }
+
+            params_type type() const
+            {
+                return type_;
+            }
+
+        private:
+            friend class SchemaBuilder;
+
+            // 拼接出错的字段路径，例如：point.x：类型错误、tags[1]：类型错误
+            static std::string joinPath(const std::string &name, const std::string &err)
+            {
+                bool direct = err.empty() || err[0] == '[' || err.compare(0, strlen("："), "：") == 0;
+                return name + (direct ? "" : ".") + err;
+            }
+
+            params_type type_;
+            std::vector<Field> fields_; // 对象的字段
+            ptr element_;               // 数组元素的结构，为空表示不限制元素
+        };
+
+        // 参数结构建造者，顶层为对象
+        // 例如：SchemaBuilder().field("num", params_type::Integral)
+        //                      .field("scale", params_type::Numeric, 1.0)
+        //                      .field("point", SchemaBuilder().field("x", params_type::Integral))
+        //                      .array("tags", params_type::String)
+        //                      .build();
+        class SchemaBuilder
+        {
+        public:
+            SchemaBuilder()
+                : schema_(std::make_shared<ParamsSchema>(params_type::Object))
+            {
+            }
+
+            // 必须存在的字段
+            SchemaBuilder &field(const std::string &name, params_type type)
+            {
+                return addField(name, std::make_shared<ParamsSchema>(type), true, Json::Value());
+            }
+
+            // 可选字段，缺少时填充默认值
+            SchemaBuilder &field(const std::string &name, params_type type, const Json::Value &def)
+            {
+                return addField(name, std::make_shared<ParamsSchema>(type), false, def);
+            }
+
+            // 可选字段，缺少时不填充
+            SchemaBuilder &optional(const std::string &name, params_type type)
+            {
+                return addField(name, std::make_shared<ParamsSchema>(type), false, Json::Value());
+            }
+
+            // 嵌套对象字段
+            SchemaBuilder &field(const std::string &name, const SchemaBuilder &nested, bool required = true)
+            {
+                return addField(name, nested.build(), required, Json::Value());
+            }
+
+            // 元素为指定类型的数组字段
+            SchemaBuilder &array(const std::string &name, params_type element, bool required = true)
+            {
+                auto arr = std::make_shared<ParamsSchema>(params_type::Array);
+                arr->element_ = std::make_shared<ParamsSchema>(element);
+                return addField(name, arr, required, Json::Value());
+            }
+
+            // 元素为对象的数组字段
+            SchemaBuilder &array(const std::string &name, const SchemaBuilder &element, bool required = true)
+            {
+                auto arr = std::make_shared<ParamsSchema>(params_type::Array);
+                arr->element_ = element.build();
+                return addField(name, arr, required, Json::Value());
+            }
+
+            // 构建不可修改的结构描述，建造者之后依旧可以继续使用
+            ParamsSchema::ptr build() const
+            {
+                return std::make_shared<ParamsSchema>(*schema_);
+            }
+
+        private:
+            SchemaBuilder &addField(const std::string &name, const ParamsSchema::ptr &schema, bool required, const Json::Value &def)
+            {
+                // 同名字段以最后一次为准
+                for (auto &f : schema_->fields_)
+                {
+                    if (f.name == name)
+                    {
+                        f.schema = schema;
+                        f.required = required;
+                        f.def = def;
+                        return *this;
+                    }
+                }
+
+                schema_->fields_.push_back({name, schema, required, def});
+                return *this;
+            }
+
+        private:
+            std::shared_ptr<ParamsSchema> schema_;
+        };
+
+        class StreamWriter;
+        class Responder;
+
         // 业务回调函数类型
         using handler_t = std::function<void(const Json::Value &, Json::Value &)>;
+        // 流式业务回调函数类型，通过StreamWriter逐个写出元素
+        using stream_handler_t = std::function<void(const Json::Value &, const std::shared_ptr<StreamWriter> &)>;
+        // 异步业务回调函数类型，保存Responder后可以立即返回，之后在任意线程中应答
+        using async_handler_t = std::function<void(const Json::Value &, const std::shared_ptr<Responder> &)>;
+#ifdef RPC_HAS_COROUTINE
+        // 协程业务回调函数类型，co_return返回结果，可以在其中co_await其他RPC调用
+        using coroutine_handler_t = std::function<coroutine_task::Task<Json::Value>(const Json::Value &)>;
+#endif
         using params_desciption_t = std::pair<std::string, params_type>;
 
         class ServiceDesc
@@ -37,33 +260,25 @@ namespace rpc_server
             // ServiceDesc() = default;
 
             // 右值不能带const
+            // 简单参数列表转换为只有一层的参数结构
             ServiceDesc(std::string &&method, handler_t &&handler, std::vector<params_desciption_t> &&params, params_type &&return_type)
-                : method_name_(std::move(method)), handler_(std::move(handler)), params_(params), return_type_(std::move(return_type))
+                : method_name_(std::move(method)), handler_(std::move(handler)), return_type_(std::move(return_type))
             {
+                SchemaBuilder builder;
+                for (const auto &desc : params)
+                    builder.field(desc.first, desc.second);
+                schema_ = builder.build();
             }
 
-            // 参数类型校验
-            // 遍历指定的参数和类型与用户传递的参数和类型进行对比
-            bool paramsCheck(const Json::Value &params)
+            // 参数校验
+            // 按参数结构校验用户传递的参数，同时为缺少的可选字段填充默认值
+            bool paramsCheck(Json::Value &params)
             {
-                for (const auto &desc : params_)
+                std::string err;
+                if (!schema_->validate(params, err))
                 {
-                    // 判断字段是否存在
-                    if (!params.isMember(desc.first))
-                    {
-                        LOG(Level::Warning, "指定的成员不存在：{}", desc.first);
-                        return false;
-                    }
-
-                    // 判断字段类型和给定类型是否一致
-                    // 注意需要判断的是指定的字段而不是直接params对象
-                    if (!checkParamsType(desc.second, params[desc.first]))
-                    {
-                        // debug
-                        // LOG(Level::Debug, "当前类型为：{}", params.asInt());
-                        LOG(Level::Warning, "指定的类型错误：{}", static_cast<int>(desc.second));
-                        return false;
-                    }
+                    LOG(Level::Warning, "服务：{} 参数错误 {}", method_name_, err);
+                    return false;
                 }
 
                 return true;
@@ -82,35 +297,77 @@ namespace rpc_server
                 return true;
             }
 
+            // 调用流式回调函数
+            void callStreamHandler(const Json::Value &input, const std::shared_ptr<StreamWriter> &writer)
+            {
+                stream_handler_(input, writer);
+            }
+
+            // 调用异步回调函数
+            void callAsyncHandler(const Json::Value &input, const std::shared_ptr<Responder> &responder)
+            {
+                async_handler_(input, responder);
+            }
+
+            // 检查异步结果或者流中元素的类型，流式服务的返回值类型即为元素类型
+            bool checkResultType(const Json::Value &result)
+            {
+                return checkReturnType(return_type_, result);
+            }
+
+            // 是否为流式服务
+            bool isStream() const
+            {
+                return static_cast<bool>(stream_handler_);
+            }
+
+            // 是否为异步服务
+            bool isAsync() const
+            {
+                return static_cast<bool>(async_handler_);
+            }
+
             // 获取服务名称
             std::string getMethodName()
             {
                 return method_name_;
             }
 
+            // 获取结果缓存，为空表示不缓存
+            const result_cache::ResultCache::ptr &resultCache() const
+            {
+                return result_cache_;
+            }
+
+            // 获取并发限制，为空表示不限制
+            const concurrency_limiter::ConcurrencyLimiter::ptr &limiter() const
+            {
+                return limiter_;
+            }
+
+            // 获取相同请求合并，为空表示不合并
+            const singleflight::Singleflight::ptr &singleflight() const
+            {
+                return singleflight_;
+            }
+
+            // 获取调用统计
+            const method_stats::MethodStats::ptr &stats() const
+            {
+                return stats_;
+            }
+
+            // 获取请求聚合器，为空表示不是批量服务
+            const request_batcher::RequestBatcher::ptr &batcher() const
+            {
+                return batcher_;
+            }
+
         private:
             // 检查参数类型
             bool checkParamsType(const params_type &p, const Json::Value &val)
             {
-                switch (p)
-                {
-                case params_type::Bool:
-                    return val.isBool();
-                case params_type::Integral:
-                    return val.isIntegral();
-                case params_type::Numeric:
-                    return val.isNumeric();
-                case params_type::String:
-                    return val.isString();
-                case params_type::Array:
-                    return val.isArray();
-                case params_type::Object:
-                    return val.isObject();
-                default:
-                    break;
-                }
-
-                return false;
+                return matchParamsType(p, val);
             }
 
             // 检查返回值类型
@@ -120,11 +377,195 @@ namespace rpc_server
             }
 
         private:
-            // friend class ServiceDescFactory;          // 建造者友元类
+            friend class ServiceDescFactory;          // 建造者友元类，用于设置可选属性
             std::string method_name_;                 // 方法名
             handler_t handler_;                       // 业务回调函数
-            std::vector<params_desciption_t> params_; // 保存所有参数和对应的类型
+            ParamsSchema::ptr schema_;                // 参数结构
             params_type return_type_;                 // 返回值类型
+            stream_handler_t stream_handler_;         // 流式业务回调函数，为空表示普通服务
+            async_handler_t async_handler_;           // 异步业务回调函数，为空表示同步服务
+            result_cache::ResultCache::ptr result_cache_; // 结果缓存，为空表示不缓存
+            concurrency_limiter::ConcurrencyLimiter::ptr limiter_; // 并发限制，为空表示不限制
+            singleflight::Singleflight::ptr singleflight_;         // 相同请求合并，为空表示不合并
+            method_stats::MethodStats::ptr stats_ = std::make_shared<method_stats::MethodStats>(); // 调用统计
+            request_batcher::RequestBatcher::ptr batcher_;         // 请求聚合器，为空表示不是批量服务
+        };
+
+        // 流式响应写入器
+        // 流式服务通过写入器逐个发送元素，每一个元素单独构成一个响应，客户端可以边接收边处理
+        // 写入器可以交给其他线程继续写入，结束后调用finish或fail，未显式结束时在析构时发送结束响应
+        class StreamWriter
+        {
+        public:
+            using ptr = std::shared_ptr<StreamWriter>;
+
+            StreamWriter(const base_connection::BaseConnection::ptr &con, const std::string &rid, const ServiceDesc::ptr &desc)
+                : con_(con), rid_(rid), desc_(desc)
+            {
+            }
+
+            ~StreamWriter()
+            {
+                finish();
+            }
+
+            // 写入一个元素，流已经结束或者连接断开时返回false
+            // 连接的输出缓冲区超过高水位时（客户端读取过慢）先等待缓冲区发送，最多等待stream_write_timeout，
+            // 超时后以RCode_timeout结束流并返回false；在IO线程中写入时不能等待，超过高水位直接结束流，
+            // 因此需要写入大量元素的服务应当把写入器交给其他线程
+            bool write(const Json::Value &item)
+            {
+                std::unique_lock<std::mutex> lock(write_mtx_);
+                if (finished_)
+                    return false;
+
+                if (!con_->connected())
+                {
+                    LOG(Level::Warning, "连接已断开，流式服务：{} 停止写入", desc_->getMethodName());
+                    finished_ = true;
+                    desc_->stats()->recordResult(public_data::RCode::RCode_disconneted);
+                    return false;
+                }
+
+                if (!con_->waitWritable(public_data::stream_write_timeout))
+                {
+                    if (!con_->connected())
+                    {
+                        LOG(Level::Warning, "连接已断开，流式服务：{} 停止写入", desc_->getMethodName());
+                        finished_ = true;
+                        desc_->stats()->recordResult(public_data::RCode::RCode_disconneted);
+                        return false;
+                    }
+                    LOG(Level::Warning, "客户端读取过慢，流式服务：{} 停止写入", desc_->getMethodName());
+                    sendState(public_data::StreamState::Stream_error, public_data::RCode::RCode_timeout, Json::Value());
+                    finished_ = true;
+                    return false;
+                }
+
+                if (!desc_->checkResultType(item))
+                {
+                    LOG(Level::Warning, "流式服务：{} 元素类型错误（内部错误）", desc_->getMethodName());
+                    sendState(public_data::StreamState::Stream_error, public_data::RCode::RCode_internal_error, Json::Value());
+                    finished_ = true;
+                    return false;
+                }
+
+                sendState(public_data::StreamState::Stream_item, public_data::RCode::RCode_fine, item);
+                return true;
+            }
+
+            // 正常结束流
+            void finish()
+            {
+                std::unique_lock<std::mutex> lock(write_mtx_);
+                if (finished_)
+                    return;
+
+                finished_ = true;
+                sendState(public_data::StreamState::Stream_end, public_data::RCode::RCode_fine, Json::Value());
+            }
+
+            // 异常结束流，客户端收到对应的状态码
+            void fail(public_data::RCode rcode)
+            {
+                std::unique_lock<std::mutex> lock(write_mtx_);
+                if (finished_)
+                    return;
+
+                finished_ = true;
+                sendState(public_data::StreamState::Stream_error, rcode, Json::Value());
+            }
+
+            bool finished()
+            {
+                std::unique_lock<std::mutex> lock(write_mtx_);
+                return finished_;
+            }
+
+        private:
+            void sendState(public_data::StreamState state, public_data::RCode rcode, const Json::Value &item)
+            {
+                auto stream_resp = message_factory::MessageFactory::messageCreateFactory<response_message::RpcStreamResponse>();
+                stream_resp->setId(rid_);
+                stream_resp->setMType(public_data::MType::Resp_stream_rpc);
+                stream_resp->setRCode(rcode);
+                stream_resp->setStreamState(state);
+                if (state == public_data::StreamState::Stream_item)
+                    stream_resp->setResult(item);
+                else
+                    desc_->stats()->recordResult(rcode);
+
+                con_->send(stream_resp);
+            }
+
+        private:
+            std::mutex write_mtx_;                 // 保证多个线程写入时响应的顺序和结束状态
+            bool finished_ = false;                // 流是否已经结束
+            base_connection::BaseConnection::ptr con_;
+            std::string rid_;                      // 对应的请求ID
+            ServiceDesc::ptr desc_;
+        };
+
+        // 异步服务的应答器
+        // 业务回调保存应答器后立即返回，之后可以在任意线程中调用complete或fail，只有第一次应答有效
+        // 应答器销毁时仍未应答，视为内部错误，保证每一个请求都有响应
+        class Responder
+        {
+        public:
+            using ptr = std::shared_ptr<Responder>;
+            // 应答后由RpcRouter发送响应或者记录批量结果
+            using finish_t = std::function<void(public_data::RCode, const Json::Value &)>;
+
+            Responder(const ServiceDesc::ptr &desc, const finish_t &finish)
+                : desc_(desc), finish_(finish)
+            {
+            }
+
+            ~Responder()
+            {
+                if (!done_.load(std::memory_order_acquire))
+                {
+                    LOG(Level::Warning, "异步服务：{} 未应答（内部错误）", desc_->getMethodName());
+                    fail(public_data::RCode::RCode_internal_error);
+                }
+            }
+
+            // 返回结果，已经应答过时返回false
+            bool complete(const Json::Value &result)
+            {
+                if (done_.exchange(true, std::memory_order_acq_rel))
+                    return false;
+
+                if (!desc_->checkResultType(result))
+                {
+                    LOG(Level::Warning, "请求的：{} 服务返回值错误（内部错误）", desc_->getMethodName());
+                    finish_(public_data::RCode::RCode_internal_error, Json::Value());
+                    return true;
+                }
+
+                finish_(public_data::RCode::RCode_fine, result);
+                return true;
+            }
+
+            // 返回错误状态码，已经应答过时返回false
+            bool fail(public_data::RCode rcode)
+            {
+                if (done_.exchange(true, std::memory_order_acq_rel))
+                    return false;
+
+                finish_(rcode, Json::Value());
+                return true;
+            }
+
+            bool done() const
+            {
+                return done_.load(std::memory_order_acquire);
+            }
+
+        private:
+            std::atomic<bool> done_{false}; // 是否已经应答
+            ServiceDesc::ptr desc_;
+            finish_t finish_;
         };
 
         // 服务描述工厂
@@ -152,16 +593,148 @@ namespace rpc_server
                 return_type_ = type;
             }
 
+            // 设置完整的参数结构，设置后忽略setParams添加的参数
+            void setParamsSchema(const ParamsSchema::ptr &schema)
+            {
+                schema_ = schema;
+            }
+
+            // 设置流式业务回调，设置后为流式服务，返回值类型表示流中元素的类型
+            void setStreamHandler(const stream_handler_t &handler)
+            {
+                stream_handler_ = handler;
+            }
+
+            // 设置异步业务回调，设置后为异步服务
+            void setAsyncHandler(const async_handler_t &handler)
+            {
+                async_handler_ = handler;
+            }
+
+            // 为幂等的同步服务开启结果缓存，相同参数的调用在有效期内直接返回缓存的结果，不再调用业务回调
+            // ttl_ms：结果有效期（毫秒），max_entries：最多缓存的条目个数，max_bytes：最多占用的字节数，0表示不限制
+            void setResultCache(int ttl_ms, size_t max_entries, size_t max_bytes = 0)
+            {
+                result_cache_ = std::make_shared<result_cache::ResultCache>(ttl_ms, max_entries, max_bytes);
+            }
+
+            // 限制同时执行的调用个数，超出的调用最多排队max_queue个，队列已满时返回服务过载
+            // 异步服务从调用业务回调开始到应答为止都算作执行中
+            void setConcurrencyLimit(size_t max_concurrency, size_t max_queue)
+            {
+                limiter_ = std::make_shared<concurrency_limiter::ConcurrencyLimiter>(max_concurrency, max_queue);
+            }
+
+            // 根据执行耗时在[min_limit, max_limit]之间自动调整并发上限
+            void setAdaptiveConcurrencyLimit(size_t min_limit, size_t max_limit, size_t max_queue)
+            {
+                limiter_ = concurrency_limiter::ConcurrencyLimiter::createAdaptive(min_limit, max_limit, max_queue);
+            }
+
+            // 设置批量业务回调，基于异步服务实现
+            // 同时到达的请求在window_us微秒内聚合，最多max_batch个参数一起交给批量业务回调，每一个请求依旧单独响应
+            // 批量业务回调在聚合线程中执行，返回值类型表示每一个结果的类型
+            void setBatchHandler(const request_batcher::batch_handler_t &handler, size_t max_batch, int window_us)
+            {
+                batcher_ = std::make_shared<request_batcher::RequestBatcher>(handler, max_batch, std::chrono::microseconds(window_us));
+                request_batcher::RequestBatcher::ptr batcher = batcher_;
+                async_handler_ = [batcher](const Json::Value &params, const std::shared_ptr<Responder> &responder)
+                {
+                    batcher->add(params, [responder](public_data::RCode rcode, const Json::Value &result)
+                                 {
+                        if (rcode == public_data::RCode::RCode_fine)
+                            responder->complete(result);
+                        else
+                            responder->fail(rcode); });
+                };
+            }
+
+            // 合并同时到达的相同请求：参数相同的调用正在执行时，新的调用等待其结果而不是再执行一次
+            // ! 只适用于结果只由参数决定的幂等方法
+            void setSingleflight()
+            {
+                singleflight_ = std::make_shared<singleflight::Singleflight>();
+            }
+
+#ifdef RPC_HAS_COROUTINE
+            // 设置协程业务回调，基于异步服务实现
+            // 协程在收到请求的线程中启动，挂起后由恢复它的线程继续执行（例如内部RPC调用的响应所在的IO线程）
+            // 协程中抛出的异常视为内部错误
+            void setCoroutineHandler(const coroutine_handler_t &handler)
+            {
+                async_handler_ = [handler](const Json::Value &params, const std::shared_ptr<Responder> &responder)
+                {
+                    coroutine_task::spawn(runCoroutine(handler, params, responder));
+                };
+            }
+#endif
+
             ServiceDesc::ptr buildServiceDesc()
             {
-                return std::make_shared<ServiceDesc>(std::move(method_name_), std::move(handler_), std::move(params_), std::move(return_type_));
+                ServiceDesc::ptr desc = std::make_shared<ServiceDesc>(std::move(method_name_), std::move(handler_), std::move(params_), std::move(return_type_));
+                desc->stream_handler_ = std::move(stream_handler_);
+                desc->async_handler_ = std::move(async_handler_);
+                if (schema_)
+                    desc->schema_ = std::move(schema_);
+                // 流式服务和异步服务的结果不经过同步调用路径，不支持缓存
+                if (result_cache_ && (desc->isStream() || desc->isAsync()))
+                {
+                    LOG(Level::Warning, "服务：{} 不是同步服务，忽略结果缓存", desc->getMethodName());
+                    result_cache_.reset();
+                }
+                desc->result_cache_ = std::move(result_cache_);
+                // 流式服务由写入器决定何时结束，不支持并发限制
+                if (limiter_ && desc->isStream())
+                {
+                    LOG(Level::Warning, "服务：{} 是流式服务，忽略并发限制", desc->getMethodName());
+                    limiter_.reset();
+                }
+                desc->limiter_ = std::move(limiter_);
+                // 流式服务的每一个调用都有自己的写入器，不能共享结果
+                if (singleflight_ && desc->isStream())
+                {
+                    LOG(Level::Warning, "服务：{} 是流式服务，忽略请求合并", desc->getMethodName());
+                    singleflight_.reset();
+                }
+                desc->singleflight_ = std::move(singleflight_);
+                desc->batcher_ = std::move(batcher_);
+                return desc;
             }
 
         private:
+#ifdef RPC_HAS_COROUTINE
+            // 参数按值传递，保证协程挂起后依旧有效
+            static coroutine_task::Task<void> runCoroutine(coroutine_handler_t handler, Json::Value params, std::shared_ptr<Responder> responder)
+            {
+                try
+                {
+                    Json::Value result = co_await handler(params);
+                    responder->complete(result);
+                }
+                catch (const std::exception &e)
+                {
+                    LOG(Level::Warning, "协程服务异常：{}", e.what());
+                    responder->fail(public_data::RCode::RCode_internal_error);
+                }
+                catch (...)
+                {
+                    LOG(Level::Warning, "协程服务抛出未知异常");
+                    responder->fail(public_data::RCode::RCode_internal_error);
+                }
+            }
+#endif
+
             std::string method_name_;                 // 方法名
             handler_t handler_;                       // 业务回调函数
             std::vector<params_desciption_t> params_; // 保存所有参数和对应的类型
             params_type return_type_;                 // 返回值类型
+            stream_handler_t stream_handler_;         // 流式业务回调函数
+            async_handler_t async_handler_;           // 异步业务回调函数
+            ParamsSchema::ptr schema_;                // 参数结构
+            result_cache::ResultCache::ptr result_cache_; // 结果缓存
+            concurrency_limiter::ConcurrencyLimiter::ptr limiter_; // 并发限制
+            singleflight::Singleflight::ptr singleflight_;         // 相同请求合并
+            request_batcher::RequestBatcher::ptr batcher_;         // 请求聚合器
         };
 
         // 使用友元类
@@ -204,42 +777,106 @@ namespace rpc_server
         };
 #endif
 
+        // 服务管理
+        // 每一次RPC请求都需要查找服务，而注册和删除只发生在少数时刻
+        // 所以方法表保存为不可修改的快照，查找时不加锁，注册和删除时复制一份新的方法表后整体替换
         class ServiceManager
         {
         public:
             using ptr = std::shared_ptr<ServiceManager>;
 
             // 添加服务接口
+            // 每一个方法名在第一次注册时分配一个方法编号，编号即为稠密数组的下标
+            // 同名服务重复注册时沿用原有的编号，保证客户端缓存的方法表依旧有效
             void insertService(const ServiceDesc::ptr &desc)
             {
-                std::unique_lock<std::mutex> lock(manage_mtx_);
-                service_manager_.insert({desc->getMethodName(), desc});
+                table_.update([&desc](MethodTable &table)
+                              {
+                    auto pos = table.method_ids.find(desc->getMethodName());
+                    if (pos != table.method_ids.end())
+                    {
+                        table.id_services[pos->second] = desc;
+                        return;
+                    }
+
+                    table.method_ids.insert({desc->getMethodName(), table.id_services.size()});
+                    table.id_services.push_back(desc); });
             }
 
             // 删除服务接口
+            // 编号不回收，只将对应位置置空，防止旧编号指向新服务
             void removeService(const ServiceDesc::ptr &desc)
             {
-                std::unique_lock<std::mutex> lock(manage_mtx_);
-                service_manager_.erase(desc->getMethodName());
+                table_.update([&desc](MethodTable &table)
+                              {
+                    auto pos = table.method_ids.find(desc->getMethodName());
+                    if (pos == table.method_ids.end())
+                        return;
+
+                    table.id_services[pos->second].reset();
+                    table.method_ids.erase(pos); });
             }
 
             // 查找服务接口
             ServiceDesc::ptr findService(const std::string &method)
             {
-                std::unique_lock<std::mutex> lock(manage_mtx_);
-                auto pos = service_manager_.find(method);
-                if (pos == service_manager_.end())
+                const MethodTable &table = table_.read();
+                auto pos = table.method_ids.find(method);
+                if (pos == table.method_ids.end())
                 {
                     LOG(Level::Warning, "指定服务不存在：{}", method);
                     return nullptr;
                 }
 
-                return pos->second;
+                return table.id_services[pos->second];
+            }
+
+            // 根据方法编号查找服务接口，直接使用编号作为下标
+            ServiceDesc::ptr findService(int method_id)
+            {
+                const MethodTable &table = table_.read();
+                if (method_id < 0 || static_cast<size_t>(method_id) >= table.id_services.size())
+                {
+                    LOG(Level::Warning, "指定服务编号不存在：{}", method_id);
+                    return nullptr;
+                }
+
+                return table.id_services[method_id];
+            }
+
+            // 获取方法表：{方法名: 方法编号}
+            Json::Value methodTable()
+            {
+                const MethodTable &table = table_.read();
+                Json::Value result(Json::objectValue);
+                for (const auto &m : table.method_ids)
+                    result[m.first] = static_cast<int>(m.second);
+
+                return result;
+            }
+
+            // 获取所有服务
+            std::vector<ServiceDesc::ptr> allServices()
+            {
+                const MethodTable &table = table_.read();
+                std::vector<ServiceDesc::ptr> result;
+                for (const auto &desc : table.id_services)
+                {
+                    if (desc)
+                        result.push_back(desc);
+                }
+
+                return result;
             }
 
         private:
-            std::mutex manage_mtx_; // 用于管理的互斥锁
-            std::unordered_map<std::string, ServiceDesc::ptr> service_manager_;
+            struct MethodTable
+            {
+                std::unordered_map<std::string, size_t> method_ids; // 方法名与方法编号的映射
+                std::vector<ServiceDesc::ptr> id_services;          // 以方法编号为下标的服务数组
+            };
+
+            rcu_snapshot::RcuSnapshot<MethodTable> table_; // 方法表快照
         };
 
         class RpcRouter
@@ -250,37 +887,184 @@ namespace rpc_server
             RpcRouter()
                 : services_(std::make_shared<ServiceManager>())
             {
+                // 注册内置的方法表查询服务，客户端连接建立后通过该服务获取方法编号
+                ServiceDescFactory factory;
+                factory.setMethodName(public_data::method_table_name);
+                factory.setReturnType(params_type::Object);
+                // 服务描述保存在ServiceManager中，使用裸指针避免循环引用
+                ServiceManager *services = services_.get();
+                factory.setHandler([services](const Json::Value &, Json::Value &result)
+                                   { result = services->methodTable(); });
+                services_->insertService(factory.buildServiceDesc());
+
+                // 注册内置的统计查询服务，使用普通的RPC调用即可获取
+                ServiceDescFactory stats_factory;
+                stats_factory.setMethodName(public_data::stats_method_name);
+                stats_factory.setReturnType(params_type::Object);
+                stats_factory.setHandler([this](const Json::Value &, Json::Value &result)
+                                         { result = stats(); });
+                services_->insertService(stats_factory.buildServiceDesc());
             }
 
             // 提供给Dispatcher模块的注册回调
+            // 请求携带超时时间时，处理期间当前线程的截止时间为请求的截止时间
+            // 业务回调中可以通过CallContext读取剩余时间，发起的下游调用自动携带剩余时间
+            // 异步服务需要在其他线程中发起下游调用时，保存CallContext::deadline()并在该线程中设置Scope
             void handleRpcRequest(const base_connection::BaseConnection::ptr &con, request_message::RpcRequest::ptr &msg)
             {
+                auto received = std::chrono::steady_clock::now();
+                std::optional<call_context::CallContext::Scope> scope;
+                int timeout = msg->getTimeout();
+                if (timeout >= 0)
+                    scope.emplace(std::chrono::milliseconds(timeout));
+
                 // 1. 查找请求服务是否存在
-                auto pos = services_->findService(msg->getMethod());
+                ServiceDesc::ptr pos = findService(msg->getMethodId(), msg->getMethod());
                 if (!pos)
                 {
-                    LOG(Level::Warning, "请求的：{} 服务不存在", msg->getMethod());
                     buildRpcResponse(con, msg, Json::Value(), public_data::RCode::RCode_not_found_service);
+                    return;
+                }
+
+                // 调用者已经放弃等待，不再执行
+                if (call_context::CallContext::expired())
+                {
+                    LOG(Level::Warning, "请求的：{} 服务已经超时，不再执行", pos->getMethodName());
+                    sendServiceResponse(con, msg->getReqRespId(), pos, Json::Value(), public_data::RCode::RCode_timeout);
+                    return;
+                }
+
+                // 流式服务通过写入器返回多个响应
+                if (pos->isStream())
+                {
+                    callStreamService(con, msg, pos, received);
+                    return;
                 }
 
-                // 2. 判断请求中提供的参数是否正确
-                if (!pos->paramsCheck(msg->getParams()))
+                // 合并相同请求的服务只有第一个调用真正执行
+                if (pos->singleflight())
                 {
-                    LOG(Level::Warning, "请求的：{} 服务参数错误", msg->getMethod());
-                    buildRpcResponse(con, msg, Json::Value(), public_data::RCode::RCode_invalid_params);
+                    callSingleflightService(con, msg, pos, received);
+                    return;
                 }
 
-                // 3. 调用ServiceManager类中的函数执行服务
+                // 限制并发的服务在获得名额后执行
+                if (pos->limiter())
+                {
+                    callLimitedService(con, msg, pos, received);
+                    return;
+                }
+
+                // 异步服务在应答时发送响应
+                if (pos->isAsync())
+                {
+                    callAsyncService(con, msg, pos, received);
+                    return;
+                }
+
+                // 2. 校验参数并执行服务
+                recordQueue(pos, received);
+                Json::Value params = msg->getParams();
                 Json::Value result;
-                bool ret = pos->callHandler(msg->getParams(), result);
-                if (!ret)
+                public_data::RCode rcode = callService(pos, params, result);
+
+                // 3. 返回处理结果
+                sendServiceResponse(con, msg->getReqRespId(), pos, result, rcode);
+            }
+
+            // 批量请求的处理，注册到Dispatcher模块
+            // 按顺序执行每一次调用，所有结果放在一个响应中按位置返回
+            // 包含异步服务时，等所有异步调用应答后再发送响应
+            void handleBatchRpcRequest(const base_connection::BaseConnection::ptr &con, request_message::BatchRpcRequest::ptr &msg)
+            {
+                if (!msg->check())
+                {
+                    LOG(Level::Warning, "批量请求格式错误");
+                    auto batch_resp = message_factory::MessageFactory::messageCreateFactory<response_message::BatchRpcResponse>();
+                    batch_resp->setId(msg->getReqRespId());
+                    batch_resp->setMType(public_data::MType::Resp_batch_rpc);
+                    batch_resp->setRCode(public_data::RCode::RCode_invalid_msg);
+                    con->send(batch_resp);
+                    return;
+                }
+
+                // 调用过多时响应可能超过最大数据大小，客户端无法处理
+                if (msg->callCount() > public_data::max_batch_calls)
                 {
-                    LOG(Level::Warning, "请求的：{} 服务返回值错误（内部错误）", msg->getMethod());
-                    buildRpcResponse(con, msg, Json::Value(), public_data::RCode::RCode_internal_error);
+                    LOG(Level::Warning, "批量请求包含{}个调用，超过上限{}", msg->callCount(), public_data::max_batch_calls);
+                    auto batch_resp = message_factory::MessageFactory::messageCreateFactory<response_message::BatchRpcResponse>();
+                    batch_resp->setId(msg->getReqRespId());
+                    batch_resp->setMType(public_data::MType::Resp_batch_rpc);
+                    batch_resp->setRCode(public_data::RCode::RCode_too_large);
+                    con->send(batch_resp);
+                    return;
                 }
 
-                // 4. 返回处理结果
-                buildRpcResponse(con, msg, result, public_data::RCode::RCode_fine);
+                // 所有调用共用一个截止时间，按顺序执行时后面的调用可能已经超时
+                std::optional<call_context::CallContext::Scope> scope;
+                int timeout = msg->getTimeout();
+                if (timeout >= 0)
+                    scope.emplace(std::chrono::milliseconds(timeout));
+
+                auto received = std::chrono::steady_clock::now();
+                size_t count = msg->callCount();
+                auto state = std::make_shared<BatchState>();
+                state->con = con;
+                state->rid = msg->getReqRespId();
+                state->results.resize(count);
+                // 多计一次，保证所有调用都发起之后才可能发送响应
+                state->pending = count + 1;
+
+                for (size_t i = 0; i < count; i++)
+                {
+                    std::string method = msg->getMethod(i);
+                    ServiceDesc::ptr pos = findService(msg->getMethodId(i), method);
+                    if (!pos)
+                    {
+                        finishBatchCall(state, i, public_data::RCode::RCode_not_found_service, Json::Value());
+                        continue;
+                    }
+
+                    // 批量响应整体发送，每一次调用只记录结果，不记录发送耗时
+                    auto done = [state, i, pos](public_data::RCode rcode, const Json::Value &result)
+                    {
+                        pos->stats()->recordResult(rcode);
+                        finishBatchCall(state, i, rcode, result);
+                    };
+
+                    if (call_context::CallContext::expired())
+                    {
+                        done(public_data::RCode::RCode_timeout, Json::Value());
+                        continue;
+                    }
+
+                    Json::Value params = msg->getParams(i);
+                    if (pos->limiter())
+                    {
+                        if (!submitLimited(pos, params, done, received))
+                            done(public_data::RCode::RCode_overloaded, Json::Value());
+                        continue;
+                    }
+
+                    recordQueue(pos, received);
+                    if (pos->isAsync())
+                    {
+                        if (!pos->paramsCheck(params))
+                        {
+                            done(public_data::RCode::RCode_invalid_params, Json::Value());
+                            continue;
+                        }
+
+                        pos->callAsyncHandler(params, makeResponder(pos, done));
+                        continue;
+                    }
+
+                    Json::Value result;
+                    public_data::RCode rcode = callService(pos, params, result);
+                    done(rcode, result);
+                }
+
+                finishBatchCall(state, count, public_data::RCode::RCode_fine, Json::Value());
             }
 
             // 注册服务
@@ -290,12 +1074,423 @@ namespace rpc_server
                 services_->insertService(s);
             }
 
+            // 进程内的可信调用
+            // 调用方保证参数符合服务的参数结构，不进行参数校验，也不会填充默认值
+            public_data::RCode callTrusted(const std::string &method, const Json::Value &params, Json::Value &result)
+            {
+                ServiceDesc::ptr pos = services_->findService(method);
+                if (!pos)
+                    return public_data::RCode::RCode_not_found_service;
+
+                return invokeService(pos, params, result);
+            }
+
+            // 删除方法的所有缓存结果，方法不存在或者没有开启缓存时返回false
+            bool invalidateCache(const std::string &method)
+            {
+                ServiceDesc::ptr pos = services_->findService(method);
+                if (!pos || !pos->resultCache())
+                    return false;
+
+                pos->resultCache()->clear();
+                return true;
+            }
+
+            // 删除方法在指定参数下的缓存结果
+            // 参数需要与填充默认值之后的请求参数一致
+            bool invalidateCache(const std::string &method, const Json::Value &params)
+            {
+                ServiceDesc::ptr pos = services_->findService(method);
+                if (!pos || !pos->resultCache())
+                    return false;
+
+                return pos->resultCache()->invalidate(result_cache::ResultCache::makeKey(params));
+            }
+
+            // 获取所有限制并发的方法的统计信息：{方法名: {limit, running, queued, rejected}}
+            Json::Value limiterStats()
+            {
+                Json::Value result(Json::objectValue);
+                for (const auto &desc : services_->allServices())
+                {
+                    if (desc->limiter())
+                        result[desc->getMethodName()] = desc->limiter()->stats();
+                }
+
+                return result;
+            }
+
+            // 获取服务端的统计信息，同时作为内置统计服务的结果
+            // {uptime_s, methods: {方法名: 调用统计}, pools: 消息对象池统计, caches, limiters, singleflights, batchers}
+            Json::Value stats()
+            {
+                Json::Value result;
+                result["uptime_s"] = std::chrono::duration<double>(std::chrono::steady_clock::now() - started_).count();
+                Json::Value methods(Json::objectValue);
+                for (const auto &desc : services_->allServices())
+                    methods[desc->getMethodName()] = desc->stats()->stats();
+                result["methods"] = methods;
+                result["pools"] = message_factory::MessageFactory::poolStats();
+                result["caches"] = cacheStats();
+                result["limiters"] = limiterStats();
+                result["singleflights"] = singleflightStats();
+                Json::Value batchers(Json::objectValue);
+                for (const auto &desc : services_->allServices())
+                {
+                    if (desc->batcher())
+                        batchers[desc->getMethodName()] = desc->batcher()->stats();
+                }
+                result["batchers"] = batchers;
+                return result;
+            }
+
+            // 获取所有合并相同请求的方法的统计信息：{方法名: {executions, coalesced, in_flight}}
+            Json::Value singleflightStats()
+            {
+                Json::Value result(Json::objectValue);
+                for (const auto &desc : services_->allServices())
+                {
+                    if (desc->singleflight())
+                        result[desc->getMethodName()] = desc->singleflight()->stats();
+                }
+
+                return result;
+            }
+
+            // 获取所有开启缓存的方法的统计信息：{方法名: {hits, misses, hit_ratio, entries, bytes, evictions}}
+            Json::Value cacheStats()
+            {
+                Json::Value result(Json::objectValue);
+                for (const auto &desc : services_->allServices())
+                {
+                    if (desc->resultCache())
+                        result[desc->getMethodName()] = desc->resultCache()->stats();
+                }
+
+                return result;
+            }
+
         private:
+            // 一次批量请求的处理状态，由所有调用共享
+            struct BatchState
+            {
+                std::mutex mtx;
+                size_t pending = 0; // 未完成的调用个数
+                std::vector<std::pair<public_data::RCode, Json::Value>> results;
+                base_connection::BaseConnection::ptr con;
+                std::string rid;
+            };
+
+            // 查找服务
+            // 携带方法编号时直接按下标查找，否则按方法名查找
+            ServiceDesc::ptr findService(int method_id, const std::string &method)
+            {
+                ServiceDesc::ptr pos;
+                if (method_id >= 0)
+                    pos = services_->findService(method_id);
+                if (!pos)
+                    pos = services_->findService(method);
+                if (!pos)
+                    LOG(Level::Warning, "请求的：{}({}) 服务不存在", method, method_id);
+
+                return pos;
+            }
+
+            // 校验参数并调用流式业务回调，参数错误时以错误响应结束流
+            void callStreamService(const base_connection::BaseConnection::ptr &con, request_message::RpcRequest::ptr &msg, const ServiceDesc::ptr &desc,
+                                   std::chrono::steady_clock::time_point received)
+            {
+                recordQueue(desc, received);
+                StreamWriter::ptr writer = std::make_shared<StreamWriter>(con, msg->getReqRespId(), desc);
+                Json::Value params = msg->getParams();
+                if (!desc->paramsCheck(params))
+                {
+                    LOG(Level::Warning, "请求的：{} 服务参数错误", desc->getMethodName());
+                    writer->fail(public_data::RCode::RCode_invalid_params);
+                    return;
+                }
+
+                // 流式服务只记录回调本身的执行时间，交给其他线程继续写入的部分不计算在内
+                auto start = std::chrono::steady_clock::now();
+                desc->callStreamHandler(params, writer);
+                desc->stats()->record(method_stats::Stage::Stage_handler, std::chrono::steady_clock::now() - start);
+            }
+
+            // 校验参数并调用异步业务回调，应答时发送响应
+            void callAsyncService(const base_connection::BaseConnection::ptr &con, request_message::RpcRequest::ptr &msg, const ServiceDesc::ptr &desc,
+                                  std::chrono::steady_clock::time_point received)
+            {
+                recordQueue(desc, received);
+                std::string rid = msg->getReqRespId();
+                Json::Value params = msg->getParams();
+                if (!desc->paramsCheck(params))
+                {
+                    LOG(Level::Warning, "请求的：{} 服务参数错误", desc->getMethodName());
+                    sendServiceResponse(con, rid, desc, Json::Value(), public_data::RCode::RCode_invalid_params);
+                    return;
+                }
+
+                auto done = [con, rid, desc](public_data::RCode rcode, const Json::Value &result)
+                { sendServiceResponse(con, rid, desc, result, rcode); };
+                desc->callAsyncHandler(params, makeResponder(desc, done));
+            }
+
+            // 校验参数后按规范化的参数合并相同的请求，所有合并的请求得到同一个业务回调的结果
+            // 执行者因为自己的截止时间或者服务过载失败时，只有执行者得到该结果，由下一个等待者重新执行
+            void callSingleflightService(const base_connection::BaseConnection::ptr &con, request_message::RpcRequest::ptr &msg, const ServiceDesc::ptr &desc,
+                                         std::chrono::steady_clock::time_point received)
+            {
+                std::string rid = msg->getReqRespId();
+                Json::Value params = msg->getParams();
+                if (!desc->paramsCheck(params))
+                {
+                    LOG(Level::Warning, "请求的：{} 服务参数错误", desc->getMethodName());
+                    sendServiceResponse(con, rid, desc, Json::Value(), public_data::RCode::RCode_invalid_params);
+                    return;
+                }
+
+                auto done = [con, rid, desc](public_data::RCode rcode, const Json::Value &result)
+                { sendServiceResponse(con, rid, desc, result, rcode); };
+                bool has_deadline = call_context::CallContext::hasDeadline();
+                call_context::CallContext::clock_t::time_point deadline = call_context::CallContext::deadline();
+                auto exec = [this, desc, params, received, has_deadline, deadline](const Responder::finish_t &finish, const Responder::finish_t &reject)
+                {
+                    // 重新选出的执行者在前一个执行者所在的线程中执行，使用自己的截止时间
+                    call_context::CallContext::SwitchScope scope(has_deadline, deadline);
+                    if (call_context::CallContext::expired())
+                    {
+                        reject(public_data::RCode::RCode_timeout, Json::Value());
+                        return;
+                    }
+                    executeService(desc, params, finish, received, reject);
+                };
+                desc->singleflight()->run(json_util::JsonUtil::canonicalize(params), done, exec);
+            }
+
+            // 执行已经校验过参数的服务，结果通过done返回
+            // 没有执行业务回调就失败（服务过载、排队超时）时结果交给reject，为空时同样交给done
+            void executeService(const ServiceDesc::ptr &desc, const Json::Value &params, const Responder::finish_t &done,
+                                std::chrono::steady_clock::time_point received, const Responder::finish_t &reject = nullptr)
+            {
+                if (desc->limiter())
+                {
+                    const Responder::finish_t &fail = reject ? reject : done;
+                    if (!submitLimited(desc, params, done, received, fail))
+                        fail(public_data::RCode::RCode_overloaded, Json::Value());
+                    return;
+                }
+
+                recordQueue(desc, received);
+                if (desc->isAsync())
+                {
+                    desc->callAsyncHandler(params, makeResponder(desc, done));
+                    return;
+                }
+
+                Json::Value result;
+                public_data::RCode rcode = invokeService(desc, params, result);
+                done(rcode, result);
+            }
+
+            // 在并发限制下执行服务，队列已满时直接返回服务过载
+            void callLimitedService(const base_connection::BaseConnection::ptr &con, request_message::RpcRequest::ptr &msg, const ServiceDesc::ptr &desc,
+                                    std::chrono::steady_clock::time_point received)
+            {
+                std::string rid = msg->getReqRespId();
+                auto done = [con, rid, desc](public_data::RCode rcode, const Json::Value &result)
+                { sendServiceResponse(con, rid, desc, result, rcode); };
+                if (!submitLimited(desc, msg->getParams(), done, received))
+                {
+                    LOG(Level::Warning, "请求的：{} 服务过载", desc->getMethodName());
+                    done(public_data::RCode::RCode_overloaded, Json::Value());
+                }
+            }
+
+            // 提交到服务的并发限制中，获得名额后校验参数并执行，结果通过done返回
+            // 同步服务执行结束、异步服务应答时释放名额，队列已满时返回false
+            // 排队期间已经超时的调用在出队时直接返回超时，不再执行，超时结果交给expired，为空时交给done
+            bool submitLimited(const ServiceDesc::ptr &desc, const Json::Value &params, const Responder::finish_t &done,
+                               std::chrono::steady_clock::time_point received, const Responder::finish_t &expired = nullptr)
+            {
+                concurrency_limiter::ConcurrencyLimiter::ptr limiter = desc->limiter();
+                bool has_deadline = call_context::CallContext::hasDeadline();
+                call_context::CallContext::clock_t::time_point deadline = call_context::CallContext::deadline();
+                Responder::finish_t on_expired = expired ? expired : done;
+                return limiter->submit([this, desc, params, done, on_expired, limiter, has_deadline, deadline, received]()
+                                       {
+                    // 排队的调用可能在其他线程中执行，重新设置截止时间
+                    std::optional<call_context::CallContext::Scope> scope;
+                    if (has_deadline)
+                        scope.emplace(deadline);
+                    recordQueue(desc, received);
+
+                    auto start = std::chrono::steady_clock::now();
+                    auto release = [done, limiter, start](public_data::RCode rcode, const Json::Value &result)
+                    {
+                        // 先发送本次的结果，再释放名额执行排队的调用
+                        auto latency = std::chrono::steady_clock::now() - start;
+                        done(rcode, result);
+                        limiter->release(latency);
+                    };
+
+                    if (call_context::CallContext::expired())
+                    {
+                        LOG(Level::Warning, "请求的：{} 服务排队超时，不再执行", desc->getMethodName());
+                        on_expired(public_data::RCode::RCode_timeout, Json::Value());
+                        limiter->release(concurrency_limiter::ConcurrencyLimiter::duration_t(-1));
+                        return;
+                    }
+
+                    Json::Value input = params;
+                    if (!desc->paramsCheck(input))
+                    {
+                        release(public_data::RCode::RCode_invalid_params, Json::Value());
+                        return;
+                    }
+
+                    if (desc->isAsync())
+                    {
+                        desc->callAsyncHandler(input, makeResponder(desc, release));
+                        return;
+                    }
+
+                    Json::Value result;
+                    public_data::RCode rcode = invokeService(desc, input, result);
+                    release(rcode, result); });
+            }
+
+            // 记录批量请求中第index次调用的结果，index等于调用个数时表示所有调用都已经发起
+            // 最后一个完成的调用负责按顺序构建并发送响应
+            static void finishBatchCall(const std::shared_ptr<BatchState> &state, size_t index, public_data::RCode rcode, const Json::Value &result)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(state->mtx);
+                    if (index < state->results.size())
+                        state->results[index] = {rcode, result};
+                    if (--state->pending > 0)
+                        return;
+                }
+
+                auto batch_resp = message_factory::MessageFactory::messageCreateFactory<response_message::BatchRpcResponse>();
+                batch_resp->setId(state->rid);
+                batch_resp->setMType(public_data::MType::Resp_batch_rpc);
+                for (const auto &r : state->results)
+                    batch_resp->addResult(r.first, r.second);
+                batch_resp->setRCode(public_data::RCode::RCode_fine);
+
+                // 结果过大时客户端无法处理，只返回错误状态码，避免客户端一直等待
+                // 序列化后的正文保存为原始正文，发送时不再重复序列化
+                // 协议头包含长度、消息类型和ID长度三个字段以及ID
+                std::string body;
+                if (!batch_resp->serialize(body) || body.size() + state->rid.size() + 3 * sizeof(int32_t) >= static_cast<size_t>(public_data::max_data_size))
+                {
+                    LOG(Level::Warning, "批量响应大小{}超过上限", body.size());
+                    batch_resp->reset();
+                    batch_resp->setId(state->rid);
+                    batch_resp->setMType(public_data::MType::Resp_batch_rpc);
+                    batch_resp->setRCode(public_data::RCode::RCode_too_large);
+                }
+                else
+                {
+                    batch_resp->deserialize(body);
+                }
+                state->con->send(batch_resp);
+            }
+
+            // 校验参数并调用业务回调，返回对应的状态码
+            // 校验时会为缺少的可选参数填充默认值，所以参数不是const
+            public_data::RCode callService(const ServiceDesc::ptr &desc, Json::Value &params, Json::Value &result)
+            {
+                // 判断请求中提供的参数是否正确
+                if (!desc->isStream() && !desc->paramsCheck(params))
+                {
+                    LOG(Level::Warning, "请求的：{} 服务参数错误", desc->getMethodName());
+                    return public_data::RCode::RCode_invalid_params;
+                }
+
+                return invokeService(desc, params, result);
+            }
+
+            // 调用业务回调并检查返回值，不校验参数
+            public_data::RCode invokeService(const ServiceDesc::ptr &desc, const Json::Value &params, Json::Value &result)
+            {
+                // 流式服务只能单独调用，异步服务不能同步等待结果
+                if (desc->isStream() || desc->isAsync())
+                {
+                    LOG(Level::Warning, "服务：{} 不支持同步调用", desc->getMethodName());
+                    return public_data::RCode::RCode_invalid_msg;
+                }
+
+                auto start = std::chrono::steady_clock::now();
+                public_data::RCode rcode = invokeHandler(desc, params, result);
+                desc->stats()->record(method_stats::Stage::Stage_handler, std::chrono::steady_clock::now() - start);
+                return rcode;
+            }
+
+            // 查询结果缓存并调用业务回调
+            public_data::RCode invokeHandler(const ServiceDesc::ptr &desc, const Json::Value &params, Json::Value &result)
+            {
+                // 开启缓存时，命中则不再调用业务回调
+                const result_cache::ResultCache::ptr &cache = desc->resultCache();
+                std::string cache_key;
+                if (cache)
+                {
+                    cache_key = result_cache::ResultCache::makeKey(params);
+                    if (cache->get(cache_key, result))
+                        return public_data::RCode::RCode_fine;
+                }
+
+                // 调用ServiceManager类中的函数执行服务
+                if (!desc->callHandler(params, result))
+                {
+                    LOG(Level::Warning, "请求的：{} 服务返回值错误（内部错误）", desc->getMethodName());
+                    result = Json::Value();
+                    return public_data::RCode::RCode_internal_error;
+                }
+
+                // 只缓存成功的结果
+                if (cache)
+                    cache->put(cache_key, result);
+
+                return public_data::RCode::RCode_fine;
+            }
+
             void buildRpcResponse(const base_connection::BaseConnection::ptr &con, request_message::RpcRequest::ptr &msg, const Json::Value &ret, public_data::RCode rcode)
+            {
+                sendRpcResponse(con, msg->getReqRespId(), ret, rcode);
+            }
+
+            // 记录从收到请求到开始执行的时间
+            static void recordQueue(const ServiceDesc::ptr &desc, std::chrono::steady_clock::time_point received)
+            {
+                desc->stats()->record(method_stats::Stage::Stage_queue, std::chrono::steady_clock::now() - received);
+            }
+
+            // 创建应答器，应答时记录从调用业务回调到应答的时间
+            static Responder::ptr makeResponder(const ServiceDesc::ptr &desc, const Responder::finish_t &done)
+            {
+                auto start = std::chrono::steady_clock::now();
+                return std::make_shared<Responder>(desc, [desc, done, start](public_data::RCode rcode, const Json::Value &result)
+                                                   {
+                    desc->stats()->record(method_stats::Stage::Stage_handler, std::chrono::steady_clock::now() - start);
+                    done(rcode, result); });
+            }
+
+            // 发送服务的响应，记录构建并发送响应的时间和调用结果
+            static void sendServiceResponse(const base_connection::BaseConnection::ptr &con, const std::string &rid, const ServiceDesc::ptr &desc,
+                                            const Json::Value &ret, public_data::RCode rcode)
+            {
+                auto start = std::chrono::steady_clock::now();
+                sendRpcResponse(con, rid, ret, rcode);
+                desc->stats()->record(method_stats::Stage::Stage_encode, std::chrono::steady_clock::now() - start);
+                desc->stats()->recordResult(rcode);
+            }
+
+            static void sendRpcResponse(const base_connection::BaseConnection::ptr &con, const std::string &rid, const Json::Value &ret, public_data::RCode rcode)
             {
                 // 构建RpcResponse对象并填充字段
                 auto rpc_resp = message_factory::MessageFactory::messageCreateFactory<response_message::RpcResponse>();
-                rpc_resp->setId(msg->getReqRespId());
+                rpc_resp->setId(rid);
                 rpc_resp->setMType(public_data::MType::Resp_rpc);
                 rpc_resp->setRCode(rcode);
                 rpc_resp->setResult(ret);
@@ -306,6 +1501,7 @@ namespace rpc_server
 
         private:
             ServiceManager::ptr services_;
+            std::chrono::steady_clock::time_point started_ = std::chrono::steady_clock::now(); // 创建时间，用于计算运行时间
         };
     }
 }
@@ -0,0 +1,104 @@
+#ifndef __rpc_rpc_stream_server_h__
+#define __rpc_rpc_stream_server_h__
+
+#include <string>
+#include <unordered_map>
+#include <rpc_framework/base/base_connection.h>
+#include <rpc_framework/base/stream_message.h>
+#include <rpc_framework/base/rpc_stream.h>
+#include <rpc_framework/base/log.h>
+
+namespace rpc_server
+{
+    using namespace log_system;
+    namespace rpc_stream_server
+    {
+        // 双向流服务回调，在流被接受后调用，回调中设置数据和关闭回调并开始读写
+        using stream_accept_t = std::function<void(const rpc_stream::RpcStream::ptr &)>;
+
+        class StreamRouter
+        {
+        public:
+            using ptr = std::shared_ptr<StreamRouter>;
+
+            StreamRouter(int recv_window = public_data::default_stream_window)
+                : recv_window_(recv_window), streams_(std::make_shared<rpc_stream::StreamTable>())
+            {
+            }
+
+            // 注册双向流服务
+            void registerStream(const std::string &method, const stream_accept_t &handler)
+            {
+                std::unique_lock<std::mutex> lock(manage_map_mtx_);
+                handlers_[method] = handler;
+            }
+
+            // 提供给Dispatcher模块的注册回调
+            void handleStreamMessage(const base_connection::BaseConnection::ptr &con, stream_message::StreamMessage::ptr &msg)
+            {
+                if (!msg->check())
+                {
+                    LOG(Level::Warning, "双向流帧格式错误");
+                    rpc_stream::RpcStream::sendReset(con, msg->getReqRespId(), public_data::RCode::RCode_invalid_msg);
+                    return;
+                }
+
+                if (msg->getStreamOptype() == public_data::StreamOptype::Stream_open)
+                {
+                    handleOpen(con, msg);
+                    return;
+                }
+
+                streams_->dispatch(con, msg);
+            }
+
+            // 连接断开时终止该连接上的所有流
+            void handleConnectionShutdown(const base_connection::BaseConnection::ptr &con)
+            {
+                streams_->handleConnectionShutdown(con);
+            }
+
+        private:
+            void handleOpen(const base_connection::BaseConnection::ptr &con, stream_message::StreamMessage::ptr &msg)
+            {
+                std::string method = msg->getMethod();
+                stream_accept_t handler = findHandler(method);
+                if (!handler)
+                {
+                    LOG(Level::Warning, "请求的：{} 双向流服务不存在", method);
+                    rpc_stream::RpcStream::sendReset(con, msg->getReqRespId(), public_data::RCode::RCode_not_found_service);
+                    return;
+                }
+
+                rpc_stream::RpcStream::ptr stream = streams_->createStream(con, msg->getReqRespId(), method, recv_window_);
+                if (!stream)
+                {
+                    rpc_stream::RpcStream::sendReset(con, msg->getReqRespId(), public_data::RCode::RCode_invalid_msg);
+                    return;
+                }
+
+                // 先回复接受帧，服务回调中写入的数据一定在接受帧之后
+                stream->accept(msg->getCredit());
+                handler(stream);
+            }
+
+            stream_accept_t findHandler(const std::string &method)
+            {
+                std::unique_lock<std::mutex> lock(manage_map_mtx_);
+                auto pos = handlers_.find(method);
+                if (pos == handlers_.end())
+                    return nullptr;
+
+                return pos->second;
+            }
+
+        private:
+            int recv_window_;                                           // 每一个流的接收窗口
+            rpc_stream::StreamTable::ptr streams_;                      // 所有活跃的流
+            std::mutex manage_map_mtx_;                                 // 管理服务表的互斥锁
+            std::unordered_map<std::string, stream_accept_t> handlers_; // 方法名与双向流服务的映射
+        };
+    }
+}
+
+#endif
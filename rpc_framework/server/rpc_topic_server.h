@@ -7,6 +7,7 @@
 #include <rpc_framework/base/request_message.h>
 #include <rpc_framework/base/base_message.h>
 #include <rpc_framework/factories/message_factory.h>
+#include <rpc_framework/factories/protocol_factory.h>
 #include <rpc_framework/base/response_message.h>
 
 namespace rpc_server
@@ -80,13 +81,14 @@ namespace rpc_server
             }
 
             // 主题信息的发布
-            void publicMessage(const base_message::BaseMessage::ptr &msg)
+            // 消息已经提前编码为数据帧，所有订阅者共享同一份数据
+            void publicMessage(const base_connection::BaseConnection::frame_t &frame)
             {
                 std::unique_lock<std::mutex> lock(manage_set_mtx_);
                 // 遍历连接集合发送消息
                 for (auto &subscriber : subscibers_)
                     if (subscriber)
-                        subscriber->con_->send(msg);
+                        subscriber->con_->sendFrame(frame);
             }
         };
 
@@ -97,6 +99,7 @@ namespace rpc_server
             using ptr = std::shared_ptr<TopicManager>;
 
             TopicManager()
+                : pro_(protocol_factory::ProtocolFactory::createProtocolFactory())
             {
             }
 
@@ -293,8 +296,9 @@ namespace rpc_server
                     topic = it_topic->second;
                 }
 
+                // 只编码一次，再发送给所有订阅者
                 if (topic)
-                    topic->publicMessage(msg);
+                    topic->publicMessage(pro_->constructFrame(msg));
 
                 return true;
             }
@@ -326,6 +330,7 @@ namespace rpc_server
             }
 
         private:
+            base_protocol::BaseProtocol::ptr pro_; // 用于对发布的消息进行一次性编码
             std::mutex manage_map_mtx_;
             std::unordered_map<std::string, Topic::ptr> topics_;                                       // 主题和订阅者的管理
             std::unordered_map<base_connection::BaseConnection::ptr, Subscriber::ptr> con_subscriber_; // 订阅者和连接映射
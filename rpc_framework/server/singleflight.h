@@ -0,0 +1,171 @@
+#ifndef __rpc_singleflight_h__
+#define __rpc_singleflight_h__
+
+#include <mutex>
+#include <string>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include "jsoncpp/json/json.h"
+#include <rpc_framework/base/public_data.h>
+
+namespace rpc_server
+{
+    namespace singleflight
+    {
+        // 单个方法的相同请求合并
+        // 同一时刻参数相同的多个调用只执行一次，执行期间到达的相同调用等待该次执行，结束后所有调用得到同一个结果
+        // 只合并正在执行的调用，执行结束后到达的调用会重新执行（需要复用结果时配合结果缓存）
+        // 只共享业务回调产生的结果：执行者在执行业务回调之前失败（自己的截止时间已到、服务过载）时只结束执行者自己，
+        // 等待者中最早到达的一个成为新的执行者，按照自己的截止时间重新执行
+        class Singleflight : public std::enable_shared_from_this<Singleflight>
+        {
+        public:
+            using ptr = std::shared_ptr<Singleflight>;
+            // 调用结束时的回调
+            using finish_t = std::function<void(public_data::RCode, const Json::Value &)>;
+            // 执行调用，可以在其他线程中结束：业务回调的结果交给finish，由所有等待者共享；
+            // 没有执行业务回调就失败时交给reject，只属于当前调用
+            using exec_t = std::function<void(const finish_t &finish, const finish_t &reject)>;
+
+            // key相同的调用正在执行时等待其结果，否则在当前线程中调用exec执行
+            // exec在当前调用成为执行者时使用，可能在前一个执行者结束的线程中被调用
+            void run(const std::string &key, const finish_t &done, const exec_t &exec)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(mtx_);
+                    auto pos = calls_.find(key);
+                    if (pos != calls_.end())
+                    {
+                        pos->second.push_back({done, exec});
+                        coalesced_++;
+                        return;
+                    }
+
+                    calls_[key].push_back({done, exec});
+                    executions_++;
+                }
+
+                start(key, exec);
+            }
+
+            // 获取统计信息：{executions, coalesced, reelected, in_flight}
+            // executions为实际执行的次数，coalesced为等待其他调用结果的次数，reelected为执行者失败后重新选出执行者的次数
+            Json::Value stats()
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                Json::Value result;
+                result["executions"] = static_cast<Json::UInt64>(executions_);
+                result["coalesced"] = static_cast<Json::UInt64>(coalesced_);
+                result["reelected"] = static_cast<Json::UInt64>(reelected_);
+                result["in_flight"] = static_cast<Json::UInt64>(calls_.size());
+                return result;
+            }
+
+        private:
+            // 等待结果的调用，第一个是当前的执行者
+            struct Waiter
+            {
+                finish_t done;
+                exec_t exec;
+            };
+
+            // 一次执行的状态，区分reject在exec返回之前还是之后被调用
+            struct Attempt
+            {
+                std::mutex mtx;
+                bool returned = false; // exec是否已经返回
+                exec_t next;           // exec返回之前被拒绝时，下一个执行者的exec
+            };
+
+            // 执行exec，执行者在exec返回之前被拒绝时在循环中执行下一个执行者，避免递归
+            void start(const std::string &key, exec_t exec)
+            {
+                Singleflight::ptr self = shared_from_this();
+                while (exec)
+                {
+                    auto attempt = std::make_shared<Attempt>();
+                    exec([self, key](public_data::RCode rcode, const Json::Value &result)
+                         { self->finish(key, rcode, result); },
+                         [self, key, attempt](public_data::RCode rcode, const Json::Value &result)
+                         {
+                             exec_t next = self->reject(key, rcode, result);
+                             {
+                                 std::unique_lock<std::mutex> lock(attempt->mtx);
+                                 if (!attempt->returned)
+                                 {
+                                     attempt->next = std::move(next);
+                                     return;
+                                 }
+                             }
+                             if (next)
+                                 self->start(key, next);
+                         });
+
+                    std::unique_lock<std::mutex> lock(attempt->mtx);
+                    attempt->returned = true;
+                    exec = std::move(attempt->next);
+                }
+            }
+
+            // 取出所有等待者后再通知，通知期间到达的相同调用会重新执行
+            void finish(const std::string &key, public_data::RCode rcode, const Json::Value &result)
+            {
+                std::vector<Waiter> waiters;
+                {
+                    std::unique_lock<std::mutex> lock(mtx_);
+                    auto pos = calls_.find(key);
+                    if (pos == calls_.end())
+                        return;
+
+                    waiters.swap(pos->second);
+                    calls_.erase(pos);
+                }
+
+                for (const auto &waiter : waiters)
+                    waiter.done(rcode, result);
+            }
+
+            // 只结束当前的执行者，返回下一个执行者的exec，不存在等待者时返回空
+            exec_t reject(const std::string &key, public_data::RCode rcode, const Json::Value &result)
+            {
+                finish_t done;
+                exec_t next;
+                {
+                    std::unique_lock<std::mutex> lock(mtx_);
+                    auto pos = calls_.find(key);
+                    if (pos == calls_.end())
+                        return nullptr;
+
+                    std::vector<Waiter> &waiters = pos->second;
+                    done = std::move(waiters.front().done);
+                    waiters.erase(waiters.begin());
+                    if (waiters.empty())
+                    {
+                        calls_.erase(pos);
+                    }
+                    else
+                    {
+                        next = waiters.front().exec;
+                        executions_++;
+                        reelected_++;
+                    }
+                }
+
+                done(rcode, result);
+                return next;
+            }
+
+        private:
+            std::mutex mtx_;
+            std::unordered_map<std::string, std::vector<Waiter>> calls_; // 正在执行的调用与等待其结果的调用
+            uint64_t executions_ = 0;                                    // 实际执行的次数
+            uint64_t coalesced_ = 0;                                     // 被合并的调用次数
+            uint64_t reelected_ = 0;                                     // 重新选出执行者的次数
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,178 @@
+#include <rpc_framework/client/rpc_caller.h>
+#include <rpc_framework/factories/message_factory.h>
+#include <new>
+#include <chrono>
+#include <atomic>
+#include <cstdlib>
+
+using namespace log_system;
+using namespace rpc_client::requestor_rpc_framework;
+using namespace rpc_client::rpc_caller;
+
+// 统计当前线程在计数期间的内存分配次数
+static std::atomic<uint64_t> alloc_count(0);
+static thread_local bool counting = false;
+
+void *operator new(size_t size)
+{
+    if (counting)
+        alloc_count.fetch_add(1, std::memory_order_relaxed);
+    void *p = std::malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    std::free(p);
+}
+
+// 修改前的异步调用方式，作为对比
+// 每次调用分配一个promise、一个std::bind回调和一个额外带promise的请求描述，结果复制两次
+class LegacyCaller
+{
+public:
+    LegacyCaller(const Requestor::ptr &requestor)
+        : requestor_(requestor)
+    {
+    }
+
+    bool call(const base_connection::BaseConnection::ptr &con, const std::string &method_name, const Json::Value &params, std::future<Json::Value> &result)
+    {
+        auto rpc_req = message_factory::MessageFactory::messageCreateFactory<request_message::RpcRequest>();
+        rpc_req->setId(requestor_->nextRequestId());
+        rpc_req->setMType(public_data::MType::Req_rpc);
+        rpc_req->setMethod(method_name);
+        rpc_req->setParams(params);
+
+        std::shared_ptr<std::promise<Json::Value>> json_promise = std::make_shared<std::promise<Json::Value>>();
+        result = json_promise->get_future();
+        auto rd = std::make_shared<LegacyDesc>();
+        rd->request = rpc_req;
+        rd->callback = std::bind(&LegacyCaller::async_callback, this, json_promise, std::placeholders::_1);
+        return requestor_->sendRequest(con, rd);
+    }
+
+private:
+    // 原请求描述同时保存promise和回调
+    struct LegacyDesc : public Requestor::RequestDesc
+    {
+        std::promise<base_message::BaseMessage::ptr> response;
+        Requestor::callback_t callback;
+
+        bool complete(base_message::BaseMessage::ptr &msg) override
+        {
+            callback(msg);
+            return true;
+        }
+    };
+
+    void async_callback(std::shared_ptr<std::promise<Json::Value>> result, base_message::BaseMessage::ptr &msg)
+    {
+        auto resp_rpc = std::dynamic_pointer_cast<response_message::RpcResponse>(msg);
+        result->set_value(resp_rpc->getResult());
+    }
+
+private:
+    Requestor::ptr requestor_;
+};
+
+// 发送时立即在当前线程中构造响应并交给Requestor
+// 构造响应模拟网络收到的消息，不计入调用的分配次数
+class EchoConnection : public base_connection::BaseConnection
+{
+public:
+    EchoConnection(const Requestor::ptr &requestor)
+        : requestor_(requestor)
+    {
+        for (int i = 0; i < 16; i++)
+            result_["items"].append(i);
+        result_["name"] = "call_alloc_bench";
+        result_["sum"] = 120;
+    }
+
+    virtual void send(const base_message::BaseMessage::ptr &msg) override
+    {
+        counting = false;
+        auto resp = message_factory::MessageFactory::messageCreateFactory<response_message::RpcResponse>();
+        resp->setId(msg->getReqRespId());
+        resp->setMType(public_data::MType::Resp_rpc);
+        resp->setRCode(public_data::RCode::RCode_fine);
+        resp->setResult(result_);
+        base_message::BaseMessage::ptr base_resp = resp;
+        counting = true;
+
+        requestor_->handleResponse(nullptr, base_resp);
+    }
+
+    virtual void sendFrame(const frame_t &) override {}
+    virtual void shutdown() override {}
+    virtual bool connected() override { return true; }
+
+private:
+    Requestor::ptr requestor_;
+    Json::Value result_;
+};
+
+// 执行count次调用，输出每次调用的分配次数和耗时
+// 分配次数包括构造请求、请求描述、future共享状态和结果，不包括构造响应
+template <class F>
+void runBench(const std::string &name, int count, F call)
+{
+    alloc_count = 0;
+    auto start = std::chrono::steady_clock::now();
+    counting = true;
+    for (int i = 0; i < count; i++)
+        call();
+    counting = false;
+    auto cost = std::chrono::steady_clock::now() - start;
+
+    LOG(Level::Info, "{}：{:.2f}次分配/调用，{:.0f}ns/调用", name, static_cast<double>(alloc_count.load()) / count,
+        std::chrono::duration<double, std::nano>(cost).count() / count);
+}
+
+int main()
+{
+    const int count = 200000;
+    Requestor::ptr requestor = std::make_shared<Requestor>();
+    base_connection::BaseConnection::ptr con = std::make_shared<EchoConnection>(requestor);
+    LegacyCaller legacy_caller(requestor);
+    RpcCaller rpc_caller(requestor);
+
+    Json::Value params;
+    params["num1"] = 10;
+    params["num2"] = 20;
+    uint64_t sum = 0;
+
+    runBench("修改前 异步调用", count, [&]()
+             {
+        std::future<Json::Value> result;
+        legacy_caller.call(con, "add", params, result);
+        sum += result.get()["sum"].asInt(); });
+
+    runBench("RpcCaller 异步调用", count, [&]()
+             {
+        std::future<Json::Value> result;
+        rpc_caller.call(con, "add", params, result);
+        sum += result.get()["sum"].asInt(); });
+
+    RpcCaller::callback_t cb = [&sum](const Json::Value &result)
+    { sum += result["sum"].asInt(); };
+    runBench("RpcCaller 回调调用", count, [&]()
+             { rpc_caller.call(con, "add", params, cb); });
+
+    RpcCaller::done_callback_t done = [&sum](public_data::RCode, const Json::Value &result)
+    { sum += result["sum"].asInt(); };
+    runBench("RpcCaller 带状态码回调调用", count, [&]()
+             { rpc_caller.callAsync(con, "add", params, done); });
+
+    LOG(Level::Info, "结果校验：{}", sum);
+
+    return 0;
+}
@@ -0,0 +1,170 @@
+#include <rpc_framework/client/requestor.h>
+#include <rpc_framework/factories/message_factory.h>
+#include <rpc_framework/utils/timer_queue.h>
+#include <thread>
+#include <chrono>
+#include <atomic>
+
+using namespace log_system;
+using namespace rpc_client::requestor_rpc_framework;
+
+// 单个互斥锁管理请求表的版本，作为对比
+// 每次调用需要加锁三次：添加、查找、删除；请求带有超时时间时还要在全局定时器队列中添加和取消定时器
+class MutexRequestor
+{
+public:
+    struct RequestDesc
+    {
+        using ptr = std::shared_ptr<RequestDesc>;
+
+        base_message::BaseMessage::ptr request;
+        Requestor::callback_t callback;
+        base_connection::BaseConnection::ptr con;
+        timer_queue::TimerQueue::timer_id_t timer_id = 0;
+    };
+
+    std::string nextRequestId()
+    {
+        return std::to_string(next_id_.fetch_add(1, std::memory_order_relaxed) + 1);
+    }
+
+    void handleResponse(const base_connection::BaseConnection::ptr &, base_message::BaseMessage::ptr &msg)
+    {
+        RequestDesc::ptr rd = findRequestDesc(msg->getReqRespId());
+        if (!rd)
+            return;
+
+        if (rd->timer_id)
+            timer_.cancel(rd->timer_id);
+        rd->callback(msg);
+        removeRequestDesc(msg->getReqRespId());
+    }
+
+    bool sendRequest(const base_connection::BaseConnection::ptr &con, const base_message::BaseMessage::ptr &msg, Requestor::callback_t &cb)
+    {
+        RequestDesc::ptr rd = std::make_shared<RequestDesc>();
+        rd->request = msg;
+        rd->callback = cb;
+        rd->con = con;
+        int timeout_ms = std::dynamic_pointer_cast<json_message::JsonRequest>(msg)->getTimeout();
+        {
+            std::unique_lock<std::mutex> lock(manage_map_mtx_);
+            if (timeout_ms >= 0)
+                rd->timer_id = timer_.add(std::chrono::milliseconds(timeout_ms), std::bind(&MutexRequestor::removeRequestDesc, this, msg->getReqRespId()));
+            request_map_.insert({msg->getReqRespId(), rd});
+        }
+
+        con->send(msg);
+        return true;
+    }
+
+private:
+    RequestDesc::ptr findRequestDesc(const std::string &rid)
+    {
+        std::unique_lock<std::mutex> lock(manage_map_mtx_);
+        auto pos = request_map_.find(rid);
+        if (pos == request_map_.end())
+            return nullptr;
+
+        return pos->second;
+    }
+
+    void removeRequestDesc(const std::string &rid)
+    {
+        std::unique_lock<std::mutex> lock(manage_map_mtx_);
+        request_map_.erase(rid);
+    }
+
+private:
+    std::unordered_map<std::string, RequestDesc::ptr> request_map_;
+    std::mutex manage_map_mtx_;
+    std::atomic<uint64_t> next_id_{0};
+    timer_queue::TimerQueue timer_;
+};
+
+// 发送时立即在当前线程中构造响应并交给请求表，只测量请求表本身的开销
+template <class R>
+class EchoConnection : public base_connection::BaseConnection
+{
+public:
+    EchoConnection(R &requestor)
+        : requestor_(requestor)
+    {
+    }
+
+    virtual void send(const base_message::BaseMessage::ptr &msg) override
+    {
+        auto resp = message_factory::MessageFactory::messageCreateFactory<response_message::RpcResponse>();
+        resp->setId(msg->getReqRespId());
+        resp->setMType(public_data::MType::Resp_rpc);
+        resp->setRCode(public_data::RCode::RCode_fine);
+        base_message::BaseMessage::ptr base_resp = resp;
+        requestor_.handleResponse(nullptr, base_resp);
+    }
+
+    virtual void sendFrame(const frame_t &) override {}
+    virtual void shutdown() override {}
+    virtual bool connected() override { return true; }
+
+private:
+    R &requestor_;
+};
+
+// thread_count个线程同时发起回调方式的请求，返回每秒完成的请求数
+// timeout_ms不小于0时每个请求都带有超时时间，测量添加和取消超时定时器的开销
+template <class R>
+double runBench(R &requestor, int thread_count, int timeout_ms)
+{
+    const auto duration = std::chrono::seconds(2);
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> total(0);
+    base_connection::BaseConnection::ptr con = std::make_shared<EchoConnection<R>>(requestor);
+
+    std::vector<std::thread> callers;
+    for (int i = 0; i < thread_count; i++)
+    {
+        callers.emplace_back([&]()
+                             {
+            uint64_t count = 0;
+            Requestor::callback_t cb = [&count](base_message::BaseMessage::ptr &)
+            { count++; };
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                auto req = message_factory::MessageFactory::messageCreateFactory<request_message::RpcRequest>();
+                req->setId(requestor.nextRequestId());
+                req->setMType(public_data::MType::Req_rpc);
+                if (timeout_ms >= 0)
+                    req->setTimeout(timeout_ms);
+                requestor.sendRequest(con, req, cb);
+            }
+            total += count; });
+    }
+
+    std::this_thread::sleep_for(duration);
+    stop = true;
+    for (auto &t : callers)
+        t.join();
+
+    return static_cast<double>(total.load()) / std::chrono::duration<double>(duration).count();
+}
+
+int main()
+{
+    const int thread_count = 32;
+    // 不设置超时时间和每个请求都设置3秒超时时间各测试一次
+    for (int timeout_ms : {-1, 3000})
+    {
+        MutexRequestor mutex_requestor;
+        Requestor sharded_requestor;
+
+        double mutex_qps = runBench(mutex_requestor, thread_count, timeout_ms);
+        double sharded_qps = runBench(sharded_requestor, thread_count, timeout_ms);
+
+        LOG(Level::Info, "超时时间：{}毫秒", timeout_ms);
+        LOG(Level::Info, "{}个线程 单锁请求表：{:.0f}次/秒", thread_count, mutex_qps);
+        LOG(Level::Info, "{}个线程 分片请求表：{:.0f}次/秒", thread_count, sharded_qps);
+        LOG(Level::Info, "提升：{:.2f}倍", sharded_qps / mutex_qps);
+    }
+
+    return 0;
+}
@@ -0,0 +1,110 @@
+#include <rpc_framework/server/rpc_router.h>
+#include <thread>
+#include <chrono>
+#include <atomic>
+
+using namespace log_system;
+using namespace rpc_server::rpc_router;
+
+// 加锁版本的服务管理，作为对比
+class MutexServiceManager
+{
+public:
+    void insertService(const ServiceDesc::ptr &desc)
+    {
+        std::unique_lock<std::mutex> lock(manage_mtx_);
+        services_[desc->getMethodName()] = desc;
+    }
+
+    ServiceDesc::ptr findService(const std::string &method)
+    {
+        std::unique_lock<std::mutex> lock(manage_mtx_);
+        auto pos = services_.find(method);
+        if (pos == services_.end())
+            return nullptr;
+
+        return pos->second;
+    }
+
+private:
+    std::mutex manage_mtx_;
+    std::unordered_map<std::string, ServiceDesc::ptr> services_;
+};
+
+ServiceDesc::ptr buildDesc(const std::string &name)
+{
+    ServiceDescFactory factory;
+    factory.setMethodName(name);
+    factory.setReturnType(params_type::Integral);
+    factory.setHandler([](const Json::Value &, Json::Value &result)
+                       { result = 0; });
+    return factory.buildServiceDesc();
+}
+
+// thread_count个线程同时查找服务，同时有一个线程不断注册新服务
+// 返回每秒查找次数
+template <class Manager>
+double runBench(Manager &manager, int thread_count, const std::vector<std::string> &methods)
+{
+    const auto duration = std::chrono::seconds(2);
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> total(0);
+
+    std::vector<std::thread> readers;
+    for (int i = 0; i < thread_count; i++)
+    {
+        readers.emplace_back([&, i]()
+                             {
+            uint64_t count = 0;
+            size_t index = i;
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                if (!manager.findService(methods[index % methods.size()]))
+                    abort();
+                index++;
+                count++;
+            }
+            total += count; });
+    }
+
+    // 运行期间不断注册服务，验证写入不会影响读取的正确性
+    std::thread writer([&]()
+                       {
+        int n = 0;
+        while (!stop.load(std::memory_order_relaxed))
+        {
+            manager.insertService(buildDesc("runtime_" + std::to_string(n++ % 64)));
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        } });
+
+    std::this_thread::sleep_for(duration);
+    stop = true;
+    for (auto &t : readers)
+        t.join();
+    writer.join();
+
+    return static_cast<double>(total.load()) / std::chrono::duration<double>(duration).count();
+}
+
+int main()
+{
+    const int thread_count = 16;
+    std::vector<std::string> methods;
+    ServiceManager rcu_manager;
+    MutexServiceManager mutex_manager;
+    for (int i = 0; i < 32; i++)
+    {
+        methods.push_back("method_" + std::to_string(i));
+        rcu_manager.insertService(buildDesc(methods.back()));
+        mutex_manager.insertService(buildDesc(methods.back()));
+    }
+
+    double mutex_qps = runBench(mutex_manager, thread_count, methods);
+    double rcu_qps = runBench(rcu_manager, thread_count, methods);
+
+    LOG(Level::Info, "{}个线程 加锁查找：{:.0f}次/秒", thread_count, mutex_qps);
+    LOG(Level::Info, "{}个线程 快照查找：{:.0f}次/秒", thread_count, rcu_qps);
+    LOG(Level::Info, "提升：{:.2f}倍", rcu_qps / mutex_qps);
+
+    return 0;
+}
@@ -1,6 +1,8 @@
 #include <rpc_framework/base/request_message.h>
 #include <rpc_framework/base/response_message.h>
 #include <rpc_framework/factories/message_factory.h>
+#include <thread>
+#include <cassert>
 
 using namespace log_system;
 
@@ -231,6 +233,89 @@ void testServiceResp()
 
 }
 
+// 延迟解析测试
+void testLazyBody()
+{
+    request_message::TopicRequest::ptr tpq = message_factory::MessageFactory::messageCreateFactory<request_message::TopicRequest>();
+    tpq->setTopicName("music");
+    tpq->setTopicOptype(public_data::TopicOptype::Topic_publish);
+    tpq->setMessage("hello world");
+
+    std::string json_str;
+    assert(tpq->serialize(json_str));
+
+    // 收到的消息只保存原始正文，获取路由字段时不解析正文
+    request_message::TopicRequest::ptr recv = message_factory::MessageFactory::messageCreateFactory<request_message::TopicRequest>();
+    assert(recv->deserialize(json_str));
+    assert(recv->getTopicName() == "music");
+    assert(recv->getTopicOptype() == public_data::TopicOptype::Topic_publish);
+
+    // 转发时直接使用原始正文
+    std::string forward_str;
+    assert(recv->serialize(forward_str));
+    assert(forward_str == json_str);
+
+    // 修改字段后重新序列化
+    recv->setMessage("changed");
+    assert(recv->serialize(forward_str));
+    assert(forward_str != json_str);
+    assert(recv->getMessage() == "changed");
+    assert(recv->getTopicName() == "music");
+
+    // 字段重复时与完整解析一致，使用最后一个值
+    request_message::RpcRequest::ptr dup = message_factory::MessageFactory::messageCreateFactory<request_message::RpcRequest>();
+    assert(dup->deserialize(R"({"method":"a","parameters":{"num":1},"method":"b"})"));
+    assert(dup->getMethod() == "b");
+    assert(dup->check());
+    assert(dup->getParams()["num"].asInt() == 1);
+    assert(dup->getMethod() == "b");
+
+    LOG(Level::Info, "延迟解析测试通过");
+}
+
+// 消息对象池测试
+void testMessagePool()
+{
+    using pool_t = message_factory::MessagePool<request_message::RpcRequest>;
+    Json::Value before = pool_t::stats();
+
+    // 释放后再次获取时复用同一个对象，且正文已经被重置
+    const request_message::RpcRequest *first = nullptr;
+    for (int i = 0; i < 3; i++)
+    {
+        auto rrq = message_factory::MessageFactory::messageCreateFactory<request_message::RpcRequest>();
+        if (i == 0)
+            first = rrq.get();
+        assert(rrq.get() == first);
+        assert(rrq->getReqRespId().empty());
+        assert(rrq->getMethod().empty());
+        rrq->setId("id");
+        rrq->setMethod("add");
+    }
+
+    Json::Value after = pool_t::stats();
+    uint64_t hits = after["hits"].asUInt64() - before["hits"].asUInt64();
+    uint64_t misses = after["misses"].asUInt64() - before["misses"].asUInt64();
+    assert(hits + misses == 3);
+    assert(misses <= 1);
+
+    // 在其他线程释放的对象放入共享链表，获取对象的线程再次获取时取回
+    auto rrq = message_factory::MessageFactory::messageCreateFactory<request_message::RpcRequest>();
+    const request_message::RpcRequest *moved = rrq.get();
+    std::thread t([msg = std::move(rrq)]() mutable
+                  { msg.reset(); });
+    t.join();
+
+    before = pool_t::stats();
+    auto again = message_factory::MessageFactory::messageCreateFactory<request_message::RpcRequest>();
+    after = pool_t::stats();
+    assert(again.get() == moved);
+    assert(after["hits"].asUInt64() - before["hits"].asUInt64() == 1);
+    assert(after["misses"].asUInt64() == before["misses"].asUInt64());
+
+    LOG(Level::Info, "消息对象池测试通过：{}", message_factory::MessageFactory::poolStats()["RpcRequest"].toStyledString());
+}
+
 int main()
 {
     // testRpc();
@@ -238,4 +323,6 @@ int main()
     // testTopicResp();
     // testServiceReq();
     testServiceResp();
+    testLazyBody();
+    testMessagePool();
 }
\ No newline at end of file
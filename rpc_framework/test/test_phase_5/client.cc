@@ -7,9 +7,56 @@ void handlerResult(const Json::Value& result)
     LOG(Level::Info, "计算结果为：{}", result.asInt());
 }
 
+// 等待异步调用结束，返回结束时的状态码
+public_data::RCode waitRCode(rpc_client::rpc_caller::RpcCaller::aysnc_response &resp)
+{
+    try
+    {
+        resp.get();
+        return public_data::RCode::RCode_fine;
+    }
+    catch (const rpc_client::rpc_caller::RpcError &e)
+    {
+        return e.code();
+    }
+}
+
+// 获取服务端业务回调的执行次数
+int handledCount(rpc_client::main_client::RpcClient &client, const std::string &method)
+{
+    Json::Value handled;
+    if (!client.call("handled", Json::Value(Json::objectValue), handled))
+        return -1;
+    return handled[method].asInt();
+}
+
+#ifdef RPC_HAS_COROUTINE
+// 协程调用：依次调用两个服务，第二次调用使用第一次的结果
+coroutine_task::Task<void> coCall(rpc_client::main_client::RpcClient &client, std::promise<void> &done)
+{
+    try
+    {
+        Json::Value params;
+        params["num1"] = 1;
+        params["num2"] = 2;
+        Json::Value result = co_await client.call("co_add", params);
+        params["num1"] = result;
+        result = co_await client.call("async_add", params);
+        LOG(Level::Info, "协程调用结果为：{}", result.asInt());
+    }
+    catch (const rpc_client::rpc_caller::RpcError &e)
+    {
+        LOG(Level::Error, "协程调用错误：{}", e.what());
+    }
+    done.set_value();
+}
+#endif
+
 int main()
 {
     rpc_client::main_client::RpcClient client(false, "127.0.0.1", 8080);
+    // 超过3秒没有响应的调用以超时结束
+    client.setTimeout(3000);
 
     // 同步处理
     std::string method = "add";
@@ -26,6 +73,17 @@ int main()
 
     LOG(Level::Info, "计算结果为：{}", result1.asInt());
 
+    // 设置截止时间：请求携带剩余时间，服务端超时后不再执行
+    {
+        call_context::CallContext::Scope deadline(std::chrono::milliseconds(500));
+        ret = client.call(method, params, result1);
+        if (!ret)
+        {
+            LOG(Level::Error, "客户端RpcCaller调用错误");
+            return 1;
+        }
+    }
+
     // 异步处理
     params["num1"] = 50;
     params["num2"] = 60;
@@ -51,7 +109,290 @@ int main()
         return 1;
     }
 
+    // 异步服务，对客户端而言与普通服务相同
+    ret = client.call("async_add", params, handlerResult);
+    if (!ret)
+    {
+        LOG(Level::Error, "客户端RpcCaller调用错误");
+        return 1;
+    }
+
+#ifdef RPC_HAS_COROUTINE
+    std::promise<void> co_done;
+    coroutine_task::spawn(coCall(client, co_done));
+    co_done.get_future().wait();
+#endif
+
+    // 参数结构校验：scale使用默认值
+    Json::Value sum_params;
+    for (int i = 1; i <= 4; i++)
+        sum_params["nums"].append(i);
+    Json::Value result3;
+    ret = client.call("sum", sum_params, result3);
+    if (!ret)
+    {
+        LOG(Level::Error, "客户端RpcCaller调用错误");
+        return 1;
+    }
+    LOG(Level::Info, "计算结果为：{}", result3.asInt());
+
+    // 结果缓存：相同参数的调用直接返回缓存的结果，不执行业务回调；清除缓存或者缓存过期后重新执行
+    sum_params["nums"].append(5);
+    int sum_handled = handledCount(client, "sum");
+    const int expect_handled[] = {1, 0, 1, 1}; // 第一次调用、缓存命中、清除缓存后、缓存过期后
+    for (int i = 0; i < 4; i++)
+    {
+        if (i == 2)
+        {
+            Json::Value invalidate_params;
+            invalidate_params["method"] = "sum";
+            Json::Value invalidated;
+            if (!client.call("invalidate", invalidate_params, invalidated) || !invalidated.asBool())
+            {
+                LOG(Level::Error, "清除缓存失败");
+                return 1;
+            }
+        }
+        else if (i == 3)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+
+        if (!client.call("sum", sum_params, result3) || result3.asInt() != 15)
+        {
+            LOG(Level::Error, "客户端RpcCaller调用错误");
+            return 1;
+        }
+        int current = handledCount(client, "sum");
+        if (current - sum_handled != expect_handled[i])
+        {
+            LOG(Level::Error, "第{}次调用sum执行{}次，应为{}次", i + 1, current - sum_handled, expect_handled[i]);
+            return 1;
+        }
+        sum_handled = current;
+    }
+    LOG(Level::Info, "结果缓存命中，清除和过期后重新执行");
+
+    // 批量服务：同时发出的多个调用在服务端合并为少数几批执行，对客户端而言与普通服务相同
+    std::vector<rpc_client::rpc_caller::RpcCaller::aysnc_response> batch_resps(100);
+    for (int i = 0; i < 100; i++)
+    {
+        Json::Value batch_params;
+        batch_params["num1"] = i;
+        batch_params["num2"] = i;
+        ret = client.call("batch_add", batch_params, batch_resps[i]);
+        if (!ret)
+        {
+            LOG(Level::Error, "客户端RpcCaller调用错误");
+            return 1;
+        }
+    }
+    for (int i = 0; i < 100; i++)
+    {
+        if (batch_resps[i].get().asInt() != 2 * i)
+        {
+            LOG(Level::Error, "批量服务结果错误：{}", i);
+            return 1;
+        }
+    }
+    LOG(Level::Info, "批量服务调用完成");
+
+    // 批量调用：多个调用放在一个请求中发送，每个调用的结果按位置对应，互不影响
+    auto rpc_batch = std::make_shared<rpc_client::rpc_caller::RpcBatch>();
+    Json::Value bad_params;
+    bad_params["num1"] = "one";
+    bad_params["num2"] = 2;
+    std::vector<rpc_client::rpc_caller::RpcCaller::aysnc_response> batch_results;
+    batch_results.push_back(rpc_batch->addCall("add", params));
+    batch_results.push_back(rpc_batch->addCall("not_exist", params));
+    batch_results.push_back(rpc_batch->addCall("add", bad_params));
+    batch_results.push_back(rpc_batch->addCall("add", params));
+    if (!client.call(rpc_batch))
+    {
+        LOG(Level::Error, "批量调用发送失败");
+        return 1;
+    }
+    const public_data::RCode expect_rcodes[] = {public_data::RCode::RCode_fine, public_data::RCode::RCode_not_found_service,
+                                                public_data::RCode::RCode_invalid_params, public_data::RCode::RCode_fine};
+    for (size_t i = 0; i < batch_results.size(); i++)
+    {
+        public_data::RCode rcode = waitRCode(batch_results[i]);
+        if (rcode != expect_rcodes[i])
+        {
+            LOG(Level::Error, "批量调用第{}个结果错误：{}", i, public_data::errReason(rcode));
+            return 1;
+        }
+    }
+
+    // 超过上限的批量调用直接被拒绝，所有调用以数据过大结束
+    auto large_batch = std::make_shared<rpc_client::rpc_caller::RpcBatch>();
+    std::vector<rpc_client::rpc_caller::RpcCaller::aysnc_response> large_results;
+    for (size_t i = 0; i <= public_data::max_batch_calls; i++)
+        large_results.push_back(large_batch->addCall("add", params));
+    if (client.call(large_batch) || waitRCode(large_results.front()) != public_data::RCode::RCode_too_large ||
+        waitRCode(large_results.back()) != public_data::RCode::RCode_too_large)
+    {
+        LOG(Level::Error, "超过上限的批量调用没有被拒绝");
+        return 1;
+    }
+    LOG(Level::Info, "批量调用完成");
+
+    // 并发限制：async_add最多同时执行8个、排队64个，同时发出的更多调用以服务过载结束，不会执行
+    Json::Value limit_params;
+    limit_params["num1"] = 1;
+    limit_params["num2"] = 2;
+    int handled_before = handledCount(client, "async_add");
+    std::vector<rpc_client::rpc_caller::RpcCaller::aysnc_response> flood_resps(100);
+    for (auto &resp : flood_resps)
+    {
+        if (!client.call("async_add", limit_params, resp))
+        {
+            LOG(Level::Error, "客户端RpcCaller调用错误");
+            return 1;
+        }
+    }
+    int fine = 0;
+    int overloaded = 0;
+    for (auto &resp : flood_resps)
+    {
+        public_data::RCode rcode = waitRCode(resp);
+        if (rcode == public_data::RCode::RCode_fine)
+            fine++;
+        else if (rcode == public_data::RCode::RCode_overloaded)
+            overloaded++;
+    }
+    if (overloaded == 0 || fine + overloaded != static_cast<int>(flood_resps.size()) ||
+        handledCount(client, "async_add") - handled_before != fine)
+    {
+        LOG(Level::Error, "并发限制错误：成功{}个，过载{}个", fine, overloaded);
+        return 1;
+    }
+
+    // 排队超时：前面的调用需要执行约300毫秒，截止时间为50毫秒的调用出队时已经超时，不再执行
+    handled_before = handledCount(client, "async_add");
+    std::vector<rpc_client::rpc_caller::RpcCaller::aysnc_response> queued_resps(24);
+    for (auto &resp : queued_resps)
+    {
+        if (!client.call("async_add", limit_params, resp))
+        {
+            LOG(Level::Error, "客户端RpcCaller调用错误");
+            return 1;
+        }
+    }
+    rpc_client::rpc_caller::RpcCaller::aysnc_response expired_resp;
+    {
+        call_context::CallContext::Scope deadline(std::chrono::milliseconds(50));
+        ret = client.call("async_add", limit_params, expired_resp);
+    }
+    if (!ret || waitRCode(expired_resp) != public_data::RCode::RCode_timeout)
+    {
+        LOG(Level::Error, "排队的调用没有以超时结束");
+        return 1;
+    }
+    for (auto &resp : queued_resps)
+    {
+        if (waitRCode(resp) != public_data::RCode::RCode_fine)
+        {
+            LOG(Level::Error, "排队的调用没有完成");
+            return 1;
+        }
+    }
+    // 等待超时的调用出队
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    if (handledCount(client, "async_add") - handled_before != static_cast<int>(queued_resps.size()))
+    {
+        LOG(Level::Error, "排队超时的调用仍然被执行");
+        return 1;
+    }
+    LOG(Level::Info, "并发限制：{}个调用过载，排队超时的调用没有执行", overloaded);
+
+    // 合并执行：同时发出的相同调用只执行一次，结果分别返回；参数不同的调用单独执行
+    handled_before = handledCount(client, "shared_add");
+    std::vector<rpc_client::rpc_caller::RpcCaller::aysnc_response> shared_resps(10);
+    for (auto &resp : shared_resps)
+    {
+        if (!client.call("shared_add", limit_params, resp))
+        {
+            LOG(Level::Error, "客户端RpcCaller调用错误");
+            return 1;
+        }
+    }
+    rpc_client::rpc_caller::RpcCaller::aysnc_response other_resp;
+    if (!client.call("shared_add", params, other_resp))
+    {
+        LOG(Level::Error, "客户端RpcCaller调用错误");
+        return 1;
+    }
+    for (auto &resp : shared_resps)
+    {
+        if (resp.get().asInt() != 3)
+        {
+            LOG(Level::Error, "合并执行的结果错误");
+            return 1;
+        }
+    }
+    if (other_resp.get().asInt() != params["num1"].asInt() + params["num2"].asInt() ||
+        handledCount(client, "shared_add") - handled_before != 2)
+    {
+        LOG(Level::Error, "合并执行错误：执行{}次", handledCount(client, "shared_add") - handled_before);
+        return 1;
+    }
+    LOG(Level::Info, "{}个相同的调用只执行一次", shared_resps.size());
+
+    // 内置统计服务，与普通服务的调用方式相同
+    Json::Value stats;
+    ret = client.call(public_data::stats_method_name, Json::Value(Json::objectValue), stats);
+    if (ret)
+    {
+        LOG(Level::Info, "sum调用次数：{}，处理耗时p99：{}us", stats["methods"]["sum"]["calls"].asUInt64(), stats["methods"]["sum"]["handler_us"]["p99"].asUInt64());
+        LOG(Level::Info, "batch_add调用次数：{}，批量个数：{}", stats["batchers"]["batch_add"]["items"].asUInt64(), stats["batchers"]["batch_add"]["batches"].asUInt64());
+    }
+
+    // 流式处理
+    Json::Value range_params;
+    range_params["count"] = 10;
+    ret = client.callStream("range", range_params, handlerResult, [](public_data::RCode rcode)
+                            { LOG(Level::Info, "流式调用结束：{}", public_data::errReason(rcode)); });
+    if (!ret)
+    {
+        LOG(Level::Error, "客户端RpcCaller调用错误");
+        return 1;
+    }
+
+    // 双向流处理
+    rpc_stream::RpcStream::ptr stream;
+    ret = client.openStream("double", stream);
+    if (!ret)
+    {
+        LOG(Level::Error, "客户端打开双向流错误");
+        return 1;
+    }
+
+    stream->setDataCallback(handlerResult);
+    for (int i = 0; i < 10; i++)
+        stream->write(i);
+    stream->close();
+
     std::this_thread::sleep_for(std::chrono::seconds(5));
 
+    // 超时：服务端5秒后才应答，调用在3秒时以超时结束
+    rpc_client::rpc_caller::RpcCaller::aysnc_response slow_resp;
+    ret = client.call("slow_add", params, slow_resp);
+    if (!ret || waitRCode(slow_resp) != public_data::RCode::RCode_timeout)
+    {
+        LOG(Level::Error, "慢服务没有以超时结束");
+        return 1;
+    }
+    LOG(Level::Info, "慢服务调用超时");
+
+    // 连接断开：服务端进程结束后，未完成的调用以连接断开结束，不会等到超时
+    ret = client.call("slow_add", params, slow_resp);
+    Json::Value kill_result;
+    if (!ret || !client.call("kill", Json::Value(Json::objectValue), kill_result) ||
+        waitRCode(slow_resp) != public_data::RCode::RCode_disconneted)
+    {
+        LOG(Level::Error, "服务端退出后调用没有以连接断开结束");
+        return 1;
+    }
+    LOG(Level::Info, "服务端退出，未完成的调用以连接断开结束");
+
     return 0;
 }
\ No newline at end of file
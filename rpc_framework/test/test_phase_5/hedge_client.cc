@@ -0,0 +1,95 @@
+#include <rpc_framework/client/main_client.h>
+#include <thread>
+
+using namespace log_system;
+
+// 通过注册中心发现两个服务提供者，hedge_add在8081上20毫秒应答，在8082上200毫秒应答
+// 样本足够后，发往慢提供者的调用在等待对冲延迟后向快提供者发送对冲请求，先返回的结果生效
+// 对冲请求受预算限制，预算耗尽后调用等待慢提供者应答
+int main()
+{
+    rpc_client::main_client::RpcClient client(true, "127.0.0.1", 9091);
+    client.setTimeout(3000);
+
+    // 对冲请求也会推进轮询，之后的调用更多地发往慢提供者，分位数取低一些才能落在快提供者的耗时上
+    rpc_client::hedging::HedgePolicy policy;
+    policy.percentile = 0.1;
+    policy.min_samples = 20;
+    client.setHedgePolicy("hedge_add", policy);
+
+    const int count = 80;
+    const auto slow_latency = std::chrono::milliseconds(150);
+    Json::Value params;
+    params["num1"] = 1;
+    params["num2"] = 2;
+    std::vector<std::chrono::steady_clock::duration> latencies;
+    for (int i = 0; i < count; i++)
+    {
+        // 样本不足时不对冲
+        if (i == static_cast<int>(policy.min_samples) - 1)
+        {
+            Json::Value warmup = client.hedgeStats()["hedge_add"];
+            if (warmup["hedges"].asUInt64() != 0 || warmup["delay_us"].asInt64() >= 0)
+            {
+                LOG(Level::Error, "样本不足时发出了对冲请求：{}", warmup.toStyledString());
+                return 1;
+            }
+        }
+
+        Json::Value result;
+        auto start = std::chrono::steady_clock::now();
+        if (!client.call("hedge_add", params, result) || result.asInt() != 3)
+        {
+            LOG(Level::Error, "第{}次调用失败", i);
+            return 1;
+        }
+        latencies.push_back(std::chrono::steady_clock::now() - start);
+    }
+
+    Json::Value stats = client.hedgeStats()["hedge_add"];
+    LOG(Level::Info, "调用{}次，对冲统计：{}", count, stats.toStyledString());
+
+    // 对冲等待时间取快提供者的耗时，不会等到慢提供者应答
+    auto delay = std::chrono::microseconds(stats["delay_us"].asInt64());
+    if (delay < std::chrono::milliseconds(20) || delay >= slow_latency)
+    {
+        LOG(Level::Error, "对冲等待时间错误：{}us", delay.count());
+        return 1;
+    }
+
+    // 发往快提供者的对冲请求先于慢提供者返回；快提供者略慢于等待时间时也会对冲，这时原请求先返回
+    uint64_t hedges = stats["hedges"].asUInt64();
+    uint64_t hedge_wins = stats["hedge_wins"].asUInt64();
+    if (hedge_wins == 0 || hedge_wins > hedges)
+    {
+        LOG(Level::Error, "对冲请求{}个，先返回{}个", hedges, hedge_wins);
+        return 1;
+    }
+
+    // 对冲的调用在等待时间之后、慢提供者应答之前完成；没有对冲的慢调用不超过被限流的次数
+    uint64_t hedged_calls = 0;
+    uint64_t slow_calls = 0;
+    for (size_t i = policy.min_samples; i < latencies.size(); i++)
+    {
+        if (latencies[i] >= slow_latency)
+            slow_calls++;
+        else if (latencies[i] >= delay + std::chrono::milliseconds(15))
+            hedged_calls++;
+    }
+    uint64_t throttled = stats["throttled"].asUInt64();
+    if (hedged_calls < hedge_wins || slow_calls > throttled)
+    {
+        LOG(Level::Error, "对冲后完成的调用{}个，慢调用{}个，限流{}次", hedged_calls, slow_calls, throttled);
+        return 1;
+    }
+
+    // 预算：初始10个令牌，每次调用增加budget_ratio个
+    if (throttled == 0 || hedges > 10 + static_cast<uint64_t>(policy.budget_ratio * count))
+    {
+        LOG(Level::Error, "对冲预算没有生效：对冲{}次，限流{}次", hedges, throttled);
+        return 1;
+    }
+
+    LOG(Level::Info, "对冲{}次，限流{}次", hedges, throttled);
+    return 0;
+}
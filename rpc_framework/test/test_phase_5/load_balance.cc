@@ -0,0 +1,168 @@
+#include <rpc_framework/client/main_client.h>
+#include <map>
+
+using namespace log_system;
+using namespace rpc_client::load_balance;
+
+// 负载均衡策略的选择结果，不需要服务端
+
+Endpoint makeEndpoint(uint16_t port, int weight = 1)
+{
+    Endpoint endpoint;
+    endpoint.host = public_data::host_addr_t("127.0.0.1", port);
+    endpoint.weight = weight;
+    endpoint.stats = std::make_shared<HostStats>();
+    return endpoint;
+}
+
+uint16_t selectPort(const LoadBalancer::ptr &balancer, const std::string &key = std::string())
+{
+    Endpoint endpoint;
+    if (!balancer->select(key, std::vector<public_data::host_addr_t>(), endpoint))
+        return 0;
+    return endpoint.host.second;
+}
+
+// 一致性哈希：相同的键总是选中同一个提供者，增加或者删除提供者时只有少部分键改变归属
+bool testConsistentHash()
+{
+    const int key_count = 1000;
+    endpoints_t endpoints = {makeEndpoint(8081), makeEndpoint(8082), makeEndpoint(8083)};
+    auto balancer = LoadBalancerFactory::create(Strategy::ConsistentHash, endpoints);
+    std::vector<uint16_t> owners;
+    for (int i = 0; i < key_count; i++)
+    {
+        std::string key = "key" + std::to_string(i);
+        owners.push_back(selectPort(balancer, key));
+        if (selectPort(balancer, key) != owners.back())
+        {
+            LOG(Level::Error, "相同的键选中了不同的提供者：{}", key);
+            return false;
+        }
+    }
+
+    // 增加一个提供者：改变归属的键只能移到新的提供者上，约占1/4
+    endpoints.push_back(makeEndpoint(8084));
+    balancer = LoadBalancerFactory::create(Strategy::ConsistentHash, endpoints);
+    int moved = 0;
+    for (int i = 0; i < key_count; i++)
+    {
+        uint16_t port = selectPort(balancer, "key" + std::to_string(i));
+        if (port == owners[i])
+            continue;
+        if (port != 8084)
+        {
+            LOG(Level::Error, "增加提供者后键移到了原有的提供者上");
+            return false;
+        }
+        moved++;
+    }
+    if (moved < key_count / 10 || moved > key_count * 2 / 5)
+    {
+        LOG(Level::Error, "增加提供者后改变归属的键个数错误：{}", moved);
+        return false;
+    }
+
+    // 删除一个提供者：只有原来属于它的键改变归属
+    endpoints.erase(endpoints.begin() + 1);
+    endpoints.pop_back();
+    balancer = LoadBalancerFactory::create(Strategy::ConsistentHash, endpoints);
+    for (int i = 0; i < key_count; i++)
+    {
+        uint16_t port = selectPort(balancer, "key" + std::to_string(i));
+        if ((owners[i] != 8082 && port != owners[i]) || port == 8082)
+        {
+            LOG(Level::Error, "删除提供者后键的归属错误");
+            return false;
+        }
+    }
+
+    LOG(Level::Info, "一致性哈希：增加提供者后{}个键改变归属", moved);
+    return true;
+}
+
+// 平滑加权轮询：每一轮中各提供者被选中的次数等于权重，并且分散在一轮中
+bool testWeightedRoundRobin()
+{
+    endpoints_t endpoints = {makeEndpoint(8081, 5), makeEndpoint(8082), makeEndpoint(8083)};
+    auto balancer = LoadBalancerFactory::create(Strategy::WeightedRoundRobin, endpoints);
+    const uint16_t expect[] = {8081, 8081, 8082, 8081, 8083, 8081, 8081};
+    for (int round = 0; round < 100; round++)
+    {
+        for (uint16_t port : expect)
+        {
+            if (selectPort(balancer) != port)
+            {
+                LOG(Level::Error, "加权轮询的选择顺序错误");
+                return false;
+            }
+        }
+    }
+
+    endpoints = {makeEndpoint(8081, 1), makeEndpoint(8082, 2), makeEndpoint(8083, 3)};
+    balancer = LoadBalancerFactory::create(Strategy::WeightedRoundRobin, endpoints);
+    for (int round = 0; round < 100; round++)
+    {
+        std::map<uint16_t, int> counts;
+        for (int i = 0; i < 6; i++)
+            counts[selectPort(balancer)]++;
+        if (counts[8081] != 1 || counts[8082] != 2 || counts[8083] != 3)
+        {
+            LOG(Level::Error, "加权轮询的分布错误");
+            return false;
+        }
+    }
+
+    LOG(Level::Info, "加权轮询选择顺序正确");
+    return true;
+}
+
+// 最少未完成请求：选择未完成请求最少的提供者，相同时轮流选择
+bool testLeastOutstanding()
+{
+    endpoints_t endpoints = {makeEndpoint(8081), makeEndpoint(8082), makeEndpoint(8083)};
+    auto balancer = LoadBalancerFactory::create(Strategy::LeastOutstanding, endpoints);
+    std::map<uint16_t, int> counts;
+    for (int i = 0; i < 30; i++)
+        counts[selectPort(balancer)]++;
+    if (counts[8081] != 10 || counts[8082] != 10 || counts[8083] != 10)
+    {
+        LOG(Level::Error, "未完成请求相同时没有轮流选择");
+        return false;
+    }
+
+    endpoints[0].stats->onStart();
+    endpoints[0].stats->onStart();
+    endpoints[1].stats->onStart();
+    for (int i = 0; i < 10; i++)
+    {
+        if (selectPort(balancer) != 8083)
+        {
+            LOG(Level::Error, "没有选择未完成请求最少的提供者");
+            return false;
+        }
+    }
+
+    // 请求结束后负载变化，选择随之改变
+    for (int i = 0; i < 3; i++)
+        endpoints[2].stats->onStart();
+    endpoints[1].stats->onFinish(std::chrono::milliseconds(1), true);
+    for (int i = 0; i < 10; i++)
+    {
+        if (selectPort(balancer) != 8082)
+        {
+            LOG(Level::Error, "负载变化后没有选择未完成请求最少的提供者");
+            return false;
+        }
+    }
+
+    LOG(Level::Info, "最少未完成请求选择正确");
+    return true;
+}
+
+int main()
+{
+    if (!testConsistentHash() || !testWeightedRoundRobin() || !testLeastOutstanding())
+        return 1;
+    return 0;
+}
@@ -0,0 +1,74 @@
+#include <rpc_framework/client/main_client.h>
+#include <thread>
+
+using namespace log_system;
+
+// 通过注册中心发现两个服务提供者，其中一个总是返回内部错误
+// 出错的提供者应该被隔离，之后每次试探都失败并继续隔离，不能被恢复；大部分调用由正常的提供者完成
+int main()
+{
+    rpc_client::main_client::RpcClient client(true, "127.0.0.1", 9091);
+    client.setTimeout(3000);
+
+    const public_data::host_addr_t fail_host("127.0.0.1", 8082);
+    std::mutex mtx;
+    int ejections = 0;
+    int restores = 0;
+
+    rpc_client::outlier::OutlierPolicy policy;
+    policy.consecutive_errors = 3;
+    policy.base_ejection_ms = 300;
+    client.setOutlierPolicy("outlier_add", policy, [&](const rpc_client::outlier::OutlierEvent &event)
+                            {
+        LOG(Level::Info, "{}:{} {}，原因：{}", event.host.first, event.host.second, event.type, event.reason);
+        if (event.host != fail_host)
+            return;
+        std::unique_lock<std::mutex> lock(mtx);
+        if (event.type == "eject")
+            ejections++;
+        else
+            restores++; });
+
+    // 调用约3秒，期间出错的提供者经历多次隔离到期和试探
+    const int count = 300;
+    int failures = 0;
+    Json::Value params;
+    params["num1"] = 1;
+    params["num2"] = 2;
+    for (int i = 0; i < count; i++)
+    {
+        Json::Value result;
+        if (!client.call("outlier_add", params, result) || result.asInt() != 3)
+            failures++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    Json::Value stats = client.loadBalanceStats()["outlier_add"];
+    LOG(Level::Info, "调用{}次，失败{}次，负载均衡统计：{}", count, failures, stats.toStyledString());
+
+    std::unique_lock<std::mutex> lock(mtx);
+    if (ejections == 0 || restores != 0)
+    {
+        LOG(Level::Error, "总是出错的提供者隔离{}次，恢复{}次", ejections, restores);
+        return 1;
+    }
+
+    for (const auto &host : stats["hosts"])
+    {
+        if (host["host"].asString() == "127.0.0.1:8082" && host["state"].asString() == "healthy")
+        {
+            LOG(Level::Error, "总是出错的提供者没有被隔离");
+            return 1;
+        }
+    }
+
+    // 只有隔离前的几次调用和每次试探失败
+    if (failures >= count / 10)
+    {
+        LOG(Level::Error, "失败的调用过多：{}", failures);
+        return 1;
+    }
+
+    LOG(Level::Info, "总是出错的提供者隔离{}次，没有被恢复", ejections);
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include <rpc_framework/server/main_server.h>
+#include <thread>
+
+using namespace log_system;
+
+// 注册中心和两个服务提供者，用于客户端测试异常检测、重试和对冲
+// 8081上的提供者正常应答，8082上的提供者总是返回内部错误（outlier_add）或者应答较慢（hedge_add）
+// fail_add在两个提供者上都返回内部错误
+const uint16_t registry_port = 9091;
+
+void okAdd(const Json::Value &params, const rpc_server::rpc_router::Responder::ptr &responder)
+{
+    responder->complete(params["num1"].asInt() + params["num2"].asInt());
+}
+
+void failAdd(const Json::Value &, const rpc_server::rpc_router::Responder::ptr &responder)
+{
+    responder->fail(public_data::RCode::RCode_internal_error);
+}
+
+// 在其他线程中等待delay_ms毫秒后应答
+rpc_server::rpc_router::async_handler_t delayedAdd(int delay_ms)
+{
+    return [delay_ms](const Json::Value &params, const rpc_server::rpc_router::Responder::ptr &responder)
+    {
+        std::thread([delay_ms, params, responder]()
+                    {
+            std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+            responder->complete(params["num1"].asInt() + params["num2"].asInt()); })
+            .detach();
+    };
+}
+
+rpc_server::rpc_router::ServiceDesc::ptr buildAdd(const std::string &method, const rpc_server::rpc_router::async_handler_t &handler)
+{
+    std::unique_ptr<rpc_server::rpc_router::ServiceDescFactory> desc_factory = std::make_unique<rpc_server::rpc_router::ServiceDescFactory>();
+    desc_factory->setMethodName(method);
+    desc_factory->setParams("num1", rpc_server::rpc_router::params_type::Integral);
+    desc_factory->setParams("num2", rpc_server::rpc_router::params_type::Integral);
+    desc_factory->setReturnType(rpc_server::rpc_router::params_type::Integral);
+    desc_factory->setAsyncHandler(handler);
+    return desc_factory->buildServiceDesc();
+}
+
+// 服务端需要在执行事件循环的线程中创建
+void startProvider(uint16_t port, bool healthy)
+{
+    rpc_server::main_server::RpcServer server(public_data::host_addr_t("127.0.0.1", port), true, public_data::host_addr_t("127.0.0.1", registry_port));
+    if (healthy)
+        server.registryService(buildAdd("outlier_add", okAdd));
+    else
+        server.registryService(buildAdd("outlier_add", failAdd));
+    server.registryService(buildAdd("fail_add", failAdd));
+    server.registryService(buildAdd("hedge_add", delayedAdd(healthy ? 20 : 200)));
+    server.start();
+}
+
+int main()
+{
+    std::thread registry([]()
+                         {
+        rpc_server::main_server::RegistryServer reg_server(registry_port);
+        reg_server.start(); });
+
+    // 等待注册中心启动后再注册服务
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    std::thread ok_provider(startProvider, 8081, true);
+    std::thread fail_provider(startProvider, 8082, false);
+
+    registry.join();
+    ok_provider.join();
+    fail_provider.join();
+
+    return 0;
+}
@@ -0,0 +1,116 @@
+#include <rpc_framework/client/main_client.h>
+#include <thread>
+
+using namespace log_system;
+
+// 调用方法并等待结束，返回结束时的状态码
+public_data::RCode callRCode(rpc_client::main_client::RpcClient &client, const std::string &method, const Json::Value &params)
+{
+    rpc_client::rpc_caller::RpcCaller::aysnc_response resp;
+    if (!client.call(method, params, resp))
+        return public_data::RCode::RCode_disconneted;
+    try
+    {
+        resp.get();
+        return public_data::RCode::RCode_fine;
+    }
+    catch (const rpc_client::rpc_caller::RpcError &e)
+    {
+        return e.code();
+    }
+}
+
+// 通过注册中心发现两个服务提供者，8082上的outlier_add总是返回内部错误，fail_add在两个提供者上都返回内部错误
+// 重试发往还没有尝试过的提供者；不可重试的状态码不重试；重试次数受最多尝试次数和重试预算限制
+int main()
+{
+    rpc_client::main_client::RpcClient client(true, "127.0.0.1", 9091);
+    client.setTimeout(3000);
+
+    // 只尝试两次：第一次发往出错的提供者时，重试必须发往另一个提供者才能成功
+    // 一致性哈希下相同参数总是选中同一个提供者，重试没有排除已经尝试过的提供者时会再次失败
+    rpc_client::retry::RetryPolicy policy;
+    policy.max_attempts = 2;
+    client.setRetryPolicy("outlier_add", policy);
+    client.setLoadBalance("outlier_add", rpc_client::load_balance::Strategy::ConsistentHash);
+
+    // 调用次数不超过初始预算，重试不会被限流
+    const int count = 10;
+    Json::Value params;
+    params["num2"] = 2;
+    for (int i = 0; i < count; i++)
+    {
+        params["num1"] = i;
+        Json::Value result;
+        if (!client.call("outlier_add", params, result) || result.asInt() != i + 2)
+        {
+            LOG(Level::Error, "第{}次调用失败，重试没有发往其他提供者", i);
+            return 1;
+        }
+    }
+
+    Json::Value stats = client.retryStats()["outlier_add"];
+    uint64_t retries = stats["retries"].asUInt64();
+    if (retries == 0 || stats["throttled"].asUInt64() != 0 || stats["exhausted"].asUInt64() != 0)
+    {
+        LOG(Level::Error, "重试统计错误：{}", stats.toStyledString());
+        return 1;
+    }
+
+    // 参数错误不可重试，直接结束
+    Json::Value bad_params;
+    bad_params["num1"] = "one";
+    bad_params["num2"] = 2;
+    for (int i = 0; i < count; i++)
+    {
+        public_data::RCode rcode = callRCode(client, "outlier_add", bad_params);
+        if (rcode != public_data::RCode::RCode_invalid_params)
+        {
+            LOG(Level::Error, "参数错误的调用结果错误：{}", public_data::errReason(rcode));
+            return 1;
+        }
+    }
+    if (client.retryStats()["outlier_add"]["retries"].asUInt64() != retries)
+    {
+        LOG(Level::Error, "不可重试的状态码被重试");
+        return 1;
+    }
+    LOG(Level::Info, "outlier_add重试{}次", retries);
+
+    // 总是出错的方法：预算充足时尝试max_attempts次后放弃，预算耗尽后不再重试
+    rpc_client::retry::RetryPolicy fail_policy;
+    client.setRetryPolicy("fail_add", fail_policy);
+    const int fail_count = 40;
+    for (int i = 0; i < fail_count; i++)
+    {
+        public_data::RCode rcode = callRCode(client, "fail_add", params);
+        if (rcode != public_data::RCode::RCode_internal_error)
+        {
+            LOG(Level::Error, "总是出错的方法结果错误：{}", public_data::errReason(rcode));
+            return 1;
+        }
+    }
+
+    // 每个调用都以尝试次数用完或者预算不足结束
+    Json::Value fail_stats = client.retryStats()["fail_add"];
+    LOG(Level::Info, "fail_add调用{}次，重试统计：{}", fail_count, fail_stats.toStyledString());
+    uint64_t fail_retries = fail_stats["retries"].asUInt64();
+    uint64_t exhausted = fail_stats["exhausted"].asUInt64();
+    uint64_t throttled = fail_stats["throttled"].asUInt64();
+    if (exhausted == 0 || throttled == 0 || exhausted + throttled != static_cast<uint64_t>(fail_count))
+    {
+        LOG(Level::Error, "尝试次数用完{}次，预算不足{}次", exhausted, throttled);
+        return 1;
+    }
+
+    // 初始10个令牌，每次调用增加budget_ratio个
+    if (fail_retries > static_cast<uint64_t>(fail_policy.max_attempts - 1) * fail_count ||
+        fail_retries > 10 + static_cast<uint64_t>(fail_policy.budget_ratio * fail_count))
+    {
+        LOG(Level::Error, "重试次数超过限制：{}", fail_retries);
+        return 1;
+    }
+
+    LOG(Level::Info, "fail_add重试{}次，尝试次数用完{}次，预算不足{}次", fail_retries, exhausted, throttled);
+    return 0;
+}
@@ -1,4 +1,7 @@
 #include <rpc_framework/server/main_server.h>
+#include <thread>
+#include <atomic>
+#include <cstdlib>
 
 using namespace log_system;
 
@@ -10,6 +13,117 @@ void add(const Json::Value &params, Json::Value &result)
     result = num1 + num2;
 }
 
+// 业务回调的执行次数，客户端通过handled服务获取，用于检查调用是否真正执行
+std::atomic<int> sum_handled{0};
+std::atomic<int> async_add_handled{0};
+std::atomic<int> shared_add_handled{0};
+
+void handled(const Json::Value &, Json::Value &result)
+{
+    result["sum"] = sum_handled.load();
+    result["async_add"] = async_add_handled.load();
+    result["shared_add"] = shared_add_handled.load();
+}
+
+// 数组求和，结果乘以倍数
+void sum(const Json::Value &params, Json::Value &result)
+{
+    sum_handled++;
+    int total = 0;
+    for (const auto &num : params["nums"])
+        total += num.asInt();
+
+    result = total * params["scale"].asInt();
+}
+
+// 异步服务：在其他线程中完成计算后应答，业务回调本身立即返回
+void asyncAdd(const Json::Value &params, const rpc_server::rpc_router::Responder::ptr &responder)
+{
+    async_add_handled++;
+    std::thread([params, responder]()
+                {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        responder->complete(params["num1"].asInt() + params["num2"].asInt()); })
+        .detach();
+}
+
+// 合并执行的慢服务：200毫秒后应答，执行期间到达的相同请求共享这一次的结果
+void sharedAdd(const Json::Value &params, const rpc_server::rpc_router::Responder::ptr &responder)
+{
+    shared_add_handled++;
+    std::thread([params, responder]()
+                {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        responder->complete(params["num1"].asInt() + params["num2"].asInt()); })
+        .detach();
+}
+
+// 慢服务：5秒后才应答，用于客户端测试超时
+void slowAdd(const Json::Value &params, const rpc_server::rpc_router::Responder::ptr &responder)
+{
+    std::thread([params, responder]()
+                {
+        std::this_thread::sleep_for(std::chrono::seconds(5));
+        responder->complete(params["num1"].asInt() + params["num2"].asInt()); })
+        .detach();
+}
+
+// 应答后结束服务端进程，模拟服务端被杀死，用于客户端测试连接断开
+void killServer(const Json::Value &, Json::Value &result)
+{
+    result = true;
+    std::thread([]()
+                {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        std::_Exit(0); })
+        .detach();
+}
+
+// 批量服务：一次计算多组参数，按顺序返回同样个数的结果
+void batchAdd(const std::vector<Json::Value> &params, std::vector<Json::Value> &results)
+{
+    for (const auto &param : params)
+        results.push_back(param["num1"].asInt() + param["num2"].asInt());
+}
+
+#ifdef RPC_HAS_COROUTINE
+// 协程服务：co_return返回结果，需要使用C++20编译
+coroutine_task::Task<Json::Value> coAdd(const Json::Value &params)
+{
+    co_return params["num1"].asInt() + params["num2"].asInt();
+}
+#endif
+
+// 流式服务：依次返回[0, count)
+void range(const Json::Value &params, const rpc_server::rpc_router::StreamWriter::ptr &writer)
+{
+    int count = params["count"].asInt();
+    for (int i = 0; i < count; i++)
+    {
+        if (!writer->write(i))
+            return;
+    }
+
+    writer->finish();
+}
+
+// 双向流服务：将收到的每一个数字乘2后返回，客户端关闭后关闭
+void doubleStream(const rpc_stream::RpcStream::ptr &stream)
+{
+    // 回调保存在流对象中，使用弱引用避免循环引用
+    std::weak_ptr<rpc_stream::RpcStream> weak_stream = stream;
+    stream->setDataCallback([weak_stream](const Json::Value &data)
+                            {
+        auto s = weak_stream.lock();
+        if (s)
+            s->tryWrite(data.asInt() * 2); });
+    stream->setCloseCallback([weak_stream](public_data::RCode)
+                             {
+        auto s = weak_stream.lock();
+        if (s)
+            s->close(); });
+}
+
 int main()
 {
     // 使用服务描述工厂创建服务
@@ -29,6 +143,104 @@ int main()
     rpc_server::main_server::RpcServer server(public_data::host_addr_t("127.0.0.1", 8080));
     server.registryService(desc_factory->buildServiceDesc());
 
+    // 使用参数结构描述参数：nums为整数数组，scale可选，默认为1
+    std::unique_ptr<rpc_server::rpc_router::ServiceDescFactory> sum_factory = std::make_unique<rpc_server::rpc_router::ServiceDescFactory>();
+    sum_factory->setMethodName("sum");
+    sum_factory->setParamsSchema(rpc_server::rpc_router::SchemaBuilder()
+                                     .array("nums", rpc_server::rpc_router::params_type::Integral)
+                                     .field("scale", rpc_server::rpc_router::params_type::Integral, 1)
+                                     .build());
+    sum_factory->setReturnType(rpc_server::rpc_router::params_type::Integral);
+    sum_factory->setHandler(sum);
+    // 结果只由参数决定，缓存1秒，最多1000个结果
+    sum_factory->setResultCache(1000, 1000);
+    // 缓存未命中时，同时到达的相同请求只执行一次
+    sum_factory->setSingleflight();
+    server.registryService(sum_factory->buildServiceDesc());
+
+    // 流式服务，返回值类型为流中元素的类型
+    std::unique_ptr<rpc_server::rpc_router::ServiceDescFactory> stream_factory = std::make_unique<rpc_server::rpc_router::ServiceDescFactory>();
+    stream_factory->setMethodName("range");
+    stream_factory->setParams("count", rpc_server::rpc_router::params_type::Integral);
+    stream_factory->setReturnType(rpc_server::rpc_router::params_type::Integral);
+    stream_factory->setStreamHandler(range);
+    server.registryService(stream_factory->buildServiceDesc());
+
+    // 异步服务
+    std::unique_ptr<rpc_server::rpc_router::ServiceDescFactory> async_factory = std::make_unique<rpc_server::rpc_router::ServiceDescFactory>();
+    async_factory->setMethodName("async_add");
+    async_factory->setParams("num1", rpc_server::rpc_router::params_type::Integral);
+    async_factory->setParams("num2", rpc_server::rpc_router::params_type::Integral);
+    async_factory->setReturnType(rpc_server::rpc_router::params_type::Integral);
+    async_factory->setAsyncHandler(asyncAdd);
+    // 最多同时处理8个调用，再多64个排队，超出时返回服务过载
+    async_factory->setConcurrencyLimit(8, 64);
+    server.registryService(async_factory->buildServiceDesc());
+
+#ifdef RPC_HAS_COROUTINE
+    // 协程服务
+    std::unique_ptr<rpc_server::rpc_router::ServiceDescFactory> co_factory = std::make_unique<rpc_server::rpc_router::ServiceDescFactory>();
+    co_factory->setMethodName("co_add");
+    co_factory->setParams("num1", rpc_server::rpc_router::params_type::Integral);
+    co_factory->setParams("num2", rpc_server::rpc_router::params_type::Integral);
+    co_factory->setReturnType(rpc_server::rpc_router::params_type::Integral);
+    co_factory->setCoroutineHandler(coAdd);
+    server.registryService(co_factory->buildServiceDesc());
+#endif
+
+    // 批量服务：2毫秒内到达的请求合并为一批，每批最多64个
+    std::unique_ptr<rpc_server::rpc_router::ServiceDescFactory> batch_factory = std::make_unique<rpc_server::rpc_router::ServiceDescFactory>();
+    batch_factory->setMethodName("batch_add");
+    batch_factory->setParams("num1", rpc_server::rpc_router::params_type::Integral);
+    batch_factory->setParams("num2", rpc_server::rpc_router::params_type::Integral);
+    batch_factory->setReturnType(rpc_server::rpc_router::params_type::Integral);
+    batch_factory->setBatchHandler(batchAdd, 64, 2000);
+    server.registryService(batch_factory->buildServiceDesc());
+
+    // 双向流服务
+    server.registryStream("double", doubleStream);
+
+    // 只合并执行、不缓存结果的服务
+    std::unique_ptr<rpc_server::rpc_router::ServiceDescFactory> shared_factory = std::make_unique<rpc_server::rpc_router::ServiceDescFactory>();
+    shared_factory->setMethodName("shared_add");
+    shared_factory->setParams("num1", rpc_server::rpc_router::params_type::Integral);
+    shared_factory->setParams("num2", rpc_server::rpc_router::params_type::Integral);
+    shared_factory->setReturnType(rpc_server::rpc_router::params_type::Integral);
+    shared_factory->setAsyncHandler(sharedAdd);
+    shared_factory->setSingleflight();
+    server.registryService(shared_factory->buildServiceDesc());
+
+    // 清除方法的缓存结果
+    std::unique_ptr<rpc_server::rpc_router::ServiceDescFactory> invalidate_factory = std::make_unique<rpc_server::rpc_router::ServiceDescFactory>();
+    invalidate_factory->setMethodName("invalidate");
+    invalidate_factory->setParams("method", rpc_server::rpc_router::params_type::String);
+    invalidate_factory->setReturnType(rpc_server::rpc_router::params_type::Bool);
+    invalidate_factory->setHandler([&server](const Json::Value &params, Json::Value &result)
+                                   { result = server.invalidateCache(params["method"].asString()); });
+    server.registryService(invalidate_factory->buildServiceDesc());
+
+    // 业务回调的执行次数
+    std::unique_ptr<rpc_server::rpc_router::ServiceDescFactory> handled_factory = std::make_unique<rpc_server::rpc_router::ServiceDescFactory>();
+    handled_factory->setMethodName("handled");
+    handled_factory->setReturnType(rpc_server::rpc_router::params_type::Object);
+    handled_factory->setHandler(handled);
+    server.registryService(handled_factory->buildServiceDesc());
+
+    // 慢服务和结束进程的服务，客户端最后调用
+    std::unique_ptr<rpc_server::rpc_router::ServiceDescFactory> slow_factory = std::make_unique<rpc_server::rpc_router::ServiceDescFactory>();
+    slow_factory->setMethodName("slow_add");
+    slow_factory->setParams("num1", rpc_server::rpc_router::params_type::Integral);
+    slow_factory->setParams("num2", rpc_server::rpc_router::params_type::Integral);
+    slow_factory->setReturnType(rpc_server::rpc_router::params_type::Integral);
+    slow_factory->setAsyncHandler(slowAdd);
+    server.registryService(slow_factory->buildServiceDesc());
+
+    std::unique_ptr<rpc_server::rpc_router::ServiceDescFactory> kill_factory = std::make_unique<rpc_server::rpc_router::ServiceDescFactory>();
+    kill_factory->setMethodName("kill");
+    kill_factory->setReturnType(rpc_server::rpc_router::params_type::Bool);
+    kill_factory->setHandler(killServer);
+    server.registryService(kill_factory->buildServiceDesc());
+
     server.start();
 
     return 0;
@@ -3,6 +3,9 @@
 
 #include <iostream>
 #include <string>
+#include <cstring>
+#include <cctype>
+#include <cstdint>
 #include "jsoncpp/json/json.h"
 #include <rpc_framework/base/log.h>
 
@@ -44,6 +47,174 @@ namespace json_util
             }
             return true;
         }
+
+        // 规范化序列化：不带缩进和换行
+        // JSON对象的字段按名称有序保存，字段顺序和空白不同的相同JSON得到相同的文本，可以作为键使用
+        static std::string canonicalize(const Json::Value &json_object)
+        {
+            Json::StreamWriterBuilder swb;
+            swb["indentation"] = "";
+            return Json::writeString(swb, json_object);
+        }
+
+        // 不构建JSON对象，直接从JSON文本中获取顶层字符串字段
+        // 字段不存在、不是字符串或者包含转义字符时返回false，由调用者进行完整解析
+        static bool peekString(const std::string &json_str, const char *key, std::string &value)
+        {
+            size_t begin = 0, end = 0;
+            if (!peekValue(json_str, key, begin, end))
+                return false;
+            if (json_str[begin] != '"' || end - begin < 2)
+                return false;
+            // 去除两端引号，存在转义字符时交给完整解析处理
+            if (json_str.find('\\', begin) < end)
+                return false;
+
+            value.assign(json_str, begin + 1, end - begin - 2);
+            return true;
+        }
+
+        // 不构建JSON对象，直接从JSON文本中获取顶层整数字段
+        static bool peekInt(const std::string &json_str, const char *key, int &value)
+        {
+            size_t begin = 0, end = 0;
+            if (!peekValue(json_str, key, begin, end))
+                return false;
+
+            size_t i = begin;
+            if (json_str[i] == '-')
+                ++i;
+            if (i == end)
+                return false;
+            long long num = 0;
+            for (; i < end; ++i)
+            {
+                if (!isdigit(static_cast<unsigned char>(json_str[i])) || num > INT32_MAX)
+                    return false;
+                num = num * 10 + (json_str[i] - '0');
+            }
+            num = json_str[begin] == '-' ? -num : num;
+            if (num > INT32_MAX || num < INT32_MIN)
+                return false;
+
+            value = static_cast<int>(num);
+            return true;
+        }
+
+    private:
+        // 在JSON文本中查找顶层字段key，找到后通过[begin, end)返回值对应的文本区间
+        // 字段重复时与jsoncpp的完整解析一致，使用最后一个值，因此需要扫描完所有顶层字段
+        // 字段名按原始字节比较，字段名中存在转义字符（例如\u0069d与id相同）时返回false，由调用者进行完整解析
+        static bool peekValue(const std::string &json_str, const char *key, size_t &begin, size_t &end)
+        {
+            size_t i = skipSpace(json_str, 0);
+            if (i >= json_str.size() || json_str[i] != '{')
+                return false;
+            i = skipSpace(json_str, i + 1);
+
+            const size_t key_len = strlen(key);
+            bool found = false;
+            while (i < json_str.size() && json_str[i] == '"')
+            {
+                // 读取字段名
+                size_t key_begin = i + 1;
+                size_t key_end = skipValue(json_str, i);
+                if (key_end == std::string::npos)
+                    return false;
+                if (memchr(json_str.data() + key_begin, '\\', key_end - key_begin) != nullptr)
+                    return false;
+                bool matched = (key_end - 1 - key_begin == key_len) && json_str.compare(key_begin, key_len, key) == 0;
+
+                // 跳过冒号
+                i = skipSpace(json_str, key_end);
+                if (i >= json_str.size() || json_str[i] != ':')
+                    return false;
+                i = skipSpace(json_str, i + 1);
+
+                // 读取或者跳过字段值
+                size_t value_end = skipValue(json_str, i);
+                if (value_end == std::string::npos)
+                    return false;
+                if (matched)
+                {
+                    begin = i;
+                    end = value_end;
+                    found = true;
+                }
+
+                // 下一个字段，对象结束时返回
+                i = skipSpace(json_str, value_end);
+                if (i < json_str.size() && json_str[i] == '}')
+                    return found;
+                if (i >= json_str.size() || json_str[i] != ',')
+                    return false;
+                i = skipSpace(json_str, i + 1);
+            }
+
+            return found;
+        }
+
+        // 跳过空白字符
+        static size_t skipSpace(const std::string &json_str, size_t i)
+        {
+            while (i < json_str.size() && isspace(static_cast<unsigned char>(json_str[i])))
+                ++i;
+            return i;
+        }
+
+        // 跳过从i开始的一个完整JSON值，返回值之后的位置，格式错误时返回npos
+        static size_t skipValue(const std::string &json_str, size_t i)
+        {
+            if (i >= json_str.size())
+                return std::string::npos;
+
+            // 字符串
+            if (json_str[i] == '"')
+            {
+                for (++i; i < json_str.size(); ++i)
+                {
+                    if (json_str[i] == '\\')
+                        ++i;
+                    else if (json_str[i] == '"')
+                        return i + 1;
+                }
+                return std::string::npos;
+            }
+
+            // 对象或者数组，只需要匹配括号，同时跳过其中的字符串
+            if (json_str[i] == '{' || json_str[i] == '[')
+            {
+                int depth = 0;
+                while (i < json_str.size())
+                {
+                    char c = json_str[i];
+                    if (c == '"')
+                    {
+                        i = skipValue(json_str, i);
+                        if (i == std::string::npos)
+                            return i;
+                        continue;
+                    }
+                    if (c == '{' || c == '[')
+                        ++depth;
+                    else if (c == '}' || c == ']')
+                    {
+                        if (--depth == 0)
+                            return i + 1;
+                    }
+                    ++i;
+                }
+                return std::string::npos;
+            }
+
+            // 数字、true、false、null
+            size_t start = i;
+            while (i < json_str.size() && json_str[i] != ',' && json_str[i] != '}' && json_str[i] != ']' &&
+                   !isspace(static_cast<unsigned char>(json_str[i])))
+                ++i;
+
+            return i == start ? std::string::npos : i;
+        }
     };
 }
 
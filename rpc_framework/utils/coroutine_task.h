@@ -0,0 +1,237 @@
+#ifndef __rpc_coroutine_task_h__
+#define __rpc_coroutine_task_h__
+
+// 协程任务类型，需要C++20
+// 使用C++17编译时本文件为空，其余模块中的协程接口同样不可用
+#if __cplusplus >= 202002L && __has_include(<coroutine>)
+#define RPC_HAS_COROUTINE 1
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+namespace coroutine_task
+{
+    template <class T>
+    class Task;
+
+    namespace detail
+    {
+        // 协程结束时恢复等待该协程的协程（对称转移，不增加调用栈深度）
+        struct FinalAwaiter
+        {
+            bool await_ready() noexcept
+            {
+                return false;
+            }
+
+            template <class P>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept
+            {
+                std::coroutine_handle<> continuation = h.promise().continuation_;
+                return continuation ? continuation : std::noop_coroutine();
+            }
+
+            void await_resume() noexcept
+            {
+            }
+        };
+
+        struct PromiseBase
+        {
+            std::coroutine_handle<> continuation_; // 等待当前协程的协程
+            std::exception_ptr exception_;         // 协程中未处理的异常，在co_await处重新抛出
+
+            std::suspend_always initial_suspend() noexcept
+            {
+                return {};
+            }
+
+            FinalAwaiter final_suspend() noexcept
+            {
+                return {};
+            }
+
+            void unhandled_exception()
+            {
+                exception_ = std::current_exception();
+            }
+        };
+
+        template <class Promise>
+        class TaskBase
+        {
+        public:
+            TaskBase(TaskBase &&other) noexcept
+                : handle_(std::exchange(other.handle_, nullptr))
+            {
+            }
+
+            TaskBase &operator=(TaskBase &&other) noexcept
+            {
+                if (this != &other)
+                {
+                    if (handle_)
+                        handle_.destroy();
+                    handle_ = std::exchange(other.handle_, nullptr);
+                }
+                return *this;
+            }
+
+            ~TaskBase()
+            {
+                if (handle_)
+                    handle_.destroy();
+            }
+
+            bool await_ready() const noexcept
+            {
+                return !handle_ || handle_.done();
+            }
+
+            // 记录等待者后转移到当前任务执行
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+            {
+                handle_.promise().continuation_ = awaiting;
+                return handle_;
+            }
+
+        protected:
+            explicit TaskBase(std::coroutine_handle<Promise> h)
+                : handle_(h)
+            {
+            }
+
+            std::coroutine_handle<Promise> handle_;
+        };
+    }
+
+    namespace detail
+    {
+        template <class T>
+        struct TaskPromise : PromiseBase
+        {
+            std::optional<T> value_;
+
+            Task<T> get_return_object();
+
+            void return_value(T value)
+            {
+                value_ = std::move(value);
+            }
+        };
+
+        template <>
+        struct TaskPromise<void> : PromiseBase
+        {
+            Task<void> get_return_object();
+
+            void return_void()
+            {
+            }
+        };
+    }
+
+    // 惰性启动的协程任务，被co_await时才开始执行
+    template <class T>
+    class Task : public detail::TaskBase<detail::TaskPromise<T>>
+    {
+    public:
+        using promise_type = detail::TaskPromise<T>;
+
+        explicit Task(std::coroutine_handle<promise_type> h)
+            : detail::TaskBase<promise_type>(h)
+        {
+        }
+
+        T await_resume()
+        {
+            auto &promise = this->handle_.promise();
+            if (promise.exception_)
+                std::rethrow_exception(promise.exception_);
+
+            return std::move(*promise.value_);
+        }
+    };
+
+    template <>
+    class Task<void> : public detail::TaskBase<detail::TaskPromise<void>>
+    {
+    public:
+        using promise_type = detail::TaskPromise<void>;
+
+        explicit Task(std::coroutine_handle<promise_type> h)
+            : detail::TaskBase<promise_type>(h)
+        {
+        }
+
+        void await_resume()
+        {
+            auto &promise = this->handle_.promise();
+            if (promise.exception_)
+                std::rethrow_exception(promise.exception_);
+        }
+    };
+
+    namespace detail
+    {
+        template <class T>
+        Task<T> TaskPromise<T>::get_return_object()
+        {
+            return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+        }
+
+        inline Task<void> TaskPromise<void>::get_return_object()
+        {
+            return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+        }
+
+        // 立即启动、结束后自动销毁的协程，用于在普通函数中启动任务
+        struct Detached
+        {
+            struct promise_type
+            {
+                Detached get_return_object() noexcept
+                {
+                    return {};
+                }
+
+                std::suspend_never initial_suspend() noexcept
+                {
+                    return {};
+                }
+
+                std::suspend_never final_suspend() noexcept
+                {
+                    return {};
+                }
+
+                void return_void() noexcept
+                {
+                }
+
+                // 任务中的异常需要由任务自己处理
+                void unhandled_exception() noexcept
+                {
+                    std::terminate();
+                }
+            };
+        };
+
+        inline Detached runDetached(Task<void> task)
+        {
+            co_await task;
+        }
+    }
+
+    // 在当前线程中启动任务，任务在第一次挂起时返回，之后由恢复它的线程继续执行
+    inline void spawn(Task<void> task)
+    {
+        detail::runDetached(std::move(task));
+    }
+}
+
+#endif
+
+#endif
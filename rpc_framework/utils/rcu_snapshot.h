@@ -0,0 +1,141 @@
+#ifndef __rpc_rcu_snapshot_h__
+#define __rpc_rcu_snapshot_h__
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+
+namespace rcu_snapshot
+{
+    // 读多写少的数据快照
+    // 写入时复制一份新的数据，修改后整体替换并增加版本号，已经发出的旧快照不受影响
+    // 读取时每个线程缓存最近一次的快照和对应的版本号，版本号未变化时直接使用缓存，不加锁也不修改引用计数
+    // 只有版本号变化后的第一次读取需要加锁获取新快照
+    // ! 线程缓存会让旧快照在该线程下一次读取前一直存活，实例销毁后缓存的快照在该线程读取复用该编号的实例或者线程退出时释放
+    // ! 因此快照中不能保存需要随实例一起销毁的对象（例如回调绑定了其他对象的连接）
+    template <class T>
+    class RcuSnapshot
+    {
+    public:
+        using snapshot_t = std::shared_ptr<const T>;
+
+        RcuSnapshot()
+            : slot_(acquireSlot()), version_(nextVersion()), snapshot_(std::make_shared<const T>())
+        {
+        }
+
+        ~RcuSnapshot()
+        {
+            releaseSlot(slot_);
+        }
+
+        RcuSnapshot(const RcuSnapshot &) = delete;
+        RcuSnapshot &operator=(const RcuSnapshot &) = delete;
+
+        // 读取当前快照
+        // 返回的引用在当前线程下一次调用read之前有效，需要长期持有时使用snapshot
+        const T &read()
+        {
+            Cached &cached = localCache();
+            uint64_t version = version_.load(std::memory_order_acquire);
+            if (!cached.data || cached.version != version)
+            {
+                std::unique_lock<std::mutex> lock(write_mtx_);
+                cached.version = version_.load(std::memory_order_relaxed);
+                cached.snapshot = snapshot_;
+                cached.data = snapshot_.get();
+            }
+
+            return *static_cast<const T *>(cached.data);
+        }
+
+        // 获取当前快照的共享指针
+        snapshot_t snapshot()
+        {
+            std::unique_lock<std::mutex> lock(write_mtx_);
+            return snapshot_;
+        }
+
+        // 写入：复制当前数据，交给f修改后替换
+        // 多个写入者之间互斥，读取者不会被阻塞
+        template <class F>
+        void update(F &&f)
+        {
+            std::unique_lock<std::mutex> lock(write_mtx_);
+            std::shared_ptr<T> copy = std::make_shared<T>(*snapshot_);
+            f(*copy);
+            snapshot_ = std::move(copy);
+            version_.store(nextVersion(), std::memory_order_release);
+        }
+
+    private:
+        struct Cached
+        {
+            uint64_t version = 0;
+            const void *data = nullptr;          // 快照数据，读取时不需要经过共享指针
+            std::shared_ptr<const void> snapshot; // 保证缓存的快照存活
+        };
+
+        // 获取当前线程对该实例的缓存
+        // 线程私有的数组以实例编号为下标，同时存在的实例编号不同，不会互相替换缓存
+        // 实例销毁后编号被复用，数组长度只取决于同时存在的实例个数
+        Cached &localCache()
+        {
+            thread_local std::vector<Cached> local;
+            if (slot_ >= local.size())
+                local.resize(slot_ + 1);
+
+            return local[slot_];
+        }
+
+        // 同一类型的所有实例共用编号
+        struct Slots
+        {
+            std::mutex mtx;
+            size_t next = 0;
+            std::vector<size_t> free;
+        };
+
+        static Slots &slots()
+        {
+            static Slots slots;
+            return slots;
+        }
+
+        static size_t acquireSlot()
+        {
+            Slots &s = slots();
+            std::unique_lock<std::mutex> lock(s.mtx);
+            if (s.free.empty())
+                return s.next++;
+
+            size_t slot = s.free.back();
+            s.free.pop_back();
+            return slot;
+        }
+
+        static void releaseSlot(size_t slot)
+        {
+            Slots &s = slots();
+            std::unique_lock<std::mutex> lock(s.mtx);
+            s.free.push_back(slot);
+        }
+
+        // 版本号全局递增，复用编号的实例不会与缓存中上一个实例的版本号相同
+        static uint64_t nextVersion()
+        {
+            static std::atomic<uint64_t> next_version{1};
+            return next_version.fetch_add(1, std::memory_order_relaxed);
+        }
+
+    private:
+        const size_t slot_;                   // 实例编号，用于定位线程私有的缓存
+        std::atomic<uint64_t> version_;       // 快照版本号，每次写入更新为新的全局版本号
+        std::mutex write_mtx_;                // 写入者之间互斥，同时保护snapshot_
+        snapshot_t snapshot_;                 // 当前快照
+    };
+}
+
+#endif
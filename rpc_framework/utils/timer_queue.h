@@ -0,0 +1,159 @@
+#ifndef __rpc_timer_queue_h__
+#define __rpc_timer_queue_h__
+
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <memory>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <condition_variable>
+
+namespace timer_queue
+{
+    // 定时器队列
+    // 所有定时任务由同一个线程按到期时间依次执行，第一次添加定时任务时才创建线程
+    // 定时任务在定时线程中执行，任务中不能长时间阻塞，否则会推迟其他任务
+    class TimerQueue
+    {
+    public:
+        using ptr = std::shared_ptr<TimerQueue>;
+        using task_t = std::function<void()>;
+        using clock_t = std::chrono::steady_clock;
+        // 定时器编号，0表示无效编号
+        using timer_id_t = uint64_t;
+
+        TimerQueue()
+            : state_(std::make_shared<State>())
+        {
+        }
+
+        // 未执行的定时任务直接丢弃
+        ~TimerQueue()
+        {
+            stop();
+        }
+
+        TimerQueue(const TimerQueue &) = delete;
+        TimerQueue &operator=(const TimerQueue &) = delete;
+
+        // 停止定时线程，未执行的定时任务直接丢弃，之后添加的任务不再执行
+        // 等待正在执行的任务结束，在定时任务中调用时不等待
+        // 用于多个互相添加任务的定时器队列按顺序停止，避免任务访问已经销毁的队列
+        void stop()
+        {
+            {
+                std::unique_lock<std::mutex> lock(state_->mtx);
+                state_->stop = true;
+            }
+            state_->cond.notify_all();
+
+            if (!thread_.joinable())
+                return;
+            // 定时任务中释放了最后一个引用时，析构发生在定时线程中，不能等待自己
+            if (thread_.get_id() == std::this_thread::get_id())
+                thread_.detach();
+            else
+                thread_.join();
+        }
+
+        // 添加定时任务，delay之后执行一次，返回定时器编号，已经停止时返回0
+        timer_id_t add(clock_t::duration delay, const task_t &task)
+        {
+            auto expire = clock_t::now() + delay;
+            timer_id_t id = 0;
+            bool notify = false;
+            {
+                std::unique_lock<std::mutex> lock(state_->mtx);
+                if (state_->stop)
+                    return 0;
+                if (!thread_.joinable())
+                    thread_ = std::thread(&TimerQueue::run, state_);
+
+                id = ++state_->next_id;
+                auto pos = state_->timers.emplace(Key{expire, id}, task).first;
+                state_->index.insert({id, pos->first});
+                // 新任务成为最早到期的任务时唤醒定时线程重新计算等待时间
+                notify = pos == state_->timers.begin();
+            }
+
+            if (notify)
+                state_->cond.notify_one();
+            return id;
+        }
+
+        // 取消定时任务，任务已经执行或者不存在时返回false
+        bool cancel(timer_id_t id)
+        {
+            std::unique_lock<std::mutex> lock(state_->mtx);
+            auto pos = state_->index.find(id);
+            if (pos == state_->index.end())
+                return false;
+
+            state_->timers.erase(pos->second);
+            state_->index.erase(pos);
+            return true;
+        }
+
+        // 获取等待执行的定时任务个数
+        size_t size()
+        {
+            std::unique_lock<std::mutex> lock(state_->mtx);
+            return state_->timers.size();
+        }
+
+    private:
+        // 按到期时间排序，到期时间相同时按添加顺序
+        using Key = std::pair<clock_t::time_point, timer_id_t>;
+
+        // 定时线程与定时器队列共享的状态
+        struct State
+        {
+            std::mutex mtx;
+            std::condition_variable cond;
+            std::map<Key, task_t> timers;                      // 等待执行的定时任务
+            std::unordered_map<timer_id_t, Key> index;         // 定时器编号与排序键映射，用于取消
+            timer_id_t next_id = 0;                            // 最近一次分配的编号
+            bool stop = false;
+        };
+
+        static void run(std::shared_ptr<State> state)
+        {
+            std::unique_lock<std::mutex> lock(state->mtx);
+            while (!state->stop)
+            {
+                if (state->timers.empty())
+                {
+                    state->cond.wait(lock);
+                    continue;
+                }
+
+                auto first = state->timers.begin();
+                // 等待期间任务可能被取消，不能引用容器中的到期时间
+                clock_t::time_point expire = first->first.first;
+                if (expire > clock_t::now())
+                {
+                    state->cond.wait_until(lock, expire);
+                    continue;
+                }
+
+                task_t task = std::move(first->second);
+                state->index.erase(first->first.second);
+                state->timers.erase(first);
+
+                lock.unlock();
+                task();
+                task = nullptr;
+                lock.lock();
+            }
+        }
+
+    private:
+        std::shared_ptr<State> state_;
+        std::thread thread_; // 定时线程
+    };
+}
+
+#endif
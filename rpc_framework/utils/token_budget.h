@@ -0,0 +1,67 @@
+#ifndef __rpc_token_budget_h__
+#define __rpc_token_budget_h__
+
+#include <atomic>
+#include <cstdint>
+
+namespace token_budget
+{
+    // 额外请求的预算（令牌桶）
+    // 每一次普通请求存入ratio个令牌，每一次额外请求（对冲、重试）消耗一个令牌，令牌不足时不允许额外请求
+    // 额外请求的个数长期不超过普通请求的ratio倍，max_tokens限制短时间内的突发
+    // 令牌以千分之一为单位保存在原子变量中，不需要加锁
+    class TokenBudget
+    {
+    public:
+        TokenBudget(double ratio, double max_tokens)
+            : ratio_(toMilli(ratio)), max_(toMilli(max_tokens)), tokens_(max_)
+        {
+        }
+
+        // 一次普通请求，存入令牌
+        void deposit()
+        {
+            int64_t cur = tokens_.load(std::memory_order_relaxed);
+            while (cur < max_)
+            {
+                int64_t next = cur + ratio_ > max_ ? max_ : cur + ratio_;
+                if (tokens_.compare_exchange_weak(cur, next, std::memory_order_relaxed))
+                    return;
+            }
+        }
+
+        // 尝试发起一次额外请求，令牌不足时返回false
+        bool tryAcquire()
+        {
+            int64_t cur = tokens_.load(std::memory_order_relaxed);
+            while (cur >= unit)
+            {
+                if (tokens_.compare_exchange_weak(cur, cur - unit, std::memory_order_relaxed))
+                    return true;
+            }
+
+            return false;
+        }
+
+        // 获取当前的令牌数
+        double tokens() const
+        {
+            return static_cast<double>(tokens_.load(std::memory_order_relaxed)) / unit;
+        }
+
+    private:
+        static const int64_t unit = 1000; // 一个令牌对应的千分之一个数
+
+        static int64_t toMilli(double v)
+        {
+            return v <= 0 ? 0 : static_cast<int64_t>(v * unit);
+        }
+
+    private:
+        const int64_t ratio_;         // 每一次普通请求存入的令牌（千分之一）
+        const int64_t max_;           // 令牌上限（千分之一）
+        std::atomic<int64_t> tokens_; // 当前令牌（千分之一）
+    };
+}
+
+#endif